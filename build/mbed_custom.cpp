@@ -241,141 +241,66 @@ static int doesHeapCollideWithStack(unsigned int newHeap)
 }
 
 
-/* Optional functionality which will tag each heap allocation with the caller's return address. */
-#ifdef HEAP_TAGS
-
-const unsigned int *__smoothieHeapBase = &__end__;
+/* Wrap memory allocation routines to make sure that they aren't being called from interrupt handler. */
+static void breakOnHeapOpFromInterruptHandler(void)
+{
+    if (__get_IPSR() != 0)
+        __debugbreak();
+}
 
 extern "C" void *__real_malloc(size_t size);
 extern "C" void *__real_realloc(void *ptr, size_t size);
-extern "C" void  __real_free(void *ptr);
+extern "C" void __real_free(void *ptr);
 
-static void setTag(void *pv, unsigned int tag);
-static unsigned int *footerForChunk(void *pv);
-static unsigned int *headerForChunk(void *pv);
-static unsigned int sizeOfChunk(unsigned int *pHeader);
-static int isChunkInUse(void *pv);
+/* Optional functionality which charges each heap allocation to the module that made it, see HeapReport.h */
+#ifdef HEAP_TAGS
 
-extern "C" __attribute__((naked)) void __wrap_malloc(size_t size)
-{
-    __asm (
-        ".syntax unified\n"
-        ".thumb\n"
-        "mov r1,lr\n"
-        "b mallocWithTag\n"
-    );
-}
+#include "HeapReport.h"
 
-extern "C" void *mallocWithTag(size_t size, unsigned int tag)
+extern "C" void *__wrap_malloc(size_t size)
 {
-    void *p = __real_malloc(size + sizeof(tag));
-    if (!p && __smoothieHeapBase)
-        return p;
-    setTag(p, tag);
+    breakOnHeapOpFromInterruptHandler();
+    void *p = __real_malloc(size + HEAP_TAG_FOOTER);
+    if (p)
+        heap_tag_alloc(p);
     return p;
 }
 
-static void setTag(void *pv, unsigned int tag)
-{
-    unsigned int *pFooter = footerForChunk(pv);
-    *pFooter = tag;
-}
-
-static unsigned int *footerForChunk(void *pv)
-{
-    unsigned int *pHeader = headerForChunk(pv);
-    unsigned int  size = sizeOfChunk(pHeader);
-    return (unsigned int *)(void *)((char *)pHeader + size);
-}
-
-static unsigned int *headerForChunk(void *pv)
-{
-    // Header is allocated two words (8 bytes) before the publicly returned allocation chunk address.
-    unsigned int *p = (unsigned int *)pv;
-    return &p[-2];
-}
-
-static unsigned int sizeOfChunk(unsigned int *pHeader)
-{
-    /* Remove previous chunk in use flag. */
-    return pHeader[1] & ~1;
-}
-
-extern "C" __attribute__((naked)) void __wrap_realloc(void *ptr, size_t size)
-{
-    __asm (
-        ".syntax unified\n"
-        ".thumb\n"
-        "mov r2,lr\n"
-        "b reallocWithTag\n"
-    );
-}
-
-extern "C" void *reallocWithTag(void *ptr, size_t size, unsigned int tag)
+extern "C" void *__wrap_realloc(void *ptr, size_t size)
 {
-    void *p = __real_realloc(ptr, size + sizeof(tag));
-    if (!p)
-        return p;
-    setTag(p, tag);
+    breakOnHeapOpFromInterruptHandler();
+    if (ptr)
+        heap_tag_free(ptr);
+    void *p = __real_realloc(ptr, size + HEAP_TAG_FOOTER);
+    if (p)
+        heap_tag_alloc(p);
+    else if (ptr)
+        heap_tag_alloc(ptr); // the old block is still there
     return p;
 }
 
 extern "C" void __wrap_free(void *ptr)
 {
-    if (!isChunkInUse(ptr))
-        __debugbreak();
+    breakOnHeapOpFromInterruptHandler();
+    if (ptr)
+        heap_tag_free(ptr);
     __real_free(ptr);
 }
 
-static int isChunkInUse(void *pv)
-{
-    unsigned int *pFooter = footerForChunk(pv);
-    return pFooter[1] & 1;
-}
-
-__attribute__((naked)) void *operator new(size_t size)
-{
-    __asm (
-        ".syntax unified\n"
-        ".thumb\n"
-        "push {r4,lr}\n"
-        "mov r1,lr\n"
-        "bl mallocWithTag\n"
-        "cbnz r0, 1$\n"
-        "bl abort\n"
-        "1$:\n"
-        "pop {r4,pc}\n"
-    );
-    // This line never executes but silences no return value warning from compiler.
-    return (void *)1;
-}
-
 #else
 
-/* Wrap memory allocation routines to make sure that they aren't being called from interrupt handler. */
-static void breakOnHeapOpFromInterruptHandler(void)
-{
-    if (__get_IPSR() != 0)
-        __debugbreak();
-}
-
-extern "C" void *__real_malloc(size_t size);
 extern "C" void *__wrap_malloc(size_t size)
 {
     breakOnHeapOpFromInterruptHandler();
     return __real_malloc(size);
 }
 
-
-extern "C" void *__real_realloc(void *ptr, size_t size);
 extern "C" void *__wrap_realloc(void *ptr, size_t size)
 {
     breakOnHeapOpFromInterruptHandler();
     return __real_realloc(ptr, size);
 }
 
-
-extern "C" void __real_free(void *ptr);
 extern "C" void __wrap_free(void *ptr)
 {
     breakOnHeapOpFromInterruptHandler();
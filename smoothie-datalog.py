@@ -0,0 +1,68 @@
+#!/usr/bin/env python
+"""\
+Decode a log written by Smoothie's data logger into CSV
+"""
+
+from __future__ import print_function
+import sys
+import argparse
+import struct
+
+# Define command line argument interface
+parser = argparse.ArgumentParser(description='Decode a Smoothie data log into CSV.')
+parser.add_argument('file', type=argparse.FileType('rb'),
+        help='log file copied from the sd card')
+parser.add_argument('-o','--output',
+        help='write the CSV to this file instead of stdout')
+parser.add_argument('-c','--channel',
+        help='only output this channel (temperature, planner or position)')
+
+args = parser.parse_args()
+
+RECORD_SIZE = 32
+CHANNEL_NAME = 0
+CHANNELS = { 1: 'temperature', 2: 'planner', 3: 'position' }
+
+data = args.file.read()
+if len(data) < RECORD_SIZE or data[0:4] != b'SDLG':
+    print("Not a data log: {}".format(args.file.name), file=sys.stderr)
+    sys.exit(1)
+
+version, size, rate, mask = struct.unpack_from('<HHII', data, 4)
+if version != 1 or size != RECORD_SIZE:
+    print("Unsupported log version {} with {} byte records".format(version, size), file=sys.stderr)
+    sys.exit(1)
+
+out = open(args.output, 'w') if args.output else sys.stdout
+print("# rate {}Hz, channels {}".format(rate, ','.join(CHANNELS[c] for c in sorted(CHANNELS) if mask & (1 << c))), file=out)
+print("time_s,channel,index,name,v0,v1,v2,v3,v4,v5", file=out)
+
+names = {}
+last = None
+offset = 0
+for pos in range(RECORD_SIZE, len(data) - RECORD_SIZE + 1, RECORD_SIZE):
+    time, channel, index, count, flags = struct.unpack_from('<IBBBB', data, pos)
+    values = struct.unpack_from('<6f', data, pos + 8)
+
+    # a heater designator, stored as a string in place of the values
+    if channel == CHANNEL_NAME:
+        names[index] = data[pos + 8:pos + RECORD_SIZE].split(b'\0')[0].decode('ascii', 'replace')
+        continue
+
+    # the microsecond clock wraps every 71 minutes
+    if last is not None and time < last:
+        offset += 1 << 32
+    last = time
+
+    cname = CHANNELS.get(channel, str(channel))
+    if args.channel and args.channel != cname:
+        continue
+
+    name = names.get(index, '') if channel == 1 else ''
+    row = ["{:.6f}".format((time + offset) / 1e6), cname, str(index), name]
+    row += ["{:g}".format(v) for v in values[:count]]
+    row += [''] * (6 - count)
+    print(','.join(row), file=out)
+
+if out is not sys.stdout:
+    out.close()
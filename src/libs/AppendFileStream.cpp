@@ -3,10 +3,39 @@
 
 int AppendFileStream::puts(const char *str)
 {
+    size_t len= strlen(str);
+
+    // too big to be worth buffering
+    if(len >= buffer_size) {
+        if(!flush()) return 0;
+        FILE *fd= fopen(this->fn, "a");
+        if(fd == NULL) return 0;
+        int n= fwrite(str, 1, len, fd);
+        fclose(fd);
+        return n;
+    }
+
+    if(this->buf == NULL) {
+        this->buf= (char *)malloc(buffer_size);
+        if(this->buf == NULL) return 0;
+    }
+
+    if(this->buffered + len > buffer_size && !flush()) return 0;
+
+    memcpy(this->buf + this->buffered, str, len);
+    this->buffered += len;
+    return len;
+}
+
+bool AppendFileStream::flush()
+{
+    if(this->buffered == 0) return true;
+
     FILE *fd= fopen(this->fn, "a");
-    if(fd == NULL) return 0;
+    if(fd == NULL) return false;
 
-    int n= fwrite(str, 1, strlen(str), fd);
+    bool ok= fwrite(this->buf, 1, this->buffered, fd) == this->buffered;
     fclose(fd);
-    return n;
+    this->buffered= 0;
+    return ok;
 }
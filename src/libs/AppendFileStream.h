@@ -5,14 +5,26 @@
 #include "string.h"
 #include "stdlib.h"
 
+/*
+ * A stream that appends to a file, eg for logging
+ *
+ * Output is gathered and the file is only opened, written and closed when the buffer fills or on flush(), rather
+ * than for every puts. Whatever is still buffered is written when the stream is deleted.
+ */
+
 class AppendFileStream : public StreamOutput {
     public:
-        AppendFileStream(const char *filename) { fn= strdup(filename); }
-        virtual ~AppendFileStream(){ free(fn); }
+        AppendFileStream(const char *filename) { fn= strdup(filename); buf= NULL; buffered= 0; }
+        virtual ~AppendFileStream(){ flush(); free(buf); free(fn); }
         int puts(const char*);
+        bool flush();
 
     private:
+        static const size_t buffer_size= 512;
+
         char *fn;
+        char *buf;
+        size_t buffered;
 };
 
 #endif
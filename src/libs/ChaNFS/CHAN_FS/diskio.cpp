@@ -11,12 +11,111 @@
 #include "FATFileSystem.h"
 
 #include "mbed.h"
+#include "platform_memory.h"
+#include "DirectoryIndex.h"
+
+/*-----------------------------------------------------------------------*/
+/* Sector cache for the FAT and directories                              */
+/*-----------------------------------------------------------------------*/
+/* FatFs reads FAT and directory sectors into its window, fs->win, one   */
+/* at a time, and keeps only one of them. Walking a cluster chain or     */
+/* listing a directory swaps the same few sectors in and out again, so   */
+/* reads into the window are kept here, least recently used out first.   */
+/* Writes go through to the disk and update any cached copy.             */
+
+#ifndef DISK_CACHE_SECTORS
+#define DISK_CACHE_SECTORS	4
+#endif
+
+typedef struct {
+	DWORD sector;
+	DWORD used;		/* last use, for the LRU */
+	BYTE drv;
+	BYTE valid;
+} cache_entry_t;
+
+static cache_entry_t cache_entries[DISK_CACHE_SECTORS];
+static BYTE *cache_data = NULL;
+static DWORD cache_clock = 0;
+static BYTE cache_failed = 0;
+
+static BYTE *cache_sector (int i)
+{
+	return cache_data + (i * 512);
+}
+
+/* The cache lives in an AHB bank, allocated the first time it is needed */
+static int cache_ready (void)
+{
+	if (cache_data == NULL && !cache_failed) {
+		cache_data = (BYTE*)AHB1.alloc(DISK_CACHE_SECTORS * 512);
+		if (cache_data == NULL)
+			cache_data = (BYTE*)AHB0.alloc(DISK_CACHE_SECTORS * 512);
+		if (cache_data == NULL)
+			cache_failed = 1;
+	}
+	return cache_data != NULL;
+}
+
+static int cache_find (BYTE drv, DWORD sector)
+{
+	for (int i = 0; i < DISK_CACHE_SECTORS; i++) {
+		if (cache_entries[i].valid && cache_entries[i].drv == drv && cache_entries[i].sector == sector)
+			return i;
+	}
+	return -1;
+}
+
+static void cache_store (BYTE drv, DWORD sector, const BYTE *buff)
+{
+	int victim = 0;
+	for (int i = 0; i < DISK_CACHE_SECTORS; i++) {
+		if (!cache_entries[i].valid) {
+			victim = i;
+			break;
+		}
+		if (cache_entries[i].used < cache_entries[victim].used)
+			victim = i;
+	}
+	memcpy(cache_sector(victim), buff, 512);
+	cache_entries[victim].drv = drv;
+	cache_entries[victim].sector = sector;
+	cache_entries[victim].used = ++cache_clock;
+	cache_entries[victim].valid = 1;
+}
+
+/* Keep cached copies in step with sectors written through FatFs */
+static void cache_update (BYTE drv, const BYTE *buff, DWORD sector, BYTE count)
+{
+	if (cache_data == NULL)
+		return;
+	for (BYTE n = 0; n < count; n++) {
+		int i = cache_find(drv, sector + n);
+		if (i >= 0)
+			memcpy(cache_sector(i), buff + (n * 512), 512);
+	}
+}
+
+/* For writers that go around FatFs, eg USB mass storage, which do not know the drive so it is dropped on all of them */
+void disk_cache_invalidate (
+	DWORD sector,	/* First sector written */
+	DWORD count		/* Number of sectors written */
+)
+{
+	for (int i = 0; i < DISK_CACHE_SECTORS; i++) {
+		if (cache_entries[i].sector >= sector && cache_entries[i].sector - sector < count)
+			cache_entries[i].valid = 0;
+	}
+}
 
 DSTATUS disk_initialize (
 	BYTE drv				/* Physical drive nmuber (0..) */
 )
 {
 	FFSDEBUG("disk_initialize on drv [%d]\n", drv);
+	disk_cache_invalidate(0, 0xFFFFFFFF);
+	// possibly another card
+	DirectoryIndex::invalidate();
 	return (DSTATUS)FATFileSystem::_ffs[drv]->disk_initialize();
 }
 
@@ -36,6 +135,23 @@ DRESULT disk_read (
 )
 {
 	FFSDEBUG("disk_read(sector %d, count %d) on drv [%d]\n", sector, count, drv);
+	// only the window holds FAT and directory sectors, file data is not worth caching
+	int cacheable = (count == 1) && (buff == FATFileSystem::_ffs[drv]->_fs.win) && cache_ready();
+	if(cacheable) {
+		int i = cache_find(drv, sector);
+		if(i >= 0) {
+			cache_entries[i].used = ++cache_clock;
+			memcpy(buff, cache_sector(i), 512);
+			return RES_OK;
+		}
+	}
+	if(count > 1) {
+		// one multiple block command instead of a command per sector
+		if(FATFileSystem::_ffs[drv]->disk_read_blocks((char*)buff, sector, count)) {
+			return RES_PARERR;
+		}
+		return RES_OK;
+	}
 	for(unsigned int s=sector; s<sector+count; s++) {
 		FFSDEBUG(" disk_read(sector %d)\n", s);
 		int res = FATFileSystem::_ffs[drv]->disk_read((char*)buff, s);
@@ -44,6 +160,9 @@ DRESULT disk_read (
 		}
 		buff += 512;
 	}
+	if(cacheable) {
+		cache_store(drv, sector, buff - 512);
+	}
 	return RES_OK;
 }
 
@@ -56,9 +175,16 @@ DRESULT disk_write (
 )
 {
 	FFSDEBUG("disk_write(sector %d, count %d) on drv [%d]\n", sector, count, drv);
+	cache_update(drv, buff, sector, count);
+	if(count > 1) {
+		if(FATFileSystem::_ffs[drv]->disk_write_blocks((const char*)buff, sector, count)) {
+			return RES_PARERR;
+		}
+		return RES_OK;
+	}
 	for(unsigned int s=sector; s<sector+count; s++) {
 		FFSDEBUG(" disk_write(sector %d)\n", s);
-		int res = FATFileSystem::_ffs[drv]->disk_write((char*)buff, sector);
+		int res = FATFileSystem::_ffs[drv]->disk_write((const char*)buff, s);
 		if(res) {
 			return RES_PARERR;
 		}
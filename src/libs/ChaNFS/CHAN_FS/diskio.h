@@ -34,6 +34,7 @@ DRESULT disk_read (BYTE, BYTE*, DWORD, BYTE);
 DRESULT disk_write (BYTE, const BYTE*, DWORD, BYTE);
 #endif
 DRESULT disk_ioctl (BYTE, BYTE, void*);
+void	disk_cache_invalidate (DWORD, DWORD);
 void	disk_timerproc (void);
 
 
@@ -8,6 +8,7 @@
 #include <stdlib.h>
 #include "ff.h"
 #include "FATFileSystem.h"
+#include "DirectoryIndex.h"
 
 namespace mbed {
 
@@ -30,17 +31,48 @@ static const char *FR_ERRORS[] = {
 };
 #endif
 
+// a fragmented file needs two entries per fragment, past this the FAT walk is the lesser evil
+#define MAX_LINK_MAP 128
+
 FATFileHandle::FATFileHandle(FIL_t fh) {
     _fh = fh;
 }
     
 int FATFileHandle::close() {
     FFSDEBUG("close\n");
+    // the size and date in the listing are out of date
+    if(_fh.flag & FA__WRITTEN) DirectoryIndex::invalidate();
     int retval = f_close(&_fh);
+    free(_fh.cltbl);
     delete this;
     return retval;
 }
 
+// Fast seek: FatFs keeps a table of the fragments of the file, so it finds the cluster for an offset without
+// following the chain from the start of the file. FatFs can not grow a file that has a table.
+void FATFileHandle::build_link_map() {
+    // a file in one cluster has no chain to walk
+    if(_fh.fsize <= (DWORD)_fh.fs->csize * 512) return;
+
+    // start with room for three fragments, most files are in one piece
+    DWORD size = 8;
+    for(int tries = 0; tries < 2; tries++) {
+        DWORD *tbl = (DWORD *)malloc(size * sizeof(DWORD));
+        if(tbl == NULL) return;
+        tbl[0] = size;
+        _fh.cltbl = tbl;
+        FRESULT res = f_lseek(&_fh, CREATE_LINKMAP);
+        if(res == FR_OK) return;
+
+        // on FR_NOT_ENOUGH_CORE the first entry says how big it needs to be
+        DWORD needed = tbl[0];
+        _fh.cltbl = NULL;
+        free(tbl);
+        if(res != FR_NOT_ENOUGH_CORE || needed > MAX_LINK_MAP) return;
+        size = needed;
+    }
+}
+
 ssize_t FATFileHandle::write(const void* buffer, size_t length) {
     FFSDEBUG("write(%d)\n", length);
     UINT n;
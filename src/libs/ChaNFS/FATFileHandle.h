@@ -22,6 +22,9 @@ public:
     virtual int fsync();
     virtual off_t flen();
 
+    // map the cluster chain so seeks do not walk the FAT, only for files opened read only
+    void build_link_map();
+
 protected:
 
     FIL_t _fh;
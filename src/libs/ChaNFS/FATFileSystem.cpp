@@ -9,6 +9,7 @@
 #include "FileSystemLike.h"
 #include "FATFileHandle.h"
 #include "FATDirHandle.h"
+#include "DirectoryIndex.h"
 #include "ff.h"
 //#include "Debug.h"
 #include <stdio.h>
@@ -86,6 +87,10 @@ FileHandle *FATFileSystem::open(const char* name, int flags) {
         }
     }
 
+    if(openmode & FA_WRITE) {
+        DirectoryIndex::invalidate();
+    }
+
     FIL_t fh;
     FRESULT res = f_open(&fh, n, openmode);
     if(res) {
@@ -95,10 +100,15 @@ FileHandle *FATFileSystem::open(const char* name, int flags) {
     if(flags & O_APPEND) {
         f_lseek(&fh, fh.fsize);
     }
-    return new FATFileHandle(fh);
+    FATFileHandle *handle = new FATFileHandle(fh);
+    if(openmode == FA_READ) {
+        handle->build_link_map();
+    }
+    return handle;
 }
     
 int FATFileSystem::remove(const char *filename) {
+    DirectoryIndex::invalidate();
     FRESULT res = f_unlink(filename);
     if(res) {
         FFSDEBUG("f_unlink() failed (%d, %s)\n", res, FR_ERRORS[res]);
@@ -107,8 +117,22 @@ int FATFileSystem::remove(const char *filename) {
     return 0;
 }
 
+int FATFileSystem::rename(const char *oldname, const char *newname) {
+    // the new name is always on the same drive as the old one
+    char n[64];
+    sprintf(n, "%d:/%s", _fsid, oldname);
+    DirectoryIndex::invalidate();
+    FRESULT res = f_rename(n, newname);
+    if(res) {
+        FFSDEBUG("f_rename() failed (%d, %s)\n", res, FR_ERRORS[res]);
+        return -1;
+    }
+    return 0;
+}
+
 int FATFileSystem::format() {
     FFSDEBUG("format()\n");
+    DirectoryIndex::invalidate();
     FRESULT res = f_mkfs(_fsid, 0, 512); // Logical drive number, Partitioning rule, Allocation unit size (bytes per cluster)
     if(res) {
         FFSDEBUG("f_mkfs() failed (%d, %s)\n", res, FR_ERRORS[res]);
@@ -127,6 +151,7 @@ DirHandle *FATFileSystem::opendir(const char *name) {
 }
 
 int FATFileSystem::mkdir(const char *name, mode_t mode) {
+    DirectoryIndex::invalidate();
     FRESULT res = f_mkdir(name);
     return res == 0 ? 0 : -1;
 }
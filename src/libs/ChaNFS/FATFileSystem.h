@@ -39,6 +39,7 @@ public:
        */
     virtual FileHandle *open(const char* name, int flags);
     virtual int remove(const char *filename);
+    virtual int rename(const char *oldname, const char *newname);
     virtual int format();
         virtual DirHandle *opendir(const char *name);
         virtual int mkdir(const char *name, mode_t mode);
@@ -51,6 +52,17 @@ public:
     virtual int disk_status() { return 0; }
     virtual int disk_read(char *buffer, int sector) = 0;
     virtual int disk_write(const char *buffer, int sector) = 0;
+    // several consecutive sectors at once, for disks that can stream them
+    virtual int disk_read_blocks(char *buffer, int sector, int count) {
+        for (int i = 0; i < count; i++)
+            if (disk_read(buffer + (i * 512), sector + i)) return 1;
+        return 0;
+    }
+    virtual int disk_write_blocks(const char *buffer, int sector, int count) {
+        for (int i = 0; i < count; i++)
+            if (disk_write(buffer + (i * 512), sector + i)) return 1;
+        return 0;
+    }
     virtual int disk_sync() { return 0; }
     virtual int disk_sectors() = 0;
      
@@ -8,6 +8,7 @@
 using namespace std;
 #include <vector>
 #include <string>
+#include <algorithm>
 
 #include "libs/Kernel.h"
 #include "Config.h"
@@ -17,6 +18,7 @@ using namespace std;
 #include "libs/nuts_bolts.h"
 #include "libs/utils.h"
 #include "libs/SerialMessage.h"
+#include "libs/FileStream.h"
 #include "libs/ConfigSources/FileConfigSource.h"
 #include "libs/ConfigSources/FirmConfigSource.h"
 #include "StreamOutputPool.h"
@@ -26,6 +28,8 @@ using namespace std;
 Config::Config()
 {
     this->config_cache = NULL;
+    this->reading_module = NULL;
+    this->digests_taken = false;
 
     // Config source for firm config found in src/config.default
     this->config_sources.push_back( new FirmConfigSource("firm") );
@@ -70,6 +74,14 @@ void Config::config_cache_load(bool parse)
         for( ConfigSource *source : this->config_sources ) {
             source->transfer_values_to_cache(this->config_cache);
         }
+        // sort the cache so all the lookups modules do from now on are fast
+        this->config_cache->build_index();
+
+        // the first load is the one the modules configure themselves from at boot
+        if(!this->digests_taken) {
+            this->config_cache->family_digests(&this->family_digests);
+            this->digests_taken = true;
+        }
     }
 }
 
@@ -103,6 +115,8 @@ ConfigValue *Config::value(uint16_t check_sums[])
         return NULL;
     }
 
+    if(this->reading_module != NULL) note_family_read(check_sums[0]);
+
     ConfigValue *result = this->config_cache->lookup(check_sums);
 
     if(result == NULL) {
@@ -118,3 +132,109 @@ ConfigValue *Config::value(uint16_t check_sums[])
 
 
 
+
+Module *Config::set_reading_module(Module *module)
+{
+    Module *previous = this->reading_module;
+    this->reading_module = module;
+    return previous;
+}
+
+void Config::note_family_read(uint16_t family)
+{
+    // modules read a family many times in a row, so the last entry is the common hit
+    for (auto it = this->family_readers.rbegin(); it != this->family_readers.rend(); ++it) {
+        if(it->family == family && it->module == this->reading_module) return;
+    }
+    this->family_readers.push_back({family, this->reading_module});
+}
+
+typedef void (*ConfigReloadHandler)(Module *, void *);
+
+// True if the module has its own on_config_reload, otherwise it only reads its config when loaded
+static bool can_reload(Module *module)
+{
+    static Module base;
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpmf-conversions"
+    return (ConfigReloadHandler)(module->*(&Module::on_config_reload)) != (ConfigReloadHandler)(base.*(&Module::on_config_reload));
+#pragma GCC diagnostic pop
+}
+
+// Reparse all the sources, compare each family with what the modules were configured with,
+// and call on_config_reload only on the modules that read a family that changed
+int Config::reload_changed(StreamOutput *stream)
+{
+    this->config_cache_load();
+
+    vector<ConfigFamilyDigest> digests;
+    this->config_cache->family_digests(&digests);
+
+    // both lists are sorted on the family, a family only in one of them has changed too
+    vector<uint16_t> changed;
+    size_t i = 0, j = 0;
+    while(i < this->family_digests.size() || j < digests.size()) {
+        if(j == digests.size() || (i < this->family_digests.size() && this->family_digests[i].family < digests[j].family)) {
+            changed.push_back(this->family_digests[i++].family);
+        } else if(i == this->family_digests.size() || digests[j].family < this->family_digests[i].family) {
+            changed.push_back(digests[j++].family);
+        } else {
+            if(this->family_digests[i].hash != digests[j].hash) changed.push_back(digests[j].family);
+            i++; j++;
+        }
+    }
+
+    // the modules to reload, in the order they were loaded
+    vector<Module *> modules;
+    for( uint16_t family : changed ) {
+        bool reloadable = false;
+        for( auto &r : this->family_readers ) {
+            if(r.family != family) continue;
+            if(can_reload(r.module)) {
+                reloadable = true;
+                if(find(modules.begin(), modules.end(), r.module) == modules.end()) modules.push_back(r.module);
+            }
+        }
+        if(!reloadable) {
+            stream->printf("settings with checksum %04X changed but are only read at boot, reset to apply them\n", family);
+        }
+    }
+
+    for( Module *module : modules ) {
+        Module *previous = set_reading_module(module);
+        module->on_config_reload(module);
+        set_reading_module(previous);
+    }
+
+    this->family_digests.swap(digests);
+    this->config_cache_clear();
+
+    stream->printf("%d families changed, %d modules reloaded\n", (int)changed.size(), (int)modules.size());
+
+    // the reloaded modules went back to the config values, put the settings saved by M500 back on top as at boot
+    if(!modules.empty()) load_override(stream);
+
+    return modules.size();
+}
+
+void Config::load_override(StreamOutput *stream)
+{
+    // in case power went while it was last saved
+    FileStream::recover(THEKERNEL->config_override_filename());
+
+    // load config override file if present
+    // NOTE only Mxxx commands that set values should be put in this file. The file is generated by M500
+    FILE *fp= fopen(THEKERNEL->config_override_filename(), "r");
+    if(fp != NULL) {
+        char buf[132];
+        stream->printf("Loading config override file: %s...\n", THEKERNEL->config_override_filename());
+        while(fgets(buf, sizeof buf, fp) != NULL) {
+            stream->printf("  %s", buf);
+            if(buf[0] == ';') continue; // skip the comments
+            struct SerialMessage message= {&(StreamOutput::NullStream), buf};
+            THEKERNEL->call_event(ON_CONSOLE_LINE_RECEIVED, &message);
+        }
+        stream->printf("config override file executed\n");
+        fclose(fp);
+    }
+}
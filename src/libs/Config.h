@@ -13,9 +13,11 @@ using namespace std;
 #include <vector>
 #include <string>
 
+#include "ConfigCache.h"
+
 class ConfigValue;
 class ConfigSource;
-class ConfigCache;
+class StreamOutput;
 
 class Config : public Module {
     public:
@@ -31,15 +33,32 @@ class Config : public Module {
         ConfigValue* value(uint16_t check_sums[3] );
 
         void get_module_list(vector<uint16_t>* list, uint16_t family);
+
+        // reparse the sources and reload only the modules that read a family that changed
+        int reload_changed(StreamOutput *stream);
+        // run the M codes saved by M500, after the config at boot and after a reload
+        void load_override(StreamOutput *stream);
+        // the module whose config reads are being recorded, returns the previous one
+        Module *set_reading_module(Module *module);
         bool is_config_cache_loaded() { return config_cache != NULL; };    // Whether or not the cache is currently popluated
 
         friend class  Configurator;
 
     private:
         bool   has_characters(uint16_t check_sum, string str );
+        void   note_family_read(uint16_t family);
+
+        struct FamilyReader {
+            uint16_t family;
+            Module *module;
+        };
 
         ConfigCache* config_cache;            // A cache in which ConfigValues are kept
         vector<ConfigSource*> config_sources; // A list of all possible coniguration sources
+        vector<FamilyReader> family_readers;  // Which modules read which checksum families
+        vector<ConfigFamilyDigest> family_digests; // Hash of each family as the modules were last configured with
+        Module *reading_module;               // Module whose reads go into family_readers, NULL when not recording
+        bool   digests_taken;
 };
 
 #endif
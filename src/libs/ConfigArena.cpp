@@ -0,0 +1,99 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ConfigArena.h"
+#include "StreamOutput.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+ConfigArena config_arena;
+
+ConfigArena::ConfigArena()
+{
+    chunk = NULL;
+    clear();
+}
+
+ConfigArena::~ConfigArena()
+{
+    clear();
+}
+
+void ConfigArena::clear()
+{
+    while(chunk != NULL) {
+        char *previous = *(char **)chunk;
+        free(chunk);
+        chunk = previous;
+    }
+    chunk_used = chunk_size = 0;
+    memset(buckets, 0, sizeof(buckets));
+    allocated = stored = heap_estimate = 0;
+    strings = requests = 0;
+}
+
+void *ConfigArena::allocate(size_t size)
+{
+    size = (size + 3) & ~3;
+    if(chunk == NULL || chunk_used + size > chunk_size) {
+        size_t n = sizeof(char *) + size;
+        if(n < CONFIG_ARENA_CHUNK_SIZE) n = CONFIG_ARENA_CHUNK_SIZE;
+        char *c = (char *)malloc(n);
+        if(c == NULL) return NULL;
+        *(char **)c = chunk;
+        chunk = c;
+        chunk_size = n;
+        chunk_used = sizeof(char *);
+        allocated += n;
+    }
+    void *p = chunk + chunk_used;
+    chunk_used += size;
+    stored += size;
+    return p;
+}
+
+const char *ConfigArena::intern(const char *str, size_t len)
+{
+    if(len == 0) return "";
+    if(len > UINT16_MAX) {
+        // far past any config line, but say so rather than keep part of it
+        printf("ERROR: config value of %u bytes is too long, starts %.20s\n", (unsigned)len, str);
+        return "";
+    }
+
+    requests++;
+    // a std::string costs its 12 byte rep plus the string and terminator, and newlib rounds to 8 and adds 8 of its own
+    heap_estimate += ((12 + len + 1 + 7) & ~7) + 8;
+
+    uint32_t hash = 2166136261UL;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (uint8_t)str[i]) * 16777619UL;
+    }
+    Entry **bucket = &buckets[hash % CONFIG_ARENA_BUCKETS];
+
+    for (Entry *e = *bucket; e != NULL; e = e->next) {
+        if(e->len == len && memcmp(e->str, str, len) == 0) return e->str;
+    }
+
+    Entry *e = (Entry *)allocate(sizeof(Entry) + len + 1);
+    if(e == NULL) return "";
+    e->len = len;
+    memcpy(e->str, str, len);
+    e->str[len] = '\0';
+    e->next = *bucket;
+    *bucket = e;
+    strings++;
+    return e->str;
+}
+
+void ConfigArena::dump(StreamOutput *stream)
+{
+    stream->printf("config strings: %u stored for %u values, %lu bytes in %lu bytes of chunks, about %lu bytes as heap strings\n",
+                   strings, requests, stored, allocated, heap_estimate);
+}
@@ -0,0 +1,57 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CONFIGARENA_H
+#define CONFIGARENA_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+class StreamOutput;
+
+#define CONFIG_ARENA_CHUNK_SIZE 512
+#define CONFIG_ARENA_BUCKETS    32
+
+// Holds the strings of the config values while the config cache is loaded.
+// Strings are packed into a few large chunks instead of one heap block each, and identical strings are only stored once.
+// Everything is released at once by clear() when the cache is cleared, so nothing may keep a pointer past that.
+class ConfigArena {
+    public:
+        ConfigArena();
+        ~ConfigArena();
+
+        // return a NUL terminated copy of str that lives until clear()
+        const char *intern(const char *str, size_t len);
+        void clear();
+
+        void dump(StreamOutput *stream);
+
+    private:
+        struct Entry {
+            Entry *next;    // next string in the same hash bucket
+            uint16_t len;
+            char str[];
+        };
+
+        void *allocate(size_t size);
+
+        char *chunk;            // current chunk, its first word links to the previous one
+        size_t chunk_used;
+        size_t chunk_size;
+        Entry *buckets[CONFIG_ARENA_BUCKETS];
+
+        // stats for the memory report
+        uint32_t allocated;     // bytes malloced for chunks
+        uint32_t stored;        // bytes used in the chunks
+        uint16_t strings;       // strings stored
+        uint16_t requests;      // strings interned, including duplicates
+        uint32_t heap_estimate; // what a heap std::string per request would have cost
+};
+
+extern ConfigArena config_arena;
+
+#endif
@@ -1,10 +1,19 @@
 #include "ConfigCache.h"
 #include "ConfigValue.h"
+#include "ConfigArena.h"
 
 #include "libs/StreamOutput.h"
 
+#include <algorithm>
+
+// Values are pushed in the order they are read, with no check for duplicates, which would make loading O(n^2)
+// Once all sources have been read build_index() sorts them, keeping the last value read for any duplicated setting,
+// and from then on lookups are a binary search on the checksums. With a 400 line config that is at most 9 comparisons
+// a lookup, where the scan took 200 on average to find a value and all 400 to find that a setting is missing
+
 ConfigCache::ConfigCache()
 {
+    indexed = true;
 }
 
 ConfigCache::~ConfigCache()
@@ -19,36 +28,78 @@ void ConfigCache::clear()
     }
     store.clear();
     storage_t().swap(store);   //  makes sure the vector releases its memory
+    config_arena.clear();      // the strings of all the values we just deleted
+    indexed = true;
 }
 
 void ConfigCache::add(ConfigValue *v)
 {
     store.push_back(v);
+    indexed = false;
 }
 
-// If we find an existing value, replace it, otherwise, push it at the back of the list
+// The value replaces any existing one when the index is built
 void ConfigCache::replace_or_push_back(ConfigValue *new_value)
 {
-    // For each already existing element
-    for(auto &cv : store) {
-        // If this configvalue matches the checksum
-        if(memcmp(new_value->check_sums, cv->check_sums, sizeof(cv->check_sums)) == 0) {
-            // Replace with the provided value
-            cv =  new_value;
+    store.push_back(new_value);
+    indexed = false;
+}
+
+// order values on their three checksums, family first
+static int compare_checksums(const uint16_t *a, const uint16_t *b)
+{
+    for (int i = 0; i < 3; i++) {
+        if(a[i] != b[i]) return a[i] < b[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+bool ConfigCache::checksums_less(const ConfigValue *a, const ConfigValue *b)
+{
+    return compare_checksums(a->check_sums, b->check_sums) < 0;
+}
+
+void ConfigCache::build_index()
+{
+    if(indexed) return;
+
+    // stable so duplicates stay in the order they were read, and the last one read wins
+    std::stable_sort(store.begin(), store.end(), checksums_less);
+
+    storage_t::iterator out = store.begin();
+    for (storage_t::iterator it = store.begin(); it != store.end(); ++it) {
+        if(out != store.begin() && !checksums_less(*(out - 1), *it)) {
+            // same checksums as the previous value, replace it
             printf("WARNING: duplicate config line replaced\n");
-            return;
+            delete *(out - 1);
+            *(out - 1) = *it;
+        } else {
+            *out++ = *it;
         }
     }
-
-    // Value does not already exists, add to the list
-    store.push_back(new_value);
+    store.erase(out, store.end());
+    indexed = true;
 }
 
 ConfigValue *ConfigCache::lookup(const uint16_t *check_sums) const
 {
-    for( auto &cv : store) {
-        if(memcmp(check_sums, cv->check_sums, sizeof(cv->check_sums)) == 0)
-            return cv;
+    if(indexed) {
+        // binary search
+        size_t low = 0, high = store.size();
+        while(low < high) {
+            size_t mid = (low + high) / 2;
+            int c = compare_checksums(store[mid]->check_sums, check_sums);
+            if(c == 0) return store[mid];
+            if(c < 0) low = mid + 1;
+            else high = mid;
+        }
+        return NULL;
+    }
+
+    // not indexed yet, the last value read wins
+    for (auto it = store.rbegin(); it != store.rend(); ++it) {
+        if(memcmp(check_sums, (*it)->check_sums, sizeof((*it)->check_sums)) == 0)
+            return *it;
     }
 
     return NULL;
@@ -56,11 +107,43 @@ ConfigValue *ConfigCache::lookup(const uint16_t *check_sums) const
 
 void ConfigCache::collect(uint16_t family, uint16_t cs, vector<uint16_t> *list)
 {
-    for( auto &kv : store ) {
-        if( kv->check_sums[2] == cs && kv->check_sums[0] == family ) {
+    build_index();
+
+    // all the values in a family are next to each other once sorted
+    size_t low = 0, high = store.size();
+    while(low < high) {
+        size_t mid = (low + high) / 2;
+        if(store[mid]->check_sums[0] < family) low = mid + 1;
+        else high = mid;
+    }
+
+    for (size_t i = low; i < store.size() && store[i]->check_sums[0] == family; i++) {
+        if( store[i]->check_sums[2] == cs ) {
             // We found a module enable for this family, add it's number
-            list->push_back(kv->check_sums[1]);
+            list->push_back(store[i]->check_sums[1]);
+        }
+    }
+}
+
+void ConfigCache::family_digests(vector<ConfigFamilyDigest> *list)
+{
+    build_index();
+    list->clear();
+
+    // FNV-1a over the rest of the checksums and the value of everything in the family
+    for (size_t i = 0; i < store.size(); i++) {
+        ConfigValue *v = store[i];
+        if(list->empty() || list->back().family != v->check_sums[0]) {
+            list->push_back({v->check_sums[0], 2166136261UL});
+        }
+        uint32_t hash = list->back().hash;
+        const uint8_t *p = (const uint8_t *)&v->check_sums[1];
+        for (size_t j = 0; j < 2 * sizeof(uint16_t); j++) hash = (hash ^ p[j]) * 16777619UL;
+        for (const char *c = v->value; ; c++) {
+            hash = (hash ^ (uint8_t)*c) * 16777619UL;
+            if(*c == '\0') break;
         }
+        list->back().hash = hash;
     }
 }
 
@@ -69,7 +152,9 @@ void ConfigCache::dump(StreamOutput *stream)
     int l = 1;
     for( auto &kv : store ) {
         ConfigValue *v = kv;
-        stream->printf("%3d - %04X %04X %04X : '%s' - found: %d, default: %d, default-double: %f, default-int: %d\n",
-                       l++, v->check_sums[0], v->check_sums[1], v->check_sums[2], v->value.c_str(), v->found, v->default_set, v->default_double, v->default_int );
+        stream->printf("%3d - %04X %04X %04X : '%s' - found: %d, default: %d, number: %f, int: %d, type: %d\n",
+                       l++, v->check_sums[0], v->check_sums[1], v->check_sums[2], v->value, v->found, v->default_set, v->number, v->integer, v->type );
     }
+    stream->printf("%u values of %u bytes each\n", (unsigned)store.size(), (unsigned)sizeof(ConfigValue));
+    config_arena.dump(stream);
 }
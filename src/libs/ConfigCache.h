@@ -16,6 +16,12 @@ using namespace std;
 class ConfigValue;
 class StreamOutput;
 
+// hash of all the values in one checksum family, used to find what changed between two loads
+struct ConfigFamilyDigest {
+    uint16_t family;
+    uint32_t hash;
+};
+
 class ConfigCache {
     public:
         ConfigCache();
@@ -33,12 +39,21 @@ class ConfigCache {
         // If we find an existing value, replace it, otherwise, push it at the back of the list
         void replace_or_push_back(ConfigValue* new_value);
 
+        // sort the values on their checksums so lookups are a binary search, duplicates are resolved here too
+        void build_index();
+
+        // one digest per family, sorted on the family, builds the index first
+        void family_digests(vector<ConfigFamilyDigest> *list);
+
         // used for debugging, dumps the cache to a stream
         void dump(StreamOutput *stream);
 
     private:
+        static bool checksums_less(const ConfigValue* a, const ConfigValue* b);
+
         typedef vector<ConfigValue*> storage_t;
         storage_t store;
+        bool indexed; // store is sorted by checksum and has no duplicates
 };
 
 
@@ -5,46 +5,49 @@
 
 #include "stdio.h"
 
-ConfigValue* ConfigSource::process_line(const string &buffer)
+// Split a line into the checksums of its key and its value, return false if it holds no setting
+bool ConfigSource::parse_line(const string &buffer, uint16_t check_sums[3], size_t &begin_value, size_t &value_length)
 {
     if( buffer[0] == '#' ) {
-        return NULL;
+        return false;
     }
     if( buffer.length() < 3 ) {
-        return NULL;
+        return false;
     }
 
     size_t begin_key = buffer.find_first_not_of(" \t");
-    if(begin_key == string::npos || buffer[begin_key] == '#') return NULL; // comment line or blank line
+    if(begin_key == string::npos || buffer[begin_key] == '#') return false; // comment line or blank line
 
     size_t end_key = buffer.find_first_of(" \t", begin_key);
     if(end_key == string::npos) {
         printf("ERROR: config file line %s is invalid, no key value pair found\r\n", buffer.c_str());
-        return NULL;
+        return false;
     }
 
-    size_t begin_value = buffer.find_first_not_of(" \t", end_key);
+    begin_value = buffer.find_first_not_of(" \t", end_key);
     if(begin_value == string::npos || buffer[begin_value] == '#') {
         printf("ERROR: config file line %s has no value\r\n", buffer.c_str());
-        return NULL;
+        return false;
     }
 
     string key= buffer.substr(begin_key,  end_key - begin_key);
-    uint16_t check_sums[3];
     get_checksums(check_sums, key);
 
-    ConfigValue *result = new ConfigValue;
+    size_t end_value = buffer.find_first_of("\r\n# \t", begin_value + 1);
+    value_length = end_value == string::npos ? buffer.size() - begin_value : end_value - begin_value;
+    return true;
+}
 
-    result->found = true;
-    result->check_sums[0] = check_sums[0];
-    result->check_sums[1] = check_sums[1];
-    result->check_sums[2] = check_sums[2];
+ConfigValue* ConfigSource::process_line(const string &buffer)
+{
+    uint16_t check_sums[3];
+    size_t begin_value, value_length;
+    if(!parse_line(buffer, check_sums, begin_value, value_length)) return NULL;
 
-    size_t end_value = buffer.find_first_of("\r\n# \t", begin_value + 1);
-    size_t vsize = end_value == string::npos ? end_value : end_value - begin_value;
-    result->value = buffer.substr(begin_value, vsize);
+    ConfigValue *result = new ConfigValue(check_sums);
+    result->found = true;
+    result->set_value(buffer.data() + begin_value, value_length);
 
-    //printf("key: %s, value: %s\n\n", key.c_str(), result->value.c_str());
     return result;
 }
 
@@ -59,15 +62,14 @@ ConfigValue* ConfigSource::process_line_from_ascii_config(const string &buffer,
     return NULL;
 }
 
+// Return the value if the line holds the setting with the given checksums, without going through a ConfigValue
 string ConfigSource::process_line_from_ascii_config(const string &buffer, uint16_t line_checksums[3])
 {
-    string value= "";
-    ConfigValue *result = process_line(buffer);
-    if(result != NULL) {
-        if(result->check_sums[0] == line_checksums[0] && result->check_sums[1] == line_checksums[1] && result->check_sums[2] == line_checksums[2]) {
-            value= result->value;
-        }
-        delete result;
+    uint16_t check_sums[3];
+    size_t begin_value, value_length;
+    if(parse_line(buffer, check_sums, begin_value, value_length) &&
+       check_sums[0] == line_checksums[0] && check_sums[1] == line_checksums[1] && check_sums[2] == line_checksums[2]) {
+        return buffer.substr(begin_value, value_length);
     }
-    return value;
+    return "";
 }
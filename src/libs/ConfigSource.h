@@ -31,6 +31,7 @@ class ConfigSource {
         uint16_t name_checksum;
 
     private:
+        bool parse_line(const string &buffer, uint16_t check_sums[3], size_t &begin_value, size_t &value_length);
         ConfigValue* process_line(const string &buffer);
 };
 
@@ -11,6 +11,7 @@
 #include "ConfigCache.h"
 #include "checksumm.h"
 #include "utils.h"
+#include "DirectoryIndex.h"
 #include <malloc.h>
 
 using namespace std;
@@ -55,10 +56,19 @@ void FileConfigSource::transfer_values_to_cache( ConfigCache *cache )
     if( !this->has_config_file() ) {
         return;
     }
-    transfer_values_to_cache( cache, this->get_config_file().c_str());
+
+    // the snapshot is only used if none of the files it was made from have changed
+    if(load_snapshot(cache)) return;
+
+    parse_file(cache, this->get_config_file().c_str());
+    save_snapshot();
+
+    this->parsed_files.clear();
+    this->parsed_values.clear();
 }
 
-void FileConfigSource::transfer_values_to_cache( ConfigCache *cache, const char * file_name )
+// Parse the file line by line, and any files it includes
+void FileConfigSource::parse_file( ConfigCache *cache, const char *file_name )
 {
     if( !file_exists(file_name) ) {
         return;
@@ -66,6 +76,7 @@ void FileConfigSource::transfer_values_to_cache( ConfigCache *cache, const char
 
     // Open the config file ( find it if we haven't already found it )
     FILE *lp = fopen(file_name, "r");
+    this->parsed_files.push_back(file_name);
 
     int ln= 1;
     // For each line
@@ -74,21 +85,28 @@ void FileConfigSource::transfer_values_to_cache( ConfigCache *cache, const char
         if(readLine(line, ln++, lp)) {
             // process the config line and store the value in cache
             ConfigValue* cv = process_line_from_ascii_config(line, cache);
+            if(cv == NULL) continue;
+            this->parsed_values.push_back(cv);
 
             // if this line is an include directive then attempt to read the included file
             if(cv->check_sums[0] == include_checksum) {
-                string inc_file_name = cv->value.c_str();
+                string inc_file_name = cv->value;
                 if(!file_exists(inc_file_name)) {
+                    // the snapshot has to notice if a file appears where we looked, so each miss is kept as a file read
+                    this->parsed_files.push_back(inc_file_name);
+
                     // if the file is not found at the location entered then look around for it a bit
-                    if(inc_file_name[0] != '/') inc_file_name = "/" + inc_file_name;
+                    string name = inc_file_name[0] != '/' ? "/" + inc_file_name : inc_file_name;
                     string path(file_name);
                     path = path.substr(0,path.find_last_of('/'));
 
-                    // first check the path of the current config file
-                    if(file_exists(path + inc_file_name)) inc_file_name = path + inc_file_name;
-                    // then check root locations
-                    else if(file_exists("/sd" + inc_file_name)) inc_file_name = "/sd" + inc_file_name;
-                    else if(file_exists("/local" + inc_file_name)) inc_file_name = "/local" + inc_file_name;
+                    // first check the path of the current config file, then root locations
+                    const string candidates[] = { path + name, "/sd" + name, "/local" + name };
+                    for( const string &candidate : candidates ) {
+                        inc_file_name = candidate;
+                        if(file_exists(candidate)) break;
+                        this->parsed_files.push_back(candidate);
+                    }
                 }
                 if(file_exists(inc_file_name)) {
                     // save position in current config file
@@ -97,7 +115,7 @@ void FileConfigSource::transfer_values_to_cache( ConfigCache *cache, const char
 
                     // open and read the included file
                     freopen(inc_file_name.c_str(), "r", lp);
-                    this->transfer_values_to_cache(cache, inc_file_name.c_str());
+                    this->parse_file(cache, inc_file_name.c_str());
 
                     // reopen the current config file and restore position
                     freopen(file_name, "r", lp);
@@ -109,6 +127,201 @@ void FileConfigSource::transfer_values_to_cache( ConfigCache *cache, const char
     fclose(lp);
 }
 
+/*
+    Binary snapshot of the parsed config, written next to the config file.
+    Parsing the config line by line is a large part of the boot time on big configs, so
+    the values are saved after a parse and loaded back in a single read on the next boot.
+
+    The layout is a header, then for each file read ( the config and its includes ) its size,
+    FAT date and time, hash and name, then for each value its three checksums and string.
+    Every place an include was looked for and not found is kept too, as a missing file, so
+    adding the include later is noticed like any other change.
+    A file is taken as unchanged if its size and date are, which only needs the directory.
+    We have no clock, so files we write ourselves all get the same stamp with a zero date, and
+    files off a FAT drive have no date at all. Those are hashed instead, a raw read of the file
+    which is still far cheaper than the parse.
+*/
+
+#define SNAPSHOT_MAGIC   0x50414E53 // "SNAP"
+#define SNAPSHOT_VERSION 2
+#define SNAPSHOT_MAX_SIZE (32*1024)
+#define SNAPSHOT_MISSING  0xFFFFFFFF // size of a file that was not there
+
+struct SnapshotHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t file_count;
+    uint32_t value_count;
+    uint32_t data_size;     // bytes that follow the header
+    uint32_t data_hash;
+};
+
+// FNV-1a
+static uint32_t hash_bytes(const uint8_t *data, size_t len, uint32_t hash = 2166136261UL)
+{
+    for (size_t i = 0; i < len; i++) {
+        hash ^= data[i];
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+static bool hash_file(const char *file_name, uint32_t &size, uint32_t &hash)
+{
+    FILE *fp = fopen(file_name, "r");
+    if(fp == NULL) return false;
+
+    uint8_t buf[512];
+    size = 0;
+    hash = 2166136261UL;
+    size_t n;
+    while((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        hash = hash_bytes(buf, n, hash);
+        size += n;
+    }
+    fclose(fp);
+    return true;
+}
+
+// What the snapshot keeps to notice a change to the file, the hash is only worked out when there is no date to go by
+static bool file_key(DirectoryIndex &index, const string &file_name, uint32_t &size, uint32_t &stamp, uint32_t &hash)
+{
+    size_t slash = file_name.find_last_of('/');
+    string folder = (slash == 0 || slash == string::npos) ? "/" : file_name.substr(0, slash);
+    string name = file_name.substr(slash + 1);
+
+    stamp = 0;
+    hash = 0;
+    if(index.load(folder)) {
+        // a short name without a long one is listed in capitals
+        for (uint16_t i = 0; i < index.count(); i++) {
+            if(strcasecmp(index.name(i), name.c_str()) != 0) continue;
+            size = index.size(i);
+            stamp = (index.date(i) << 16) | index.time(i);
+            break;
+        }
+    }
+
+    if((stamp >> 16) != 0) return true;
+    if(hash_file(file_name.c_str(), size, hash)) return true;
+
+    // not there, which is as much worth knowing as what is in it
+    if(file_exists(file_name)) return false;
+    size = SNAPSHOT_MISSING;
+    return true;
+}
+
+// Load the values from the snapshot if it is still up to date with the files it was made from
+bool FileConfigSource::load_snapshot( ConfigCache *cache )
+{
+    FILE *fp = fopen(snapshot_file().c_str(), "r");
+    if(fp == NULL) return false;
+
+    SnapshotHeader header;
+    if(fread(&header, sizeof(header), 1, fp) != 1 || header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION ||
+       header.data_size > SNAPSHOT_MAX_SIZE) {
+        fclose(fp);
+        return false;
+    }
+
+    uint8_t *data = (uint8_t *)malloc(header.data_size);
+    if(data == NULL) {
+        fclose(fp);
+        return false;
+    }
+
+    bool ok = fread(data, 1, header.data_size, fp) == header.data_size && hash_bytes(data, header.data_size) == header.data_hash;
+    fclose(fp);
+
+    const uint8_t *p = data;
+    const uint8_t *end = data + header.data_size;
+
+    // check none of the files have changed
+    DirectoryIndex index;
+    for (int i = 0; ok && i < header.file_count; i++) {
+        uint32_t size, stamp, hash, current_size, current_stamp, current_hash;
+        if(end - p < 13) { ok = false; break; }
+        memcpy(&size, p, 4);
+        memcpy(&stamp, p + 4, 4);
+        memcpy(&hash, p + 8, 4);
+        uint8_t len = p[12];
+        p += 13;
+        if(end - p < len) { ok = false; break; }
+        string file_name((const char *)p, len);
+        p += len;
+        ok = file_key(index, file_name, current_size, current_stamp, current_hash) &&
+             current_size == size && current_stamp == stamp && current_hash == hash;
+    }
+
+    if(ok) {
+        // first make sure the values are all there, so we never add half a snapshot to the cache
+        const uint8_t *q = p;
+        for (uint32_t i = 0; ok && i < header.value_count; i++) {
+            if(end - q < 7 || end - q < 7 + q[6]) ok = false;
+            else q += 7 + q[6];
+        }
+    }
+
+    if(ok) {
+        for (uint32_t i = 0; i < header.value_count; i++) {
+            // the values are packed, so the checksums may not be aligned
+            uint16_t check_sums[3];
+            memcpy(check_sums, p, sizeof(check_sums));
+            ConfigValue *cv = new ConfigValue(check_sums);
+            cv->found = true;
+            cv->set_value((const char *)p + 7, p[6]);
+            p += 7 + p[6];
+            cache->add(cv);
+        }
+    }
+
+    free(data);
+    return ok;
+}
+
+// Write the values read by the last parse to the snapshot, a failure to write just means we parse next time too
+void FileConfigSource::save_snapshot()
+{
+    string data;
+    SnapshotHeader header;
+    header.magic = SNAPSHOT_MAGIC;
+    header.version = SNAPSHOT_VERSION;
+    header.file_count = 0;
+    header.value_count = 0;
+
+    DirectoryIndex index;
+    for( auto &file_name : this->parsed_files ) {
+        uint32_t size, stamp, hash;
+        if(file_name.size() > 255 || !file_key(index, file_name, size, stamp, hash)) return;
+        data.append((const char *)&size, 4);
+        data.append((const char *)&stamp, 4);
+        data.append((const char *)&hash, 4);
+        data.push_back(file_name.size());
+        data.append(file_name);
+        header.file_count++;
+    }
+
+    for( ConfigValue *cv : this->parsed_values ) {
+        // values are truncated to the line length when read so this should never happen
+        size_t len = strlen(cv->value);
+        if(len > 255) return;
+        data.append((const char *)cv->check_sums, sizeof(cv->check_sums));
+        data.push_back(len);
+        data.append(cv->value, len);
+        header.value_count++;
+    }
+
+    if(data.size() > SNAPSHOT_MAX_SIZE) return;
+    header.data_size = data.size();
+    header.data_hash = hash_bytes((const uint8_t *)data.data(), data.size());
+
+    FILE *fp = fopen(snapshot_file().c_str(), "w");
+    if(fp == NULL) return;
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 && fwrite(data.data(), 1, data.size(), fp) == data.size();
+    fclose(fp);
+    if(!ok) remove(snapshot_file().c_str());
+}
+
 // Return true if the check_sums match
 bool FileConfigSource::is_named( uint16_t check_sum )
 {
@@ -11,9 +11,11 @@
 #include "ConfigSource.h"
 
 class ConfigCache;
+class ConfigValue;
 
 using namespace std;
 #include <string>
+#include <vector>
 #include <stdio.h>
 
 class FileConfigSource : public ConfigSource
@@ -21,7 +23,6 @@ class FileConfigSource : public ConfigSource
 public:
     FileConfigSource(string config_file, const char *name);
     void transfer_values_to_cache( ConfigCache *cache );
-    void transfer_values_to_cache( ConfigCache *cache, const char * file_name );
     bool is_named( uint16_t check_sum );
     bool write( string setting, string value );
     string read( uint16_t check_sums[3] );
@@ -31,6 +32,13 @@ public:
 
 private:
     bool readLine(string& line, int lineno, FILE *fp);
+    void parse_file( ConfigCache *cache, const char *file_name );
+    string snapshot_file() const { return config_file + ".snap"; }
+    bool load_snapshot( ConfigCache *cache );
+    void save_snapshot();
+
+    vector<string> parsed_files;        // Config file and its includes, as read by the last parse
+    vector<ConfigValue*> parsed_values; // Values in the order the last parse read them
     string config_file;         // Path to the config file
     bool   config_file_found;   // Wether or not the config file's location is known
 };
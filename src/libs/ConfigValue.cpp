@@ -3,6 +3,7 @@
 
 #include "libs/Kernel.h"
 #include "libs/utils.h"
+#include "ConfigArena.h"
 #include "libs/Pin.h"
 #include "Pwm.h"
 
@@ -11,6 +12,8 @@
 
 #include <vector>
 #include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
 
 ConfigValue::ConfigValue()
 {
@@ -24,24 +27,20 @@ void ConfigValue:: clear()
     this->check_sums[0] = 0x0000;
     this->check_sums[1] = 0x0000;
     this->check_sums[2] = 0x0000;
-    this->default_double= 0.0F;
-    this->default_int= 0;
+    this->number= 0.0F;
+    this->integer= 0;
+    this->type= 0;
     this->value= "";
 }
 
 ConfigValue::ConfigValue(uint16_t *cs) {
+    clear();
     memcpy(this->check_sums, cs, sizeof(this->check_sums));
-    this->found = false;
-    this->default_set = false;
-    this->value= "";
 }
 
 ConfigValue::ConfigValue(const ConfigValue& to_copy)
 {
-    this->found = to_copy.found;
-    this->default_set = to_copy.default_set;
-    memcpy(this->check_sums, to_copy.check_sums, sizeof(this->check_sums));
-    this->value.assign(to_copy.value);
+    *this = to_copy;
 }
 
 ConfigValue& ConfigValue::operator= (const ConfigValue& to_copy)
@@ -50,11 +49,42 @@ ConfigValue& ConfigValue::operator= (const ConfigValue& to_copy)
         this->found = to_copy.found;
         this->default_set = to_copy.default_set;
         memcpy(this->check_sums, to_copy.check_sums, sizeof(this->check_sums));
-        this->value.assign(to_copy.value);
+        this->value = to_copy.value;
+        this->number = to_copy.number;
+        this->integer = to_copy.integer;
+        this->type = to_copy.type;
     }
     return *this;
 }
 
+// Keep the string in the arena and parse it once, rather than every time it is read
+void ConfigValue::set_value(const char *str, size_t len)
+{
+    this->value = config_arena.intern(str, len);
+    this->type = 0;
+
+    if( strpbrk(this->value, "ty1") != NULL ) this->type |= IS_TRUE;
+
+    char buf[32];
+    size_t n = 0;
+    for (const char *p = this->value; *p != '\0' && n < sizeof(buf) - 1; p++) {
+        if( strchr("0123456789-.abcdefpxABCDEFPX", *p) != NULL ) buf[n++] = *p;
+    }
+    buf[n] = '\0';
+
+    char *endptr = NULL;
+    float f = strtof(buf, &endptr);
+    if( endptr > buf ) {
+        this->number = f;
+        this->type |= IS_NUMBER;
+    }
+    long l = strtol(buf, &endptr, 10);
+    if( endptr > buf ) {
+        this->integer = l;
+        this->type |= IS_INT;
+    }
+}
+
 ConfigValue *ConfigValue::required()
 {
     if( !this->found ) {
@@ -66,32 +96,26 @@ ConfigValue *ConfigValue::required()
 float ConfigValue::as_number()
 {
     if( this->found == false && this->default_set == true ) {
-        return this->default_double;
+        return this->number;
     } else {
-        char *endptr = NULL;
-        string str = remove_non_number(this->value);
-        const char *cp= str.c_str();
-        float result = strtof(cp, &endptr);
-        if( endptr <= cp ) {
-            printErrorandExit("config setting with value '%s' and checksums[%04X,%04X,%04X] is not a valid number, please see http://smoothieware.org/configuring-smoothie\r\n", this->value.c_str(), this->check_sums[0], this->check_sums[1], this->check_sums[2] );
+        if( !(this->type & IS_NUMBER) ) {
+            printErrorandExit("config setting with value '%s' and checksums[%04X,%04X,%04X] is not a valid number, please see http://smoothieware.org/configuring-smoothie\r\n", this->value, this->check_sums[0], this->check_sums[1], this->check_sums[2] );
+            return 0.0F;
         }
-        return result;
+        return this->number;
     }
 }
 
 int ConfigValue::as_int()
 {
     if( this->found == false && this->default_set == true ) {
-        return this->default_int;
+        return this->integer;
     } else {
-        char *endptr = NULL;
-        string str = remove_non_number(this->value);
-        const char *cp= str.c_str();
-        int result = strtol(cp, &endptr, 10);
-        if( endptr <= cp ) {
-            printErrorandExit("config setting with value '%s' and checksums[%04X,%04X,%04X] is not a valid int, please see http://smoothieware.org/configuring-smoothie\r\n", this->value.c_str(), this->check_sums[0], this->check_sums[1], this->check_sums[2] );
+        if( !(this->type & IS_INT) ) {
+            printErrorandExit("config setting with value '%s' and checksums[%04X,%04X,%04X] is not a valid int, please see http://smoothieware.org/configuring-smoothie\r\n", this->value, this->check_sums[0], this->check_sums[1], this->check_sums[2] );
+            return 0;
         }
-        return result;
+        return this->integer;
     }
 }
 
@@ -103,24 +127,31 @@ std::string ConfigValue::as_string()
 bool ConfigValue::as_bool()
 {
     if( this->found == false && this->default_set == true ) {
-        return this->default_int;
+        return this->integer;
     } else {
-        return this->value.find_first_of("ty1") != string::npos;
+        return this->type & IS_TRUE;
     }
 }
 
+// the defaults share the parsed fields, so they are only set when the value was not found
 ConfigValue *ConfigValue::by_default(int val)
 {
+    if( this->found ) {
+        return this;
+    }
     this->default_set = true;
-    this->default_int = val;
-    this->default_double = val; // we need to set both becuase sometimes an integer is passed when it should be a float
+    this->integer = val;
+    this->number = val; // we need to set both becuase sometimes an integer is passed when it should be a float
     return this;
 }
 
 ConfigValue *ConfigValue::by_default(float val)
 {
+    if( this->found ) {
+        return this;
+    }
     this->default_set = true;
-    this->default_double = val;
+    this->number = val;
     return this;
 }
 
@@ -130,13 +161,13 @@ ConfigValue *ConfigValue::by_default(string val)
         return this;
     }
     this->default_set = true;
-    this->value = val;
+    this->value = config_arena.intern(val.data(), val.size());
     return this;
 }
 
 bool ConfigValue::has_characters( const char *mask )
 {
-    if( this->value.find_first_of(mask) != string::npos ) {
+    if( strpbrk(this->value, mask) != NULL ) {
         return true;
     } else {
         return false;
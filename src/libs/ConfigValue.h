@@ -37,13 +37,24 @@ class ConfigValue{
         friend class FileConfigSource;
 
     private:
+        // what the value parsed as, set once when the value is assigned
+        enum TYPE_FLAGS {
+            IS_NUMBER = 1, // number is valid
+            IS_INT    = 2, // integer is valid
+            IS_TRUE   = 4, // as_bool() is true
+        };
+
+        void set_value(const char *str, size_t len);
+        void set_value(const string &str) { set_value(str.data(), str.size()); }
         bool has_characters( const char* mask );
-        string value;
-        int default_int;
-        float default_double;
+
+        const char *value;      // in the config arena, so only valid while the config cache is loaded
+        float number;           // the parsed value when found, otherwise the default
+        int integer;
         uint16_t check_sums[3];
-        bool found;
-        bool default_set;
+        uint8_t type;
+        bool found:1;
+        bool default_set:1;
 };
 
 
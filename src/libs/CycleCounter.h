@@ -0,0 +1,24 @@
+#ifndef CYCLECOUNTER_H
+#define CYCLECOUNTER_H
+
+#include <stdint.h>
+
+// The Cortex-M3 DWT cycle counter, used to time things like module event handlers
+// The core_cm3.h we build against does not define the DWT registers, so they are addressed directly here
+
+#define CYCLECOUNTER_DEMCR  (*(volatile uint32_t *)0xE000EDFC) // CoreDebug DEMCR
+#define CYCLECOUNTER_CTRL   (*(volatile uint32_t *)0xE0001000) // DWT CTRL
+#define CYCLECOUNTER_CYCCNT (*(volatile uint32_t *)0xE0001004) // DWT CYCCNT
+
+inline void start_cycle_counter()
+{
+    CYCLECOUNTER_DEMCR |= (1UL << 24); // TRCENA
+    CYCLECOUNTER_CTRL  |= 1UL;         // CYCCNTENA
+}
+
+inline uint32_t get_cycle_count()
+{
+    return CYCLECOUNTER_CYCCNT;
+}
+
+#endif
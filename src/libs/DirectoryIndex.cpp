@@ -0,0 +1,122 @@
+#include "DirectoryIndex.h"
+
+#include "FileBase.h"
+#include "DirHandle.h"
+#include "FATFileSystem.h"
+#include "ff.h"
+
+#include <stdio.h>
+#include <string.h>
+
+volatile uint32_t DirectoryIndex::changes = 0;
+
+DirectoryIndex::DirectoryIndex()
+{
+    this->loaded_at = 0;
+    this->valid = false;
+}
+
+bool DirectoryIndex::load(const std::string& folder)
+{
+    if(this->valid && this->loaded_at == changes && folder == this->folder) return true;
+
+    clear();
+    uint32_t started = changes;
+    if(!read_fat(folder) && !read_dir(folder)) {
+        clear();
+        return false;
+    }
+
+    this->folder = folder;
+    this->loaded_at = started;
+    this->valid = true;
+    return true;
+}
+
+void DirectoryIndex::clear()
+{
+    this->valid = false;
+    this->folder.clear();
+    // swap rather than clear, so the memory is really given back
+    std::vector<entry_t>().swap(this->entries);
+    std::string().swap(this->names);
+}
+
+int DirectoryIndex::find(const char *name) const
+{
+    for (uint16_t i = 0; i < count(); i++) {
+        if(strcmp(this->name(i), name) == 0) return i;
+    }
+    return -1;
+}
+
+void DirectoryIndex::add(const char *name, uint32_t size, uint16_t date, uint16_t time, bool folder)
+{
+    // the offsets are 16 bits
+    if(this->names.size() + strlen(name) + 1 > 0xFFFF) return;
+
+    entry_t e;
+    e.size = size;
+    e.date = date;
+    e.time = time;
+    e.name = this->names.size();
+    e.folder = folder;
+    this->entries.push_back(e);
+    this->names.append(name, strlen(name) + 1);
+}
+
+// Reads the folder straight through FatFs, which also gives the sizes and dates, if it is on a FAT filesystem
+bool DirectoryIndex::read_fat(const std::string& folder)
+{
+    // split "/sd/some/folder" into the mount and the path on it
+    if(folder.size() < 2 || folder[0] != '/') return false;
+    size_t slash = folder.find('/', 1);
+    std::string mount = folder.substr(1, slash == std::string::npos ? std::string::npos : slash - 1);
+    std::string path = slash == std::string::npos ? "" : folder.substr(slash + 1);
+
+    mbed::FileBase *fs = mbed::FileBase::lookup(mount.c_str(), mount.size());
+    if(fs == NULL) return false;
+
+    int drive = -1;
+    for (int i = 0; i < _DRIVES; i++) {
+        if(mbed::FATFileSystem::_ffs[i] == fs) drive = i;
+    }
+    if(drive < 0) return false;
+
+    char n[64];
+    snprintf(n, sizeof(n), "%d:/%s", drive, path.c_str());
+
+    DIR_t dir;
+    if(f_opendir(&dir, n) != FR_OK) return false;
+
+    FILINFO finfo;
+#if _USE_LFN
+    static char lfn[_MAX_LFN + 1];
+    finfo.lfname = lfn;
+    finfo.lfsize = sizeof(lfn);
+#endif
+    while(f_readdir(&dir, &finfo) == FR_OK && finfo.fname[0] != 0) {
+#if _USE_LFN
+        const char *fn = *finfo.lfname ? finfo.lfname : finfo.fname;
+#else
+        const char *fn = finfo.fname;
+#endif
+        add(fn, finfo.fsize, finfo.fdate, finfo.ftime, (finfo.fattrib & AM_DIR) != 0);
+    }
+    return true;
+}
+
+// Anything else only gives names, though everything in / is a mounted filesystem
+bool DirectoryIndex::read_dir(const std::string& folder)
+{
+    DIR *d = opendir(folder.c_str());
+    if(d == NULL) return false;
+
+    bool root = folder == "/";
+    struct dirent *p;
+    while((p = readdir(d)) != NULL) {
+        add(p->d_name, 0, 0, 0, root);
+    }
+    closedir(d);
+    return true;
+}
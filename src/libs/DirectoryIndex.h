@@ -0,0 +1,63 @@
+#ifndef _DIRECTORYINDEX_H_
+#define _DIRECTORYINDEX_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/*
+ * Keeps the listing of one folder, so ls, M20 and the panel file screen do not walk the directory through
+ * FatFs again for every line they show
+ *
+ * The listing is read in one pass the first time a folder is asked for and kept until another folder is
+ * asked for or something changes the files. Anything that changes a file through the FAT filesystem, and
+ * the host writing over USB, calls invalidate(), which only bumps a counter so it is safe from interrupts.
+ *
+ * Folders on a FAT filesystem also get the size and date of each entry, elsewhere only the names are known.
+ */
+
+class DirectoryIndex {
+    public:
+        DirectoryIndex();
+
+        // make folder the indexed one, reading it again if needed. false if it can not be opened
+        bool load(const std::string& folder);
+        // forget the listing, eg to give the memory back
+        void clear();
+
+        uint16_t count() const { return entries.size(); }
+        const char* name(uint16_t i) const { return names.c_str() + entries[i].name; }
+        uint32_t size(uint16_t i) const { return entries[i].size; }
+        bool is_folder(uint16_t i) const { return entries[i].folder; }
+        // FAT date and time, 0 if not known
+        uint16_t date(uint16_t i) const { return entries[i].date; }
+        uint16_t time(uint16_t i) const { return entries[i].time; }
+
+        // index of the entry called name, or -1
+        int find(const char *name) const;
+
+        static void invalidate() { changes++; }
+
+    private:
+        bool read_fat(const std::string& folder);
+        bool read_dir(const std::string& folder);
+        void add(const char *name, uint32_t size, uint16_t date, uint16_t time, bool folder);
+
+        struct entry_t {
+            uint32_t size;
+            uint16_t date;
+            uint16_t time;
+            uint16_t name;          // offset of the name in names
+            bool folder;
+        };
+
+        std::string folder;
+        std::vector<entry_t> entries;
+        std::string names;          // all the names, each ended by a nul
+        uint32_t loaded_at;         // changes when the listing was read
+        bool valid;
+
+        static volatile uint32_t changes;
+};
+
+#endif
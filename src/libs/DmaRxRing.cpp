@@ -0,0 +1,68 @@
+#include "DmaRxRing.h"
+
+DmaRxRing::DmaRxRing(const uint8_t *buffer, uint32_t length)
+{
+    this->buffer = buffer;
+    this->mask = length - 1;
+    this->write = this->read = this->scan = this->lines = 0;
+    this->overruns = this->dropped = 0;
+}
+
+void DmaRxRing::update(uint32_t laps, uint32_t offset)
+{
+    uint32_t length = mask + 1;
+    uint32_t pos = (laps * length) + offset;
+
+    // the channel wraps before its terminal count interrupt has counted the lap, so it seems to go backwards
+    if ((int32_t)(pos - write) < 0)
+        pos += length;
+    write = pos;
+
+    if (write - read > length) {
+        // lapped, the oldest data has been overwritten, so drop it all including any partial line
+        overruns++;
+        dropped += write - read;
+        read = scan = write;
+        lines = 0;
+        return;
+    }
+
+    for (; scan != write; scan++) {
+        uint8_t c = buffer[scan & mask];
+        if (c == '\n' || c == '\r')
+            lines++;
+    }
+
+    if (lines == 0 && write - read >= mask) {
+        // a line longer than the buffer can never complete, so drop it
+        dropped += write - read;
+        read = write;
+    }
+}
+
+bool DmaRxRing::read_line(std::string& line)
+{
+    if (lines == 0)
+        return false;
+
+    line.clear();
+    while (read != scan) {
+        uint8_t c = buffer[read++ & mask];
+        if (c == '\n' || c == '\r') {
+            lines--;
+            return true;
+        }
+        line += c;
+    }
+
+    // can't get here, lines counts terminators between read and scan
+    lines = 0;
+    return false;
+}
+
+void DmaRxRing::flush()
+{
+    dropped += write - read;
+    read = scan = write;
+    lines = 0;
+}
@@ -0,0 +1,51 @@
+#ifndef DMARXRING_H
+#define DMARXRING_H
+
+#include <stdint.h>
+#include <string>
+
+/*
+ * The consumer side of a receive buffer that a DMA channel fills round and round
+ *
+ * The DMA cannot be held off, so instead of a shared head index the consumer is told how many laps the
+ * channel has done ( from its terminal count interrupt ) and where it is writing now, and works out from
+ * that how much arrived and whether it was overrun.
+ *
+ * Each byte is scanned for a newline once, so checking for a complete line costs nothing while the host is
+ * quiet. CR counts as a newline, as it does for the interrupt driven console.
+ *
+ * No hardware is touched here, so this can be exercised on the host, see tests/dmarxring_test.cpp.
+ */
+
+class DmaRxRing {
+    public:
+        // length must be a power of two
+        DmaRxRing(const uint8_t *buffer, uint32_t length);
+
+        // laps the channel has finished and the offset it is writing to, read in that order
+        void update(uint32_t laps, uint32_t offset);
+
+        bool has_line(void) const { return lines > 0; };
+        uint32_t available(void) const { return write - read; };
+
+        // the next line without its terminator, returns false if there is no complete line yet
+        bool read_line(std::string& line);
+
+        // throw away everything received so far
+        void flush(void);
+
+        uint32_t overruns;          // times the DMA lapped us and data was lost
+        uint32_t dropped;           // bytes thrown away, either overrun or too long to be a line
+
+    private:
+        const uint8_t *buffer;
+        uint32_t mask;
+
+        // free running positions in the byte stream
+        uint32_t write;             // everything before this has arrived
+        uint32_t read;              // everything before this has been consumed
+        uint32_t scan;              // everything before this has been checked for newlines
+        uint32_t lines;             // newlines between read and scan
+};
+
+#endif
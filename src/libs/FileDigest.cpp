@@ -0,0 +1,114 @@
+#include "FileDigest.h"
+
+#include "crc32.h"
+
+#include <stdio.h>
+#include <string.h>
+
+FileDigest::record_t FileDigest::records[FileDigest::remembered];
+int FileDigest::newest = 0;
+
+FileDigest::FileDigest()
+{
+    start();
+}
+
+void FileDigest::start()
+{
+    md5 = MD5();
+    crc = 0;
+    size = 0;
+    md5_hex[0] = '\0';
+}
+
+void FileDigest::update(const void *data, size_t len)
+{
+    crc = crc32_update(crc, data, len);
+    md5.update((const unsigned char *)data, len);
+    size += len;
+}
+
+void FileDigest::finish(const std::string& filename)
+{
+    uint8_t digest[16];
+    md5.finalize();
+    md5.bindigest(digest, sizeof(digest));
+    for (int i = 0; i < 16; i++)
+        sprintf(md5_hex + (i * 2), "%02x", digest[i]);
+
+    if (filename.empty()) return;
+
+    // a file digested again takes the place of its old digest rather than pushing out another file's
+    int slot = -1;
+    for (int i = 0; i < remembered; i++) {
+        if (records[i].filename == filename) slot = i;
+    }
+    if (slot < 0) slot = (newest + 1) % remembered;
+    else if (slot != newest) {
+        // move it to the newest end, keeping the rest in order
+        record_t r = records[slot];
+        while (slot != newest) {
+            int next = (slot + 1) % remembered;
+            records[slot] = records[next];
+            slot = next;
+        }
+        records[slot] = r;
+    }
+
+    newest = slot;
+    records[slot].filename = filename;
+    records[slot].size = size;
+    records[slot].crc = crc;
+    memcpy(records[slot].md5_hex, md5_hex, sizeof(md5_hex));
+}
+
+bool FileDigest::lookup(const std::string& filename, uint32_t& size, uint32_t& crc, std::string& md5_hex)
+{
+    for (int i = 0; i < remembered; i++) {
+        const record_t& r = records[i];
+        if (r.filename != filename) continue;
+
+        // anything written to the file since, say over MSD, is unlikely to leave it the same size
+        FILE *fp = fopen(filename.c_str(), "r");
+        if (fp == NULL) return false;
+        bool same = fseek(fp, 0, SEEK_END) == 0 && (uint32_t)ftell(fp) == r.size;
+        fclose(fp);
+        if (!same) return false;
+
+        size = r.size;
+        crc = r.crc;
+        md5_hex = r.md5_hex;
+        return true;
+    }
+    return false;
+}
+
+extern "C" void *new_file_digest(void)
+{
+    return new FileDigest();
+}
+
+extern "C" void file_digest_update(void *digest, const void *data, unsigned int len)
+{
+    ((FileDigest *)digest)->update(data, len);
+}
+
+extern "C" void file_digest_finish(void *digest, const char *filename)
+{
+    ((FileDigest *)digest)->finish(filename != NULL ? filename : "");
+}
+
+extern "C" const char *file_digest_md5(void *digest)
+{
+    return ((FileDigest *)digest)->get_md5();
+}
+
+extern "C" uint32_t file_digest_crc(void *digest)
+{
+    return ((FileDigest *)digest)->get_crc();
+}
+
+extern "C" void delete_file_digest(void *digest)
+{
+    delete (FileDigest *)digest;
+}
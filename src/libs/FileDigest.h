@@ -0,0 +1,78 @@
+#ifndef _FILEDIGEST_H_
+#define _FILEDIGEST_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+
+#include "md5.h"
+
+#include <string>
+
+/*
+ * CRC-32 and MD5 of a file, worked out a piece at a time as the bytes go past on their way to or from the card,
+ * so an upload or a played job can be checked against the host's copy without reading the file back
+ *
+ * The last few digests of whole files are remembered by name, for the digest command.
+ */
+
+class FileDigest {
+    public:
+        FileDigest();
+
+        void start();
+        void update(const void *data, size_t len);
+
+        // ends the digest, and if filename is not empty remembers it as that of the whole file
+        void finish(const std::string& filename);
+
+        uint32_t get_size() const { return size; };
+        uint32_t get_crc() const { return crc; };
+        const char *get_md5() const { return md5_hex; };   // empty until finished
+
+        // the remembered digest of filename, false if there is none or the file has changed size since
+        static bool lookup(const std::string& filename, uint32_t& size, uint32_t& crc, std::string& md5_hex);
+
+        // calls fn with each remembered digest, most recent first
+        template<typename F> static void each(F fn);
+
+    private:
+        struct record_t {
+            std::string filename;
+            uint32_t size;
+            uint32_t crc;
+            char md5_hex[33];
+        };
+
+        static const int remembered = 4;
+        static record_t records[remembered];
+        static int newest;
+
+        MD5 md5;
+        uint32_t crc;
+        uint32_t size;
+        char md5_hex[33];
+};
+
+template<typename F> void FileDigest::each(F fn)
+{
+    for (int i = 0; i < remembered; i++) {
+        const record_t& r = records[(newest + remembered - i) % remembered];
+        if (!r.filename.empty()) fn(r.filename, r.size, r.crc, r.md5_hex);
+    }
+}
+
+#else
+
+// for the C side of the network stack
+extern void *new_file_digest(void);
+extern void file_digest_update(void *digest, const void *data, unsigned int len);
+extern void file_digest_finish(void *digest, const char *filename);
+extern const char *file_digest_md5(void *digest);
+extern uint32_t file_digest_crc(void *digest);
+extern void delete_file_digest(void *digest);
+
+#endif // __cplusplus
+
+#endif
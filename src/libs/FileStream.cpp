@@ -0,0 +1,115 @@
+#include "FileStream.h"
+
+#include <string.h>
+
+const char FileStream::end_marker[]= "; end of saved file\n";
+
+FileStream::FileStream(const char *filename, bool commit)
+{
+    this->filename= filename;
+    this->commit= commit;
+    this->buffered= 0;
+    this->failed= false;
+    this->buffer= NULL;
+
+    this->fd= fopen(commit ? temp_filename(this->filename).c_str() : filename, "w");
+    if(this->fd == NULL) return;
+
+    this->buffer= new char[buffer_size];
+    if(this->buffer == NULL) {
+        fclose(this->fd);
+        this->fd= NULL;
+        return;
+    }
+
+    // we do our own buffering
+    setvbuf(this->fd, NULL, _IONBF, 0);
+}
+
+int FileStream::puts(const char *str)
+{
+    if(this->fd == NULL) return 0;
+
+    size_t len= strlen(str);
+    size_t left= len;
+    while(left > 0) {
+        size_t n= buffer_size - this->buffered;
+        if(n > left) n= left;
+        memcpy(this->buffer + this->buffered, str, n);
+        this->buffered += n;
+        str += n;
+        left -= n;
+
+        if(this->buffered == buffer_size && !flush()) return 0;
+    }
+    return len;
+}
+
+bool FileStream::flush()
+{
+    if(this->buffered == 0 || this->failed) return !this->failed;
+
+    if(fwrite(this->buffer, 1, this->buffered, this->fd) != this->buffered) this->failed= true;
+    this->buffered= 0;
+    return !this->failed;
+}
+
+// writes out what is left and, for a committed file, replaces the old one. false if anything failed
+bool FileStream::close()
+{
+    if(this->fd == NULL) return false;
+
+    if(this->commit) puts(end_marker);
+    flush();
+    if(fclose(this->fd) != 0) this->failed= true;
+    this->fd= NULL;
+
+    delete [] this->buffer;
+    this->buffer= NULL;
+
+    if(this->commit) {
+        std::string tmp= temp_filename(this->filename);
+        if(this->failed) {
+            // leave the old file alone
+            remove(tmp.c_str());
+        }else{
+            // FAT can not rename over a file, so there is a moment with only the temporary one, see recover()
+            remove(this->filename.c_str());
+            if(rename(tmp.c_str(), this->filename.c_str()) != 0) this->failed= true;
+        }
+    }
+
+    return !this->failed;
+}
+
+// true if the file ends with end_marker
+bool FileStream::is_complete(FILE *fp)
+{
+    const size_t len= sizeof(end_marker) - 1;
+    char tail[sizeof(end_marker)];
+    if(fseek(fp, -(long)len, SEEK_END) != 0) return false;
+    if(fread(tail, 1, len, fp) != len) return false;
+    return memcmp(tail, end_marker, len) == 0;
+}
+
+void FileStream::recover(const std::string& filename)
+{
+    std::string tmp= temp_filename(filename);
+    FILE *fp= fopen(tmp.c_str(), "r");
+    if(fp == NULL) return;
+    bool complete= is_complete(fp);
+    fclose(fp);
+
+    fp= fopen(filename.c_str(), "r");
+    if(fp != NULL) {
+        // the old file is still there, so the temporary one may not be complete
+        fclose(fp);
+        remove(tmp.c_str());
+    }else if(complete) {
+        // the old file was already removed and the temporary one was written to the end
+        rename(tmp.c_str(), filename.c_str());
+    }else{
+        // there was no old file and the save was cut off, so there is nothing to keep
+        remove(tmp.c_str());
+    }
+}
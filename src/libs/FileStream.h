@@ -2,18 +2,46 @@
 #define _FILESTREAM_H_
 
 #include "StreamOutput.h"
-#include "stdlib.h"
+
+#include <stdio.h>
+#include <string>
+
+/*
+ * A stream that writes a file, eg the settings M500 prints
+ *
+ * Output is gathered into a buffer and written a sector at a time instead of once per printf. If commit is
+ * set the file is written under a temporary name and only moved over the real one once it has all been
+ * written, so a failed or interrupted save leaves the previous file in place. A committed file ends with
+ * end_marker, a comment line, so recover() can tell a complete temporary file from a cut off one.
+ */
 
 class FileStream : public StreamOutput {
     public:
-        FileStream(const char *filename) { fd= fopen(filename, "w"); }
+        FileStream(const char *filename, bool commit= false);
         virtual ~FileStream(){ close(); }
-        int puts(const char *str){ return (fd == NULL) ? 0 : fwrite(str, 1, strlen(str), fd); }
-        void close() { if(fd != NULL) fclose(fd); fd= NULL; }
+        int puts(const char *str);
+        bool close();
         bool is_open() { return fd != NULL; }
 
+        // the name a committed file is written under until it is complete
+        static std::string temp_filename(const std::string& filename) { return filename + ".tmp"; }
+        // the last line of a committed file
+        static const char end_marker[];
+        // finishes or discards a commit that was interrupted, call before reading a committed file
+        static void recover(const std::string& filename);
+
     private:
+        bool flush();
+        static bool is_complete(FILE *fp);
+
+        static const size_t buffer_size = 512;
+
+        std::string filename;
         FILE *fd;
+        char *buffer;
+        size_t buffered;
+        bool commit;
+        bool failed;
 };
 
 #endif
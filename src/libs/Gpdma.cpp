@@ -0,0 +1,74 @@
+#include "Gpdma.h"
+
+#include <stddef.h>
+
+gpdma_callback_t Gpdma::callbacks[8];
+void *Gpdma::users[8];
+uint8_t Gpdma::claimed = 0;
+
+void Gpdma::power_on()
+{
+    LPC_SC->PCONP |= (1 << 29);          // power up the GPDMA
+    LPC_GPDMA->DMACIntTCClear = 0xFF;
+    LPC_GPDMA->DMACIntErrClr = 0xFF;
+    LPC_GPDMA->DMACConfig = 1;           // enable, little endian on both masters
+    while (!(LPC_GPDMA->DMACConfig & 1));
+    NVIC_EnableIRQ(DMA_IRQn);
+}
+
+int Gpdma::claim(gpdma_callback_t callback, void *user)
+{
+    if (claimed == 0)
+        power_on();
+
+    for (int i = 0; i < 8; i++) {
+        if (claimed & (1 << i)) continue;
+
+        callbacks[i] = callback;
+        users[i] = user;
+        claimed |= (1 << i);
+        return i;
+    }
+    return -1;
+}
+
+void Gpdma::release(int channel)
+{
+    stop(channel);
+    __disable_irq();
+    claimed &= ~(1 << channel);
+    callbacks[channel] = NULL;
+    __enable_irq();
+}
+
+LPC_GPDMACH_TypeDef *Gpdma::channel(int channel)
+{
+    return (LPC_GPDMACH_TypeDef *) (LPC_GPDMACH0_BASE + (channel * 0x20));
+}
+
+void Gpdma::stop(int channel)
+{
+    LPC_GPDMACH_TypeDef *ch = Gpdma::channel(channel);
+    ch->DMACCConfig &= ~1;
+    LPC_GPDMA->DMACIntTCClear = (1 << channel);
+    LPC_GPDMA->DMACIntErrClr = (1 << channel);
+}
+
+void Gpdma::irq()
+{
+    uint32_t tc = LPC_GPDMA->DMACIntTCStat;
+    uint32_t err = LPC_GPDMA->DMACIntErrStat;
+    LPC_GPDMA->DMACIntTCClear = tc;
+    LPC_GPDMA->DMACIntErrClr = err;
+
+    uint32_t pending = tc | err;
+    for (int i = 0; pending != 0; i++, pending >>= 1) {
+        if ((pending & 1) && callbacks[i] != NULL)
+            callbacks[i](users[i], (err & (1 << i)) != 0);
+    }
+}
+
+extern "C" void DMA_IRQHandler(void)
+{
+    Gpdma::irq();
+}
@@ -0,0 +1,45 @@
+#ifndef GPDMA_H
+#define GPDMA_H
+
+#include <stdint.h>
+
+#include "sLPC17xx.h"
+
+// The callback runs in the DMA interrupt, error is set if the channel stopped on a bus error
+typedef void (*gpdma_callback_t)(void *user, bool error);
+
+// A linked list item as the GPDMA reads it, must be word aligned and somewhere the GPDMA can reach ( eg AHB SRAM )
+struct GpdmaLli {
+    uint32_t src;
+    uint32_t dst;
+    uint32_t next;
+    uint32_t control;
+};
+
+// Hands out the eight GPDMA channels and dispatches their interrupts to whoever claimed them
+class Gpdma {
+    public:
+        // returns the claimed channel, or -1 if they are all taken
+        // lower channels win arbitration, so latency sensitive users should claim first
+        static int  claim(gpdma_callback_t callback, void *user);
+        static void release(int channel);
+
+        static LPC_GPDMACH_TypeDef *channel(int channel);
+
+        // stop a channel straight away, dropping anything still in its FIFO
+        static void stop(int channel);
+
+        // the GPDMA only sees the AHB SRAM banks, not the local SRAM the heap and stack live in
+        static bool reachable(const void *p) { return ((uint32_t)p >= 0x2007C000) && ((uint32_t)p < 0x20084000); }
+
+        static void irq(void);
+
+    private:
+        static void power_on(void);
+
+        static gpdma_callback_t callbacks[8];
+        static void *users[8];
+        static uint8_t claimed;
+};
+
+#endif
@@ -0,0 +1,141 @@
+#include "HeapReport.h"
+
+#include "StreamOutput.h"
+
+#include <string.h>
+
+FragmentationMap::FragmentationMap(uint32_t start, uint32_t size)
+{
+    this->start = start;
+    this->size = size;
+    memset(cells, ' ', sizeof(cells));
+}
+
+void FragmentationMap::add(uint32_t address, uint32_t length, bool used)
+{
+    if (size == 0 || length == 0 || address < start || address >= start + size)
+        return;
+
+    uint32_t first = (uint64_t) (address - start) * FRAGMENTATION_MAP_CELLS / size;
+    uint32_t last  = (uint64_t) (address - start + length - 1) * FRAGMENTATION_MAP_CELLS / size;
+    if (last >= FRAGMENTATION_MAP_CELLS)
+        last = FRAGMENTATION_MAP_CELLS - 1;
+
+    char c = used ? '#' : '.';
+    for (uint32_t i = first; i <= last; i++)
+        cells[i] = (cells[i] == ' ' || cells[i] == c) ? c : '+';
+}
+
+void FragmentationMap::print(StreamOutput* str)
+{
+    str->printf("  %08lX, %lu bytes per character\n", start, size / FRAGMENTATION_MAP_CELLS);
+    for (int i = 0; i < FRAGMENTATION_MAP_CELLS; i += 64)
+        str->printf("  |%.*s|\n", 64, cells + i);
+}
+
+#ifdef HEAP_TAGS
+
+struct HeapTagOwner
+{
+    const void* owner;      // NULL for the core
+    uint32_t    live;       // bytes, including malloc overhead
+    uint32_t    peak;
+    uint32_t    allocations;
+    uint32_t    frees;
+};
+
+#define HEAP_TAG_MAGIC 0x7A6B0000
+
+static HeapTagOwner owners[HEAP_TAG_OWNERS];    // owner 0 is the core and the catch all when the table is full
+static uint8_t owner_count = 1;
+static uint8_t current = 0;
+
+HeapTagScope::HeapTagScope(const void* owner)
+{
+    previous = current;
+
+    uint8_t i;
+    for (i = 1; i < owner_count; i++)
+        if (owners[i].owner == owner)
+            break;
+    if (i == owner_count)
+    {
+        if (owner_count == HEAP_TAG_OWNERS)
+            i = 0;
+        else
+            owners[owner_count++].owner = owner;
+    }
+    current = i;
+}
+
+HeapTagScope::~HeapTagScope()
+{
+    current = previous;
+}
+
+// the size of the newlib-nano chunk holding p, including its header
+static int32_t* chunk_header(void* p)
+{
+    int32_t* c = (int32_t*) ((uint8_t*) p - 4);
+    // a negative size is the offset back to the real header, when the pointer was padded for alignment
+    if (*c < 0)
+        c = (int32_t*) ((uint8_t*) c + *c);
+    return c;
+}
+
+static uint32_t* chunk_footer(int32_t* c)
+{
+    return (uint32_t*) ((uint8_t*) c + *c - HEAP_TAG_FOOTER);
+}
+
+extern "C" void heap_tag_alloc(void* p)
+{
+    int32_t* c = chunk_header(p);
+    uint32_t* footer = chunk_footer(c);
+    footer[0] = current;
+    footer[1] = ((uint32_t) p) ^ HEAP_TAG_MAGIC;
+
+    HeapTagOwner& o = owners[current];
+    o.live += *c;
+    o.allocations++;
+    if (o.live > o.peak)
+        o.peak = o.live;
+}
+
+extern "C" void heap_tag_free(void* p)
+{
+    int32_t* c = chunk_header(p);
+    uint32_t* footer = chunk_footer(c);
+
+    // not allocated through the wrapper
+    if (footer[1] != (((uint32_t) p) ^ HEAP_TAG_MAGIC) || footer[0] >= HEAP_TAG_OWNERS)
+        return;
+
+    HeapTagOwner& o = owners[footer[0]];
+    o.live -= *c;
+    o.frees++;
+    footer[1] = 0;
+}
+
+void heap_tag_report(StreamOutput* str)
+{
+    str->printf("Heap by owner, bytes live/peak, allocations/frees:\n");
+    for (int i = 0; i < owner_count; i++)
+    {
+        const HeapTagOwner& o = owners[i];
+        if (i == 0)
+            str->printf("  core                         ");
+        else
+            str->printf("  module %p vtable %p", o.owner, *(void* const*) o.owner);
+        str->printf(" %6lu/%6lu %6lu/%6lu\n", o.live, o.peak, o.allocations, o.frees);
+    }
+}
+
+#else
+
+void heap_tag_report(StreamOutput* str)
+{
+    str->printf("Heap tags not enabled, build with HEAP_TAGS=1\n");
+}
+
+#endif
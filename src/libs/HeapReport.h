@@ -0,0 +1,65 @@
+#ifndef _HEAPREPORT_H
+#define _HEAPREPORT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+class StreamOutput;
+
+// Renders which parts of a memory region are used as a row of characters,
+// '#' all used, '.' all free, '+' both, so fragmentation shows at a glance
+#define FRAGMENTATION_MAP_CELLS 128
+
+class FragmentationMap
+{
+public:
+    FragmentationMap(uint32_t start, uint32_t size);
+
+    void add(uint32_t address, uint32_t length, bool used);
+    void print(StreamOutput*);
+
+private:
+    uint32_t start;
+    uint32_t size;
+    char     cells[FRAGMENTATION_MAP_CELLS];
+};
+
+/*
+ * With HEAP_TAGS set in the makefile every heap allocation is charged to an owner, the module the kernel is
+ * loading or calling an event on when it was made, or the core for anything else.
+ * Owners are printed as the module address and its vtable, look the vtable up in main.map to get the class.
+ * The tag lives in 8 bytes added to the end of each allocation. Allocations newlib makes for itself ( strdup, stdio )
+ * bypass the malloc wrapper and are not counted.
+ */
+#define HEAP_TAG_OWNERS 40
+
+#ifdef HEAP_TAGS
+
+class HeapTagScope
+{
+public:
+    HeapTagScope(const void* owner);
+    ~HeapTagScope();
+
+private:
+    uint8_t previous;
+};
+
+// called from the malloc wrappers in mbed_custom.cpp
+#define HEAP_TAG_FOOTER 8
+extern "C" void heap_tag_alloc(void* p);
+extern "C" void heap_tag_free(void* p);
+
+#else
+
+class HeapTagScope
+{
+public:
+    HeapTagScope(const void*) {}
+};
+
+#endif
+
+void heap_tag_report(StreamOutput*);
+
+#endif /* _HEAPREPORT_H */
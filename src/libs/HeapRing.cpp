@@ -3,6 +3,7 @@
 #include <cstdlib>
 
 #include "cmsis.h"
+#include "MemoryPool.h"
 
 /*
  * constructors
@@ -10,16 +11,13 @@
 
 template<class kind> HeapRing<kind>::HeapRing()
 {
-    head_i = tail_i = length = 0;
-    ring = NULL;
+    owned = false;
 }
 
 template<class kind> HeapRing<kind>::HeapRing(unsigned int length)
 {
-    head_i = tail_i = 0;
-    ring = new kind[length];
-    // TODO: handle allocation failure
-    this->length = length;
+    owned = false;
+    resize(length);
 }
 
 /*
@@ -28,36 +26,17 @@ template<class kind> HeapRing<kind>::HeapRing(unsigned int length)
 
 template<class kind> HeapRing<kind>::~HeapRing()
 {
-    head_i = tail_i = length = 0;
-    if (ring)
-        delete [] ring;
-    ring = NULL;
+    kind* oldring = this->ring;
+    this->mask = 0;
+    this->ring = NULL;
+    release(oldring);
 }
 
-/*
- * index accessors (protected)
- */
-
-template<class kind> unsigned int HeapRing<kind>::next(unsigned int item)
+template<class kind> void HeapRing<kind>::release(kind* oldring)
 {
-    if (length == 0)
-        return 0;
-
-    if (++item >= length)
-        return 0;
-
-    return item;
-}
-
-template<class kind> unsigned int HeapRing<kind>::prev(unsigned int item)
-{
-    if (length == 0)
-        return 0;
-
-    if (item == 0)
-        return (length - 1);
-    else
-        return (item - 1);
+    // a provided buffer belongs to whoever provided it
+    if (oldring && owned)
+        delete [] oldring;
 }
 
 /*
@@ -66,142 +45,88 @@ template<class kind> unsigned int HeapRing<kind>::prev(unsigned int item)
 
 template<class kind> kind& HeapRing<kind>::head()
 {
-    return ring[head_i];
+    return *this->head_ref();
 }
 
 template<class kind> kind& HeapRing<kind>::tail()
 {
-    return ring[tail_i];
+    return *this->tail_ref();
 }
 
 template<class kind> kind& HeapRing<kind>::item(unsigned int i)
 {
-    return ring[i];
-}
-
-template<class kind> void HeapRing<kind>::push_front(kind& item)
-{
-    ring[head_i] = item;
-    head_i = next(head_i);
-}
-
-template<class kind> kind& HeapRing<kind>::pop_back()
-{
-    kind& r = ring[tail_i];
-    tail_i = next(tail_i);
-    return r;
-}
-
-/*
- * pointer accessors
- */
-
-template<class kind> kind* HeapRing<kind>::head_ref()
-{
-    return &ring[head_i];
-}
-
-template<class kind> kind* HeapRing<kind>::tail_ref()
-{
-    return &ring[tail_i];
+    return this->ring[i & this->mask];
 }
 
 template<class kind> kind* HeapRing<kind>::item_ref(unsigned int i)
 {
-    return &ring[i];
-}
-
-template<class kind> void HeapRing<kind>::produce_head()
-{
-    while (is_full());
-    head_i = next(head_i);
-}
-
-template<class kind> void HeapRing<kind>::consume_tail()
-{
-    if (!is_empty())
-        tail_i = next(tail_i);
+    return &this->ring[i & this->mask];
 }
 
 /*
- * queue status accessors
+ * resize
  */
 
-template<class kind> bool HeapRing<kind>::is_full()
+template<class kind> bool HeapRing<kind>::resize(unsigned int length)
 {
-    __disable_irq();
-    bool r = (next(head_i) == tail_i);
-    __enable_irq();
-
-    return r;
+    return resize(length, NULL);
 }
 
-template<class kind> bool HeapRing<kind>::is_empty()
+template<class kind> bool HeapRing<kind>::resize(unsigned int length, MemoryPool* pool)
 {
-    __disable_irq();
-    bool r = (head_i == tail_i);
-    __enable_irq();
-
-    return r;
-}
+    if (!this->is_empty())
+        return false;
 
-/*
- * resize
- */
-
-template<class kind> bool HeapRing<kind>::resize(unsigned int length)
-{
-    if (is_empty())
+    if (length == 0)
     {
-        if (length == 0)
-        {
-            __disable_irq();
+        __disable_irq();
 
-            if (is_empty()) // check again in case something was pushed
-            {
-                head_i = tail_i = this->length = 0;
-
-                __enable_irq();
-
-                if (ring)
-                    delete [] ring;
-                ring = NULL;
-
-                return true;
-            }
+        if (this->is_empty()) // check again in case something was pushed
+        {
+            kind* oldring = this->ring;
+            this->ring = NULL;
+            this->mask = 0;
+            this->head_i = this->tail_i = 0;
 
             __enable_irq();
 
-            return false;
+            release(oldring);
+            owned = false;
+
+            return true;
         }
 
-        // Note: we don't use realloc so we can fall back to the existing ring if allocation fails
-        kind* newring = new kind[length];
+        __enable_irq();
 
-        if (newring != NULL)
-        {
-            kind* oldring = ring;
+        return false;
+    }
 
-            __disable_irq();
+    length = SpscRing<kind>::round_length_down(length);
 
-            if (is_empty()) // check again in case something was pushed while malloc did its thing
-            {
-                ring = newring;
-                this->length = length;
-                head_i = tail_i = 0;
+    // Note: we don't use realloc so we can fall back to the existing ring if allocation fails
+    kind* newring = (pool != NULL) ? new (*pool) kind[length] : new kind[length];
 
-                __enable_irq();
+    if (newring != NULL)
+    {
+        kind* oldring = this->ring;
 
-                if (oldring)
-                    delete [] oldring;
+        __disable_irq();
 
-                return true;
-            }
+        if (this->is_empty()) // check again in case something was pushed while malloc did its thing
+        {
+            this->attach(newring, length);
 
             __enable_irq();
 
-            delete [] newring;
+            release(oldring);
+            owned = true;
+
+            return true;
         }
+
+        __enable_irq();
+
+        delete [] newring;
     }
 
     return false;
@@ -211,20 +136,17 @@ template<class kind> bool HeapRing<kind>::provide(kind* buffer, unsigned int len
 {
     __disable_irq();
 
-    if (is_empty())
+    if (this->is_empty())
     {
-        kind* oldring = ring;
+        kind* oldring = this->ring;
 
-        if ((buffer != NULL) && (length > 0))
+        if (this->attach(buffer, length))
         {
-            ring = buffer;
-            this->length = length;
-            head_i = tail_i = 0;
-
             __enable_irq();
 
-            if (oldring)
-                delete [] oldring;
+            release(oldring);
+            owned = false;
+
             return true;
         }
     }
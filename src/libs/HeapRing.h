@@ -1,7 +1,17 @@
 #ifndef _HEAPRING_H
 #define _HEAPRING_H
 
-template<class kind> class HeapRing {
+#include "SpscRing.h"
+
+class MemoryPool;
+
+/*
+ * A SpscRing that allocates its own ring, and lets the planner walk the queued items by index
+ *
+ * The main loop prepares head_ref() and calls produce_head(), the step ISR works on tail_ref() and calls consume_tail()
+ */
+
+template<class kind> class HeapRing : public SpscRing<kind> {
 
     // smoothie-specific friend classes
     friend class Planner;
@@ -20,35 +30,21 @@ public:
     kind& head();
     kind& tail();
 
-    void push_front(kind&) __attribute__ ((warning("Not thread-safe if pop_back() is used in ISR context!"))); // instead, prepare(head_ref()); produce_head();
-    kind& pop_back(void) __attribute__ ((warning("Not thread-safe if head_ref() is used to prepare new items, or push_front() is used in ISR context!"))); // instead, consume(tail_ref()); consume_tail();
-
-    /*
-     * pointer accessors
-     */
-    kind* head_ref();
-    kind* tail_ref();
-
-    void  produce_head(void);
-    void  consume_tail(void);
-
-    /*
-     * queue status
-     */
-    bool is_empty(void);
-    bool is_full(void);
-
     /*
      * resize
      *
+     * the length is rounded down to a power of two, so the ring never takes more memory than asked for
+     *
      * returns true on success, or false if queue is not empty or not enough memory available
      */
     bool resize(unsigned int);
+    // same, allocating the ring from the given pool, or the heap if it is NULL
+    bool resize(unsigned int, MemoryPool*);
 
     /*
      * provide
      * kind*      - new buffer pointer
-     * int length - number of items in buffer (NOT size in bytes!)
+     * int length - number of items in buffer (NOT size in bytes!), must be a power of two
      *
      * cause HeapRing to use a specific memory location instead of allocating its own
      *
@@ -60,23 +56,19 @@ protected:
     /*
      * these functions are protected as they should only be used internally
      * or in extremely specific circumstances
+     *
+     * indices run freely like head_i and tail_i, and are masked into the ring here
      */
     kind& item(unsigned int);
     kind* item_ref(unsigned int);
 
-    unsigned int next(unsigned int);
-    unsigned int prev(unsigned int);
-
-    /*
-     * buffer variables
-     */
-    unsigned int length;
-
-    volatile unsigned int head_i;
-    volatile unsigned int tail_i;
+    unsigned int next(unsigned int i) { return i + 1; };
+    unsigned int prev(unsigned int i) { return i - 1; };
 
 private:
-    kind* ring;
+    void release(kind*);
+
+    bool owned;
 };
 
 #endif /* _HEAPRING_H */
@@ -1,14 +1,39 @@
 #ifndef HOOK_H
 #define HOOK_H
-#include "libs/FPointer.h"
 
-// Hook is just a glorified FPointer
+#include <stdint.h>
+#include <string.h>
 
-class Hook : public FPointer {
+// Hook is a small delegate : an object and one of its methods, stored inline so attaching one never uses the heap
+// Calling it is a single direct call to a small function generated for the object's type, which then calls the method
+
+class Hook {
     public:
-        Hook();
-        int     interval;
-        int     countdown;
+        Hook() : object(NULL), invoker(NULL) {}
+
+        template<typename T> void attach( T *optr, uint32_t ( T::*fptr )( uint32_t ) ){
+            static_assert(sizeof(fptr) <= sizeof(method), "method pointer does not fit in a Hook");
+            memcpy(&this->method, &fptr, sizeof(fptr));
+            this->object = optr;
+            this->invoker = &Hook::invoke<T>;
+        }
+
+        void detach() { this->invoker = NULL; this->object = NULL; }
+        bool is_attached() const { return this->invoker != NULL; }
+
+        // Only call a Hook that has been attached
+        inline uint32_t call(uint32_t argument = 0) { return this->invoker(this, argument); }
+
+    private:
+        template<typename T> static uint32_t invoke( Hook *hook, uint32_t argument ){
+            uint32_t ( T::*fptr )( uint32_t );
+            memcpy(&fptr, &hook->method, sizeof(fptr));
+            return (static_cast<T*>(hook->object)->*fptr)(argument);
+        }
+
+        void *object;
+        uint32_t ( *invoker )( Hook*, uint32_t );
+        uint32_t ( Hook::*method )( uint32_t ); // storage for the object's method pointer, all method pointers have this size
 };
 
 #endif
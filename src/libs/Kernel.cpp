@@ -12,12 +12,17 @@
 #include "libs/SlowTicker.h"
 #include "libs/Adc.h"
 #include "libs/StreamOutputPool.h"
+#include "libs/StreamOutput.h"
+#include "libs/CycleCounter.h"
+#include "libs/HeapReport.h"
+#include "platform_memory.h"
 #include <mri.h>
 #include "checksumm.h"
 #include "ConfigValue.h"
 
 #include "libs/StepTicker.h"
 #include "libs/PublicData.h"
+#include "libs/DirectoryIndex.h"
 #include "modules/communication/SerialConsole.h"
 #include "modules/communication/GcodeDispatch.h"
 #include "modules/robot/Planner.h"
@@ -28,19 +33,50 @@
 
 #include <malloc.h>
 #include <array>
+#include <new>
 
 #define baud_rate_setting_checksum CHECKSUM("baud_rate")
 #define uart0_checksum             CHECKSUM("uart0")
+#define buffer_bank_checksum       CHECKSUM("buffer_bank")
 
 #define base_stepping_frequency_checksum            CHECKSUM("base_stepping_frequency")
 #define microseconds_per_step_pulse_checksum        CHECKSUM("microseconds_per_step_pulse")
 
 Kernel* Kernel::instance;
 
+// names of the events for the profiler output, in the same order as _EVENT_ENUM
+static const char *event_names[NUMBER_OF_DEFINED_EVENTS] = {
+    "main_loop",
+    "console_line_received",
+    "gcode_received",
+    "gcode_execute",
+    "speed_change",
+    "block_begin",
+    "block_end",
+    "play",
+    "pause",
+    "idle",
+    "second_tick",
+    "get_public_data",
+    "set_public_data"
+};
+
+// The console is created again once the config is loaded, which may place it and its receive buffer in an AHB bank
+static SerialConsole *create_serial_console(PinName rx_pin, PinName tx_pin, int baud_rate, MemoryPool *pool)
+{
+    if(pool != NULL) {
+        void *p = pool->alloc(sizeof(SerialConsole));
+        if(p != NULL) return new(p) SerialConsole(rx_pin, tx_pin, baud_rate);
+    }
+    return new SerialConsole(rx_pin, tx_pin, baud_rate);
+}
+
 // The kernel is the central point in Smoothie : it stores modules, and handles event calls
 Kernel::Kernel(){
     instance= this; // setup the Singleton instance of the kernel
 
+    this->profiling = false;
+
     // serial first at fixed baud rate (DEFAULT_SERIAL_BAUD_RATE) so config can report errors to serial
 	// Set to UART0, this will be changed to use the same UART as MRI if it's enabled
     this->serial = new SerialConsole(USBTX, USBRX, DEFAULT_SERIAL_BAUD_RATE);
@@ -58,30 +94,33 @@ Kernel::Kernel(){
     this->streams        = new StreamOutputPool();
 
     this->current_path   = "/";
+    this->directory_index = new DirectoryIndex();
 
     // Configure UART depending on MRI config
     // Match up the SerialConsole to MRI UART. This makes it easy to use only one UART for both debug and actual commands.
     NVIC_SetPriorityGrouping(0);
 
+    MemoryPool *serial_pool = memory_bank_pool(this->config->value(uart0_checksum, buffer_bank_checksum)->by_default("main")->as_string());
+
 #if MRI_ENABLE != 0
     switch( __mriPlatform_CommUartIndex() ) {
         case 0:
-            this->serial = new SerialConsole(USBTX, USBRX, this->config->value(uart0_checksum,baud_rate_setting_checksum)->by_default(DEFAULT_SERIAL_BAUD_RATE)->as_number());
+            this->serial = create_serial_console(USBTX, USBRX, this->config->value(uart0_checksum,baud_rate_setting_checksum)->by_default(DEFAULT_SERIAL_BAUD_RATE)->as_number(), serial_pool);
             break;
         case 1:
-            this->serial = new SerialConsole(  p13,   p14, this->config->value(uart0_checksum,baud_rate_setting_checksum)->by_default(DEFAULT_SERIAL_BAUD_RATE)->as_number());
+            this->serial = create_serial_console(p13, p14, this->config->value(uart0_checksum,baud_rate_setting_checksum)->by_default(DEFAULT_SERIAL_BAUD_RATE)->as_number(), serial_pool);
             break;
         case 2:
-            this->serial = new SerialConsole(  p28,   p27, this->config->value(uart0_checksum,baud_rate_setting_checksum)->by_default(DEFAULT_SERIAL_BAUD_RATE)->as_number());
+            this->serial = create_serial_console(p28, p27, this->config->value(uart0_checksum,baud_rate_setting_checksum)->by_default(DEFAULT_SERIAL_BAUD_RATE)->as_number(), serial_pool);
             break;
         case 3:
-            this->serial = new SerialConsole(   p9,   p10, this->config->value(uart0_checksum,baud_rate_setting_checksum)->by_default(DEFAULT_SERIAL_BAUD_RATE)->as_number());
+            this->serial = create_serial_console(p9, p10, this->config->value(uart0_checksum,baud_rate_setting_checksum)->by_default(DEFAULT_SERIAL_BAUD_RATE)->as_number(), serial_pool);
             break;
     }
 #endif
     // default
     if(this->serial == NULL) {
-        this->serial = new SerialConsole(USBTX, USBRX, this->config->value(uart0_checksum,baud_rate_setting_checksum)->by_default(DEFAULT_SERIAL_BAUD_RATE)->as_number());
+        this->serial = create_serial_console(USBTX, USBRX, this->config->value(uart0_checksum,baud_rate_setting_checksum)->by_default(DEFAULT_SERIAL_BAUD_RATE)->as_number(), serial_pool);
     }
 
     this->add_module( this->config );
@@ -99,6 +138,9 @@ Kernel::Kernel(){
     NVIC_SetPriority(TIMER1_IRQn, 1);
     NVIC_SetPriority(TIMER2_IRQn, 3);
 
+    // The console DMA must keep up with the UART, but not hold up the step timers
+    NVIC_SetPriority(DMA_IRQn, 3);
+
     // Set other priorities lower than the timers
     NVIC_SetPriority(ADC_IRQn, 4);
     NVIC_SetPriority(USB_IRQn, 4);
@@ -135,24 +177,125 @@ Kernel::Kernel(){
 
 // Add a module to Kernel. We don't actually hold a list of modules, we just tell it where Kernel is
 void Kernel::add_module(Module* module){
+    // note which config families the module reads so a reload can find it, modules may add modules so keep the previous one
+    Module *previous = this->config->set_reading_module(module);
+    HeapTagScope tag(module);
     module->on_module_loaded();
+    this->config->set_reading_module(previous);
 }
 
 // Adds a hook for a given module and event
 void Kernel::register_for_event(_EVENT_ENUM id_event, Module *mod){
+    if( is_fast_event(id_event) ){
+        if( this->fast_hooks[id_event - FIRST_FAST_EVENT].add(mod, kernel_callback_functions[id_event]) ){
+            return;
+        }
+        // Table is full, the overflow goes through the normal hooks vector
+    }
     this->hooks[id_event].push_back(mod);
 }
 
 // Call a specific event without arguments
 void Kernel::call_event(_EVENT_ENUM id_event){
+    if( is_fast_event(id_event) ){
+        this->call_fast_event(id_event, this);
+        return;
+    }
+    if( this->profiling ){
+        this->call_event_profiled(id_event, this);
+        return;
+    }
     for (auto m : hooks[id_event]) {
+        HeapTagScope tag(m);
         (m->*kernel_callback_functions[id_event])(this);
     }
 }
 
 // Call a specific event with an argument
 void Kernel::call_event(_EVENT_ENUM id_event, void * argument){
+    if( is_fast_event(id_event) ){
+        this->call_fast_event(id_event, argument);
+        return;
+    }
+    if( this->profiling ){
+        this->call_event_profiled(id_event, argument);
+        return;
+    }
     for (auto m : hooks[id_event]) {
+        HeapTagScope tag(m);
         (m->*kernel_callback_functions[id_event])(argument);
     }
 }
+
+// Events called from interrupt context, walk the fixed array of direct calls
+void Kernel::call_fast_event(_EVENT_ENUM id_event, void * argument){
+    this->fast_hooks[id_event - FIRST_FAST_EVENT].call(argument);
+
+    // Only happens if more modules subscribed than MAX_FAST_EVENT_SUBSCRIBERS
+    if( !hooks[id_event].empty() ){
+        for (auto m : hooks[id_event]) {
+            (m->*kernel_callback_functions[id_event])(argument);
+        }
+    }
+}
+
+// Same as call_event, but count the cycles spent in each module
+// NOTE the time for an event includes any events called from inside it, like the ON_IDLE calls made while waiting for the queue
+void Kernel::call_event_profiled(_EVENT_ENUM id_event, void * argument){
+    // modules may have registered since the profiler was started
+    if( this->profiles[id_event].size() < hooks[id_event].size() ){
+        this->profiles[id_event].resize(hooks[id_event].size(), EventProfile());
+    }
+
+    for (size_t i = 0; i < hooks[id_event].size(); i++) {
+        uint32_t start = get_cycle_count();
+        {
+            HeapTagScope tag(hooks[id_event][i]);
+            (hooks[id_event][i]->*kernel_callback_functions[id_event])(argument);
+        }
+        uint32_t cycles = get_cycle_count() - start;
+
+        // don't hold on to the entry across the call, a nested event may have resized the vector
+        if( i >= this->profiles[id_event].size() ) continue;
+        EventProfile& profile = this->profiles[id_event][i];
+        profile.total_cycles += cycles;
+        profile.calls++;
+        if( cycles > profile.worst_cycles ){
+            profile.worst_cycles = cycles;
+        }
+    }
+}
+
+void Kernel::set_profiling(bool enable){
+    if( enable ){
+        start_cycle_counter();
+    }
+    this->profiling = enable;
+}
+
+void Kernel::reset_profile(){
+    for (auto& p : this->profiles) {
+        p.clear();
+    }
+}
+
+// Modules have no names, so we print the address of the handler that was called, which can be looked up in the map file
+// or with addr2line on the elf
+void Kernel::print_profile(StreamOutput *stream){
+    uint32_t cycles_per_us = SystemCoreClock / 1000000;
+    stream->printf("Profiling is %s, times in us, cycles at %luMHz\r\n", this->profiling ? "on" : "off", cycles_per_us);
+    for (int id_event = 0; id_event < NUMBER_OF_DEFINED_EVENTS; id_event++) {
+        for (size_t i = 0; i < this->profiles[id_event].size() && i < hooks[id_event].size(); i++) {
+            const EventProfile& profile = this->profiles[id_event][i];
+            if( profile.calls == 0 ) continue;
+            Module *m = hooks[id_event][i];
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpmf-conversions"
+            void *handler = (void *)(m->*kernel_callback_functions[id_event]);
+#pragma GCC diagnostic pop
+            stream->printf("%-22s %p calls: %lu, total: %lu, avg: %lu, worst: %lu\r\n", event_names[id_event], handler, profile.calls,
+                           (uint32_t)(profile.total_cycles / cycles_per_us), (uint32_t)(profile.total_cycles / profile.calls / cycles_per_us),
+                           profile.worst_cycles / cycles_per_us);
+        }
+    }
+}
@@ -14,6 +14,7 @@
 #include <array>
 #include <vector>
 #include <string>
+#include <stdint.h>
 
 //Module manager
 class Config;
@@ -30,6 +31,50 @@ class Planner;
 class StepTicker;
 class Adc;
 class PublicData;
+class StreamOutput;
+class DirectoryIndex;
+
+// Maximum number of modules that can subscribe to each of the events called from interrupt context
+#define MAX_FAST_EVENT_SUBSCRIBERS 10
+
+// A subscriber to one of the fast events, the handler is resolved when registering so calling it is a direct call
+typedef void (*FastEventHandler)(Module*, void*);
+struct FastEventSubscriber {
+    FastEventHandler handler;
+    Module*          module;
+};
+
+// The subscribers to one of the fast events, kept in a fixed array so calling them needs no vector or virtual lookup
+class FastEventList {
+    public:
+        FastEventList() : count(0) {}
+
+        // Returns false if the list is full
+        bool add(Module *mod, ModuleCallback callback){
+            uint8_t n = this->count;
+            if( n >= MAX_FAST_EVENT_SUBSCRIBERS ) return false;
+            // Resolve the virtual method for this module now, so the interrupt does not have to ( GCC bound member function extension )
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpmf-conversions"
+            this->subscribers[n].handler = (FastEventHandler)(mod->*callback);
+#pragma GCC diagnostic pop
+            this->subscribers[n].module  = mod;
+            // Only make the new subscriber visible once it is completely filled in
+            this->count = n + 1;
+            return true;
+        }
+
+        inline void call(void *argument) const {
+            const FastEventSubscriber *subscriber = this->subscribers;
+            for (uint8_t i = this->count; i > 0; i--, subscriber++) {
+                subscriber->handler(subscriber->module, argument);
+            }
+        }
+
+    private:
+        FastEventSubscriber subscribers[MAX_FAST_EVENT_SUBSCRIBERS];
+        volatile uint8_t    count;
+};
 
 class Kernel {
     public:
@@ -42,6 +87,12 @@ class Kernel {
         void call_event(_EVENT_ENUM id_event);
         void call_event(_EVENT_ENUM id_event, void * argument);
 
+        // Optional per module event profiling, see the profile command in SimpleShell
+        void set_profiling(bool enable);
+        bool is_profiling() const { return profiling; }
+        void reset_profile();
+        void print_profile(StreamOutput *stream);
+
         // These modules are aviable to all other modules
         SerialConsole*    serial;
         StreamOutputPool* streams;
@@ -60,12 +111,29 @@ class Kernel {
         Adc*              adc;
         bool              use_leds;
         std::string       current_path;
+        DirectoryIndex*   directory_index;   // listing of the last folder shown, see DirectoryIndex.h
         int               base_stepping_frequency;
 
     private:
+        static bool is_fast_event(_EVENT_ENUM id_event){ return id_event >= FIRST_FAST_EVENT && id_event <= LAST_FAST_EVENT; }
+        void call_fast_event(_EVENT_ENUM id_event, void * argument);
+        void call_event_profiled(_EVENT_ENUM id_event, void * argument);
+
         // When a module asks to be called for a specific event ( a hook ), this is where that request is remembered
         std::array<std::vector<Module*>, NUMBER_OF_DEFINED_EVENTS> hooks;
 
+        // The events called from interrupt context ( speed change, block begin/end ) are kept in fixed arrays instead
+        FastEventList fast_hooks[LAST_FAST_EVENT - FIRST_FAST_EVENT + 1];
+
+        // Cycles spent in each module for each event, in the same order as hooks, only filled while profiling
+        struct EventProfile {
+            uint64_t total_cycles;
+            uint32_t worst_cycles;
+            uint32_t calls;
+        };
+        std::array<std::vector<EventProfile>, NUMBER_OF_DEFINED_EVENTS> profiles;
+        bool profiling;
+
 };
 
 #endif
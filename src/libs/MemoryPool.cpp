@@ -1,6 +1,7 @@
 #include "MemoryPool.h"
 
 #include "StreamOutput.h"
+#include "HeapReport.h"
 
 #include <mri.h>
 #include <cstdio>
@@ -16,15 +17,25 @@ typedef struct __attribute__ ((packed))
 } _poolregion;
 
 MemoryPool* MemoryPool::first = NULL;
+uint8_t* MemoryPool::lowest = NULL;
+uint8_t* MemoryPool::highest = NULL;
 
 MemoryPool::MemoryPool(void* base, uint16_t size)
 {
     this->base = base;
     this->size = size;
+    this->refused_count = 0;
+    this->refused_total = 0;
 
     ((_poolregion*) base)->used = 0;
     ((_poolregion*) base)->next = size;
 
+    // widen the range covered by pools
+    if (first == NULL || (uint8_t*) base < lowest)
+        lowest = (uint8_t*) base;
+    if (first == NULL || (uint8_t*) base + size > highest)
+        highest = (uint8_t*) base + size;
+
     // insert ourselves into head of LL
     next = first;
     first = this;
@@ -111,6 +122,8 @@ void* MemoryPool::alloc(size_t nbytes)
     } while (p <= (_poolregion*) (((uint8_t*)base) + size));
 
     // fell off the end of the region!
+    refused_count++;
+    refused_total += nbytes;
     return NULL;
 }
 
@@ -221,3 +234,38 @@ uint32_t MemoryPool::free()
         p = (_poolregion*) (((uint8_t*) p) + p->next);
     } while (1);
 }
+
+uint32_t MemoryPool::largest_free()
+{
+    uint32_t largest = 0;
+
+    _poolregion* p = (_poolregion*) base;
+
+    do {
+        if (p->used == 0 && p->next > largest)
+            largest = p->next;
+        if (offset(p) + p->next >= size)
+            return largest;
+        if (p->next <= sizeof(_poolregion))
+            return largest;
+        p = (_poolregion*) (((uint8_t*) p) + p->next);
+    } while (1);
+}
+
+void MemoryPool::map(StreamOutput* str)
+{
+    FragmentationMap m((uint32_t) base, size);
+
+    _poolregion* p = (_poolregion*) base;
+
+    do {
+        m.add((uint32_t) p, p->next, p->used);
+        if (offset(p) + p->next >= size)
+            break;
+        if (p->next <= sizeof(_poolregion))
+            break;
+        p = (_poolregion*) (((uint8_t*) p) + p->next);
+    } while (1);
+
+    m.print(str);
+}
@@ -5,6 +5,8 @@
 // #include <cstdio>
 #include <cstdlib>
 
+#include "SlabPool.h"
+
 #ifdef MEMDEBUG
     #define MDEBUG(...) printf(__VA_ARGS__)
 #else
@@ -12,6 +14,7 @@
 #endif
 
 class StreamOutput;
+class FragmentationMap;
 
 /*
  * with MUCH thanks to http://www.parashift.com/c++-faq-lite/memory-pools.html
@@ -33,14 +36,29 @@ public:
     bool  has(void*);
 
     uint32_t free(void);
+    uint32_t largest_free(void);
+    void     map(StreamOutput*);
+
+    // allocations that did not fit, their callers went to main memory or did without
+    uint16_t refused(void) const { return refused_count; }
+    uint32_t refused_bytes(void) const { return refused_total; }
+
+    // the pool that p was allocated from, or NULL
+    static MemoryPool* owner(void* p);
 
     MemoryPool* next;
 
     static MemoryPool* first;
 
+    // the range spanned by all pools, so pointers outside it are told apart with one compare
+    static uint8_t* lowest;
+    static uint8_t* highest;
+
 private:
     void* base;
     uint16_t size;
+    uint16_t refused_count;
+    uint32_t refused_total;
 };
 
 // this overloads "placement new"
@@ -49,30 +67,33 @@ inline void* operator new(size_t nbytes, MemoryPool& pool)
     return pool.alloc(nbytes);
 }
 
+// arrays, noexcept so the compiler checks for NULL before running the constructors
+inline void* operator new[](size_t nbytes, MemoryPool& pool) noexcept
+{
+    return pool.alloc(nbytes);
+}
+
 // this allows placement new to free memory if the constructor fails
 inline void  operator delete(void* p, MemoryPool& pool)
 {
     pool.dealloc(p);
 }
 
-// this catches all usages of delete blah. The object's destructor is called before we get here
-// it first checks if the deleted object is part of a pool, and uses free otherwise.
-inline void  operator delete(void* p)
+inline MemoryPool* MemoryPool::owner(void* p)
 {
-    MemoryPool* m = MemoryPool::first;
+    if ((uint8_t*) p < lowest || (uint8_t*) p >= highest)
+        return NULL;
+
+    MemoryPool* m = first;
     while (m)
     {
         if (m->has(p))
-        {
-            MDEBUG("Pool %p has %p, using dealloc()\n", m, p);
-            m->dealloc(p);
-            return;
-        }
+            return m;
         m = m->next;
     }
-
-    MDEBUG("no pool has %p, using free()\n", p);
-    free(p);
+    return NULL;
 }
 
+// the global operator delete and delete[] that go with these are in SlabPool.cpp, next to operator new
+
 #endif /* _MEMORYPOOL_H */
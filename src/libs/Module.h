@@ -14,8 +14,8 @@ enum _EVENT_ENUM {
     ON_CONSOLE_LINE_RECEIVED,
     ON_GCODE_RECEIVED,
     ON_GCODE_EXECUTE,
-    ON_SPEED_CHANGE,
-    ON_BLOCK_BEGIN,
+    ON_SPEED_CHANGE,            // these three are called from interrupt context and must stay contiguous,
+    ON_BLOCK_BEGIN,             // see FIRST_FAST_EVENT and LAST_FAST_EVENT below
     ON_BLOCK_END,
     ON_PLAY,
     ON_PAUSE,
@@ -26,6 +26,10 @@ enum _EVENT_ENUM {
     NUMBER_OF_DEFINED_EVENTS
 };
 
+// Events in this range are dispatched by the Kernel through a fixed array of direct calls rather than the hooks vector
+#define FIRST_FAST_EVENT ON_SPEED_CHANGE
+#define LAST_FAST_EVENT  ON_BLOCK_END
+
 class Module;
 typedef void (Module::*ModuleCallback)(void * argument);
 extern const ModuleCallback kernel_callback_functions[NUMBER_OF_DEFINED_EVENTS];
@@ -57,6 +61,9 @@ public:
     virtual void on_get_public_data(void*){};
     virtual void on_set_public_data(void*){};
 
+    // not an event, Config calls this on the modules whose settings changed when the config is reloaded
+    virtual void on_config_reload(void*){};
+
 };
 
 #endif
@@ -31,9 +31,13 @@ extern "C" {
     }
 }
 
+// returns the number of queued commands, or -1 if the queue is full and the command was not added
 int CommandQueue::add(const char *cmd, StreamOutput *pstream)
 {
+    if(q.is_full()) return -1;
+
     cmd_t c= {strdup(cmd), pstream==NULL?null_stream:pstream};
+    if(c.str == NULL) return -1;
     q.push(c);
     if(pstream != NULL) {
         // count how many times this is on the queue
@@ -46,9 +50,9 @@ int CommandQueue::add(const char *cmd, StreamOutput *pstream)
 // pops the next command off the queue and submits it.
 bool CommandQueue::pop()
 {
-    if (q.size() == 0) return false;
+    cmd_t c;
+    if (!q.pop(c)) return false;
 
-    cmd_t c= q.pop();
     char *cmd= c.str;
 
     struct SerialMessage message;
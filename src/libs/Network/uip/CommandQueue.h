@@ -3,7 +3,7 @@
 
 #ifdef __cplusplus
 
-#include "fifo.h"
+#include "SpscRing.h"
 #include <string>
 
 class StreamOutput;
@@ -20,7 +20,8 @@ public:
 
 private:
     typedef struct {char* str; StreamOutput *pstream; } cmd_t;
-    Fifo<cmd_t> q;
+    // the network stack adds and the main loop pops, add() refuses a command when this is full
+    SpscBuffer<cmd_t, 64> q;
     static CommandQueue *instance;
     StreamOutput *null_stream;
 };
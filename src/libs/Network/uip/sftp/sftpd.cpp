@@ -20,6 +20,7 @@ Sftpd::Sftpd()
     state = STATE_NORMAL;
     outbuf = NULL;
     filename= NULL;
+    whole_file = false;
 }
 
 Sftpd::~Sftpd()
@@ -79,6 +80,8 @@ int Sftpd::handle_command()
                         DEBUG_PRINTF("sftp: Opening file: %s\n", fn);
                         fd = fopen(fn, "w");
                         if (fd != NULL) {
+                            digest.start();
+                            whole_file = true;
                             outbuf = "+ new file\n";
                             state = STATE_GET_LENGTH;
                         } else {
@@ -87,6 +90,8 @@ int Sftpd::handle_command()
                     } else if (strncmp(&buf[5], "APP", 3) == 0) {
                         fd = fopen(fn, "a");
                         if (fd != NULL) {
+                            digest.start();
+                            whole_file = false;
                             outbuf = "+ append file\n";
                             state = STATE_GET_LENGTH;
                         } else {
@@ -147,6 +152,7 @@ int Sftpd::handle_download()
             state = STATE_CONNECTED;
             return 0;
         }
+        digest.update(readptr, readlen);
         filesize -= readlen;
         DEBUG_PRINTF("sftp: saved %d bytes %d left\n", readlen, filesize);
         // HACK ALERT... to work around the fwrite/filesystem bug where writing large amounts of data corrupts the file
@@ -158,7 +164,10 @@ int Sftpd::handle_download()
         DEBUG_PRINTF("sftp: download complete\n");
         fclose(fd);
         fd = NULL;
-        outbuf = "+ Saved file\n";
+        // an appended file is only partly digested, so it is not remembered as the file's digest
+        digest.finish(whole_file ? this->filename : "");
+        snprintf(reply, sizeof(reply), "+ Saved file, %lu bytes, crc32 %08lx, md5 %s\n", (unsigned long)digest.get_size(), (unsigned long)digest.get_crc(), digest.get_md5());
+        outbuf = reply;
         state = STATE_CONNECTED;
         return 0;
     }
@@ -7,6 +7,7 @@
 
 
 #include <stdio.h>
+#include "FileDigest.h"
 extern "C" {
 #include "psock.h"
 }
@@ -34,6 +35,9 @@ private:
     const char *outbuf;
     unsigned int filesize;
     char *filename;
+    FileDigest digest;          // of what has been received, so the sender can check it
+    bool whole_file;            // the file was started afresh rather than appended to
+    char reply[96];             // "+ Saved file, ..." is 86 with a 10 digit size
 };
 
 #endif /* __sftpd_H__ */
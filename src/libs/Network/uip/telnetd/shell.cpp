@@ -182,7 +182,12 @@ static void unknown(char *str, Shell *sh)
 {
     // its some other command, so queue it for mainloop to find
     if (strlen(str) > 0) {
-        CommandQueue::getInstance()->add(str, sh->getStream());
+        // newdata() stops TCP once the queue passes 20, this only fills up when one segment holds more lines than the rest of the queue
+        if (CommandQueue::getInstance()->add(str, sh->getStream()) < 0) {
+            sh->output("error: command queue full, dropped: ");
+            sh->output(str);
+            sh->output("\n");
+        }
     }
 }
 /*---------------------------------------------------------------------------*/
@@ -74,6 +74,7 @@
 
 #include "CommandQueue.h"
 #include "CallbackStream.h"
+#include "FileDigest.h"
 
 #include "c-fifo.h"
 
@@ -143,6 +144,8 @@ static void create_callback_stream(struct httpd_state *s)
 static FILE *fd;
 static char *output_filename = NULL;
 static int file_cnt = 0;
+static void *digest = NULL;
+static char upload_reply[80];   // OK and the digest of what was saved, for the sender to check
 static int open_file(const char *fn)
 {
     if (output_filename != NULL) free(output_filename);
@@ -155,20 +158,28 @@ static int open_file(const char *fn)
         output_filename = NULL;
         return 0;
     }
+    if (digest != NULL) delete_file_digest(digest);
+    digest = new_file_digest();
     return 1;
 }
 
-static int close_file()
+// complete is set if the whole upload was saved, only then is the digest remembered for the file
+static int close_file(int complete)
 {
+    fclose(fd);
+    file_digest_finish(digest, complete ? output_filename : NULL);
+    snprintf(upload_reply, sizeof(upload_reply), "OK crc32 %08lx md5 %s\r\n", (unsigned long)file_digest_crc(digest), file_digest_md5(digest));
+    delete_file_digest(digest);
+    digest = NULL;
     free(output_filename);
     output_filename = NULL;
-    fclose(fd);
     return 1;
 }
 
 static int save_file(uint8_t *buf, unsigned int len)
 {
     if (fwrite(buf, 1, len, fd) == len) {
+        file_digest_update(digest, buf, len);
         file_cnt += len;
         // HACK alert work around bug causing file corruption when writing large amounts of data
         if (file_cnt >= 400) {
@@ -179,7 +190,7 @@ static int save_file(uint8_t *buf, unsigned int len)
         return 1;
 
     } else {
-        close_file();
+        close_file(0);
         return 0;
     }
 }
@@ -342,7 +353,7 @@ PT_THREAD(handle_output(struct httpd_state *s))
                 PSOCK_SEND_STR(&s->sout, "FAILED\r\n");
             } else {
                 PT_WAIT_THREAD(&s->outputpt, send_headers(s, http_header_200));
-                PSOCK_SEND_STR(&s->sout, "OK\r\n");
+                PSOCK_SEND_STR(&s->sout, upload_reply);
             }
 
         } else {
@@ -457,7 +468,7 @@ static PT_THREAD(handle_uploaded_data(struct httpd_state *s, uint8_t *buf, int l
         }
     }
 
-    close_file();
+    close_file(1);
     s->uploadok = 1;
     DEBUG_PRINTF("finished upload\n");
 
@@ -563,7 +574,8 @@ PT_THREAD(handle_input(struct httpd_state *s))
                     s->content_length -= PSOCK_DATALEN(&s->sin);
                     // stick the command  on the command queue, with this connections stream output
                     DEBUG_PRINTF("Adding command: %s, left: %d\n", s->inputbuf, s->content_length);
-                    network_add_command(s->inputbuf, s->pstream);
+                    // wait for the main loop to make room if the command queue is full
+                    PSOCK_WAIT_UNTIL(&s->sin, network_add_command(s->inputbuf, s->pstream) >= 0);
                     s->command_count++; // count number of command lines we submit
                 }
                 DEBUG_PRINTF("Read body done\n");
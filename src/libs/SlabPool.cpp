@@ -0,0 +1,131 @@
+#include "SlabPool.h"
+
+#include "MemoryPool.h"
+#include "StreamOutput.h"
+
+#include <new>
+
+// zeroed by the startup code either way, in an AHB bank it is placed ahead of that bank's MemoryPool
+#ifdef SLAB_SECTION
+#define SLAB_STR(x) #x
+#define SLAB_SECTION_NAME(x) SLAB_STR(x)
+uint8_t slab_memory[SLAB_MEMORY_SIZE] __attribute__ ((section (SLAB_SECTION_NAME(SLAB_SECTION)))) __attribute__((aligned(8)));
+static const char *slab_bank = SLAB_SECTION_NAME(SLAB_SECTION);
+#else
+uint8_t slab_memory[SLAB_MEMORY_SIZE] __attribute__((aligned(8)));
+static const char *slab_bank = "main memory";
+#endif
+
+// all zero is an empty pool, so this works before static constructors run
+SlabPool slab_pool;
+
+void* SlabPool::alloc(size_t nbytes)
+{
+    if (nbytes > SLAB_MAX_OBJECT)
+        return NULL;
+
+    int c = nbytes == 0 ? 0 : (nbytes - 1) / SLAB_CLASS_STEP;
+
+    if (free_list[c] == NULL)
+    {
+        if (pages_used == SLAB_PAGES)
+        {
+            overflows++;
+            return NULL;
+        }
+
+        // carve a new page into objects of this class
+        uint8_t* page = slab_memory + pages_used * SLAB_PAGE_SIZE;
+        page_class[pages_used++] = c + 1;
+
+        size_t object_size = (c + 1) * SLAB_CLASS_STEP;
+        for (size_t offset = 0; offset + object_size <= SLAB_PAGE_SIZE; offset += object_size)
+        {
+            FreeObject* o = (FreeObject*) (page + offset);
+            o->next = free_list[c];
+            free_list[c] = o;
+        }
+    }
+
+    FreeObject* o = free_list[c];
+    free_list[c] = o->next;
+    in_use[c]++;
+    return o;
+}
+
+void SlabPool::dealloc(void* p)
+{
+    int c = page_class[((uint8_t*) p - slab_memory) / SLAB_PAGE_SIZE] - 1;
+
+    FreeObject* o = (FreeObject*) p;
+    o->next = free_list[c];
+    free_list[c] = o;
+    in_use[c]--;
+}
+
+void SlabPool::debug(StreamOutput* str)
+{
+    str->printf("Slab: %d of %d pages used in %s, %u allocations overflowed to the heap\n", pages_used, SLAB_PAGES, slab_bank, overflows);
+    for (int c = 0; c < SLAB_CLASSES; c++)
+    {
+        int pages = 0;
+        for (int i = 0; i < pages_used; i++)
+            if (page_class[i] == c + 1)
+                pages++;
+        str->printf("\t%3d bytes: %d pages, %u in use\n", (c + 1) * SLAB_CLASS_STEP, pages, in_use[c]);
+    }
+}
+
+// Small objects come from the slab, anything else or anything that does not fit goes to the heap as before.
+// These replace the global ones, so allocations made inside libstdc++ come from here too, and every delete has to
+// go through the replacements below
+// With HEAP_TAGS everything goes to the heap so it gets charged to its owner
+void* operator new(size_t nbytes)
+{
+#ifndef HEAP_TAGS
+    void* p = slab_pool.alloc(nbytes);
+    if (p != NULL)
+        return p;
+#endif
+    return malloc(nbytes);
+}
+
+void* operator new[](size_t nbytes)
+{
+#ifndef HEAP_TAGS
+    void* p = slab_pool.alloc(nbytes);
+    if (p != NULL)
+        return p;
+#endif
+    return malloc(nbytes);
+}
+
+// this catches all usages of delete blah, in every translation unit and in libstdc++. The object's destructor is
+// called before we get here. It first checks if the deleted object is from the slab or part of a pool, and uses free otherwise.
+void operator delete(void* p) noexcept
+{
+    if (p == NULL)
+        return;
+
+    if (slab_pool.has(p))
+    {
+        slab_pool.dealloc(p);
+        return;
+    }
+
+    MemoryPool* m = MemoryPool::owner(p);
+    if (m)
+    {
+        MDEBUG("Pool %p has %p, using dealloc()\n", m, p);
+        m->dealloc(p);
+        return;
+    }
+
+    MDEBUG("no pool has %p, using free()\n", p);
+    free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    operator delete(p);
+}
@@ -0,0 +1,61 @@
+#ifndef _SLABPOOL_H
+#define _SLABPOOL_H
+
+#include <cstdint>
+#include <cstdlib>
+
+class StreamOutput;
+
+/*
+ * Segregated size class allocator for the small objects that get new'd and deleted all the time,
+ * Gcode objects and their strings, config values, vector storage and the like.
+ *
+ * The memory is a fixed block, handed out in pages, each page holds objects of one class only.
+ * Freed objects go on the free list of their class and pages are never given back, so the heap
+ * does not get peppered with small holes, and alloc and dealloc are O(1).
+ * Whether a pointer belongs to the slab is a single range compare.
+ *
+ * It has no constructor so it is usable before static constructors run.
+ */
+
+// The block is in main memory, where what it holds would otherwise go. A board with AHB RAM to spare can
+// build with eg -DSLAB_SECTION=AHBSRAM1, every AHB user that then fails to fit shows up as refused in mem.
+#ifndef SLAB_MEMORY_SIZE
+#define SLAB_MEMORY_SIZE 4096
+#endif
+#define SLAB_PAGE_SIZE   256
+#define SLAB_PAGES       (SLAB_MEMORY_SIZE / SLAB_PAGE_SIZE)
+#define SLAB_CLASS_STEP  16
+#define SLAB_CLASSES     4      // 16, 32, 48 and 64 bytes
+#define SLAB_MAX_OBJECT  (SLAB_CLASSES * SLAB_CLASS_STEP)
+
+static_assert(SLAB_MEMORY_SIZE % SLAB_PAGE_SIZE == 0 && SLAB_PAGES > 0 && SLAB_PAGES <= 255, "SLAB_MEMORY_SIZE must be 1 to 255 pages");
+
+extern uint8_t slab_memory[SLAB_MEMORY_SIZE];
+
+class SlabPool
+{
+public:
+    // returns NULL if the size is too big for a slab or its class is full, the caller should use malloc then
+    void* alloc(size_t);
+    void  dealloc(void* p);
+
+    bool  has(void* p) const { return (uint8_t*) p >= slab_memory && (uint8_t*) p < slab_memory + SLAB_MEMORY_SIZE; }
+
+    void  debug(StreamOutput*);
+
+private:
+    struct FreeObject {
+        FreeObject* next;
+    };
+
+    FreeObject* free_list[SLAB_CLASSES];
+    uint8_t     page_class[SLAB_PAGES];     // class of each page plus one, 0 if not handed out yet
+    uint8_t     pages_used;
+    uint16_t    in_use[SLAB_CLASSES];
+    uint16_t    overflows;                  // allocations that did not fit and went to the heap
+};
+
+extern SlabPool slab_pool;
+
+#endif /* _SLABPOOL_H */
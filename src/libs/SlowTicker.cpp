@@ -15,17 +15,23 @@ using namespace std;
 #include "modules/robot/Conveyor.h"
 #include "Pauser.h"
 #include "Gcode.h"
+#include "CycleCounter.h"
 
 #include <mri.h>
 
 // This module uses a Timer to periodically call hooks
 // Modules register with a function ( callback ) and a frequency, and we then call that function at the given frequency.
+// The timer runs freely, and its match register is reprogrammed after each interrupt for the next hook that is due,
+// so we are only interrupted when there is actually something to call.
+
+// Don't program a match closer than this to the current timer count, it could be missed
+#define MINIMUM_MATCH_DISTANCE 4
 
 SlowTicker* global_slow_ticker;
 
 SlowTicker::SlowTicker(){
-    max_frequency = 0;
     global_slow_ticker = this;
+    fire_now_pending = 0;
 
 
     // ISP button FIXME: WHy is this here?
@@ -33,16 +39,23 @@ SlowTicker::SlowTicker(){
 
     // TODO: What is this ??
     flag_1s_flag = 0;
-    flag_1s_count = SystemCoreClock>>2;
 
     g4_ticks = 0;
     g4_pause = false;
 
+    timing = false;
+    tick_timing = TickTiming();
+
     // Configure the actual timer after setup to avoid race conditions
     LPC_SC->PCONP |= (1 << 22);     // Power Ticker ON
-    LPC_TIM2->MR0 = 10000;          // Initial dummy value for Match Register
-    LPC_TIM2->MCR = 3;              // Match on MR0, reset on MR0
-    LPC_TIM2->TCR = 1;              // Enable interrupt
+    LPC_TIM2->MCR = 1;              // Interrupt on MR0, keep the timer running
+    LPC_TIM2->TCR = 3;              // Reset
+    LPC_TIM2->TCR = 1;              // Enable
+    last_tick = LPC_TIM2->TC;
+
+    // This also makes sure we get at least one interrupt a second, for the G4 and ISP button checks
+    this->attach(1, this, &SlowTicker::second_tick);
+
     NVIC_EnableIRQ(TIMER2_IRQn);    // Enable interrupt handler
 }
 
@@ -52,46 +65,158 @@ void SlowTicker::on_module_loaded(){
     register_for_event(ON_GCODE_EXECUTE);
 }
 
-// Set the base frequency we use for all sub-frequencies
-void SlowTicker::set_frequency( int frequency ){
-    this->interval = (SystemCoreClock >> 2) / frequency;   // SystemCoreClock/4 = Timer increments in a second
-    LPC_TIM2->MR0 = this->interval;
-    LPC_TIM2->TCR = 3;  // Reset
-    LPC_TIM2->TCR = 1;  // Reset
-    flag_1s_count= SystemCoreClock>>2;
+// Add a new hook to the schedule, it is first due one interval from now
+int SlowTicker::schedule(const TickerHook& hook){
+    // to avoid race conditions we must stop the interupts before updating these non thread safe vectors
+    __disable_irq();
+    unsigned int id = 0;
+    while( id < this->hooks.size() && this->hooks[id].hook.is_attached() ){
+        id++;
+    }
+    if( id == this->hooks.size() ){
+        this->hooks.push_back(hook);
+    }else{
+        this->hooks[id] = hook;
+    }
+    this->hooks[id].next_tick = LPC_TIM2->TC + hook.interval;
+    this->queue.push_back(id);
+    this->sift_up(this->queue.size() - 1);
+    if( this->queue.front() == id ){
+        LPC_TIM2->MR0 = this->hooks[id].next_tick;
+    }
+    __enable_irq();
+    return id;
 }
 
-// The actual interrupt being called by the timer, this is where work is done
-void SlowTicker::tick(){
+// Remove a hook from the schedule
+void SlowTicker::detach(int hook_id){
+    __disable_irq();
+    for (unsigned int i = 0; i < this->queue.size(); i++) {
+        if( this->queue[i] != hook_id ) continue;
+        this->queue[i] = this->queue.back();
+        this->queue.pop_back();
+        if( i < this->queue.size() ){
+            this->sift_down(i);
+            this->sift_up(i);
+        }
+        break;
+    }
+    this->hooks[hook_id].hook.detach();
+    if( hook_id < 32 ){
+        this->fire_now_pending &= ~(1UL << hook_id);
+    }
+    LPC_TIM2->MR0 = this->hooks[this->queue.front()].next_tick;
+    __enable_irq();
+}
+
+// Ask for a hook to be called as soon as possible, and then at its normal interval from that point on
+// Every other hook at the same rate is brought into that phase too, so the acceleration ticks of the
+// Extruder, Endstops and ZProbe keep lining up with the Stepper's
+// This may be called from a higher priority interrupt, so we only leave a note for tick() to act on
+// Only the first 32 hooks can be fired, the acceleration ticks are attached long before that
+void SlowTicker::fire_now(int hook_id){
+    if( hook_id < 0 || hook_id >= 32 ) return;
+    __disable_irq();
+    this->fire_now_pending |= (1UL << hook_id);
+    __enable_irq();
+    NVIC_SetPendingIRQ(TIMER2_IRQn);
+}
 
-    // Call all hooks that need to be called ( bresenham )
-    for (uint32_t i=0; i<this->hooks.size(); i++){
-        Hook* hook = this->hooks.at(i);
-        hook->countdown -= this->interval;
-        if (hook->countdown < 0)
-        {
-            hook->countdown += hook->interval;
-            hook->call();
+// Make the hooks fire_now() asked for due right now, along with every hook at the same rate as one of them
+void SlowTicker::fire_pending(uint32_t now){
+    __disable_irq();
+    uint32_t pending = this->fire_now_pending;
+    this->fire_now_pending = 0;
+    __enable_irq();
+    if( pending == 0 ) return;
+
+    for (unsigned int i = 0; i < this->queue.size(); i++) {
+        int interval = this->hooks[this->queue[i]].interval;
+        for (uint32_t bits = pending; bits != 0; bits &= bits - 1) {
+            if( this->hooks[__builtin_ctz(bits)].interval == interval ){
+                this->hooks[this->queue[i]].next_tick = now;
+                break;
+            }
         }
     }
 
-    // deduct tick time from secound counter
-    flag_1s_count -= this->interval;
-    // if a whole second has elapsed,
-    if (flag_1s_count < 0)
-    {
-        // add a second to our counter
-        flag_1s_count += SystemCoreClock >> 2;
-        // and set a flag for idle event to pick up
-        flag_1s_flag++;
+    // several due times changed, so build the heap again
+    for (int i = this->queue.size() / 2 - 1; i >= 0; i--) {
+        this->sift_down(i);
     }
+}
+
+void SlowTicker::sift_up(unsigned int index){
+    while( index > 0 ){
+        unsigned int parent = (index - 1) / 2;
+        if( !due_before(this->queue[index], this->queue[parent]) ) break;
+        uint8_t swap = this->queue[parent];
+        this->queue[parent] = this->queue[index];
+        this->queue[index] = swap;
+        index = parent;
+    }
+}
+
+void SlowTicker::sift_down(unsigned int index){
+    unsigned int size = this->queue.size();
+    while( true ){
+        unsigned int smallest = index;
+        unsigned int left = 2 * index + 1;
+        unsigned int right = left + 1;
+        if( left < size && due_before(this->queue[left], this->queue[smallest]) ) smallest = left;
+        if( right < size && due_before(this->queue[right], this->queue[smallest]) ) smallest = right;
+        if( smallest == index ) break;
+        uint8_t swap = this->queue[smallest];
+        this->queue[smallest] = this->queue[index];
+        this->queue[index] = swap;
+        index = smallest;
+    }
+}
+
+// Call every hook that is due, earliest first
+void SlowTicker::run_due_hooks(uint32_t now){
+    while( (int32_t)(this->hooks[this->queue.front()].next_tick - now) <= 0 ){
+        TickerHook& hook = this->hooks[this->queue.front()];
+        hook.next_tick += hook.interval;
+        // If we fell behind by more than an interval, don't try to catch up on the calls we missed
+        if( (int32_t)(hook.next_tick - now) <= 0 ){
+            hook.next_tick = now + hook.interval;
+        }
+        // the call may attach another hook, which can move the vector under the reference, so call a copy
+        Hook due = hook.hook;
+        this->sift_down(0);
+        due.call();
+    }
+}
+
+// The actual interrupt being called by the timer, this is where work is done
+void SlowTicker::tick(){
+    uint32_t start = this->timing ? get_cycle_count() : 0;
+    uint32_t now = LPC_TIM2->TC;
+
+    // Hooks asked to be synchronized, make them due right now
+    this->fire_pending(now);
+
+    // Call all hooks that are due, and program the timer for the next one
+    while( true ){
+        this->run_due_hooks(now);
+        uint32_t next = this->hooks[this->queue.front()].next_tick;
+        LPC_TIM2->MR0 = next;
+        now = LPC_TIM2->TC;
+        // If the next hook is already due ( or about to be ) the match could be missed, so go around again
+        if( (int32_t)(next - now) >= MINIMUM_MATCH_DISTANCE ) break;
+    }
+
+    // time elapsed since the last interrupt
+    uint32_t elapsed = now - this->last_tick;
+    this->last_tick = now;
 
     // if we're counting down a pause
     if (g4_ticks > 0)
     {
-        // deduct tick time from timeout
-        if (g4_ticks > interval)
-            g4_ticks -= interval;
+        // deduct elapsed time from timeout
+        if (g4_ticks > elapsed)
+            g4_ticks -= elapsed;
         else
             g4_ticks = 0;
     }
@@ -101,6 +226,38 @@ void SlowTicker::tick(){
     if (ispbtn.get() == 0)
         __debugbreak();
 
+    if (this->timing) {
+        uint32_t cycles = get_cycle_count() - start;
+        this->tick_timing.ticks++;
+        this->tick_timing.total_cycles += cycles;
+        if (cycles > this->tick_timing.worst_cycles)
+            this->tick_timing.worst_cycles = cycles;
+    }
+}
+
+// Starting clears what was counted before
+void SlowTicker::set_timing(bool enable){
+    if( enable ){
+        start_cycle_counter();
+        __disable_irq();
+        this->tick_timing = TickTiming();
+        __enable_irq();
+    }
+    this->timing = enable;
+}
+
+SlowTicker::TickTiming SlowTicker::get_timing(){
+    __disable_irq();
+    TickTiming t = this->tick_timing;
+    __enable_irq();
+    return t;
+}
+
+// Called once a second from the interrupt
+uint32_t SlowTicker::second_tick(uint32_t dummy){
+    // set a flag for idle event to pick up
+    flag_1s_flag++;
+    return 0;
 }
 
 bool SlowTicker::flag_1s(){
@@ -21,6 +21,13 @@ using namespace std;
 #include "system_LPC17xx.h" // for SystemCoreClock
 #include <math.h>
 
+// A hook called by the SlowTicker, and when it is next due
+struct TickerHook {
+    Hook     hook;
+    int      interval;
+    uint32_t next_tick; // timer count at which this hook is next due
+};
+
 class SlowTicker : public Module{
     public:
         SlowTicker();
@@ -30,40 +37,54 @@ class SlowTicker : public Module{
         void on_gcode_received(void*);
         void on_gcode_execute(void*);
 
-        void set_frequency( int frequency );
         void tick();
-        // For some reason this can't go in the .cpp, see :  http://mbed.org/forum/mbed/topic/2774/?page=1#comment-14221
-        // TODO replace this with std::function()
-        template<typename T> Hook* attach( uint32_t frequency, T *optr, uint32_t ( T::*fptr )( uint32_t ) ){
-            Hook* hook = new Hook();
-            hook->interval = int(floor((SystemCoreClock/4)/frequency));
-            hook->attach(optr, fptr);
-            hook->countdown = hook->interval;
-
-            // to avoid race conditions we must stop the interupts before updating this non thread safe vector
-            __disable_irq();
-            if( frequency > this->max_frequency ){
-                this->max_frequency = frequency;
-                this->set_frequency(frequency);
-            }
-            this->hooks.push_back(hook);
-            __enable_irq();
-            return hook;
+        void fire_now(int hook_id);
+        void detach(int hook_id);
+
+        // Returns an id for this hook, which can be used to detach it or call it right away
+        template<typename T> int attach( uint32_t frequency, T *optr, uint32_t ( T::*fptr )( uint32_t ) ){
+            TickerHook hook;
+            hook.interval = int(floor((SystemCoreClock/4)/frequency));
+            hook.hook.attach(optr, fptr);
+            return this->schedule(hook);
         }
 
+        // Cycles spent in tick(), only counted while timing is on, see the tickbench command
+        struct TickTiming {
+            uint32_t ticks;
+            uint32_t worst_cycles;
+            uint64_t total_cycles;
+        };
+        void set_timing(bool enable);
+        TickTiming get_timing();
+
     private:
         bool flag_1s();
-
-        vector<Hook*> hooks;
-        uint32_t max_frequency;
-        uint32_t interval;
+        uint32_t second_tick(uint32_t dummy);
+
+        int schedule(const TickerHook& hook);
+        void run_due_hooks(uint32_t now);
+        void sift_up(unsigned int index);
+        void sift_down(unsigned int index);
+        void fire_pending(uint32_t now);
+        bool due_before(uint8_t a, uint8_t b) const { return (int32_t)(hooks[a].next_tick - hooks[b].next_tick) < 0; }
+
+        // A hook keeps its index in this vector, so that is its id, but the vector may move as it grows. Detached slots are reused
+        vector<TickerHook> hooks;
+        // Binary min-heap of hook ids, the one due next is always queue[0]
+        vector<uint8_t> queue;
+        // Hooks that fire_now() asked for, one bit per id, so several can be pending at once
+        volatile uint32_t fire_now_pending;
+        uint32_t last_tick;
 
         uint32_t g4_ticks;
         bool     g4_pause;
 
+        volatile bool timing;
+        TickTiming tick_timing;
+
         Pin ispbtn;
 protected:
-    int flag_1s_count;
     volatile int flag_1s_flag;
 };
 
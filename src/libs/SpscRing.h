@@ -0,0 +1,234 @@
+#ifndef _SPSCRING_H
+#define _SPSCRING_H
+
+#include <cstddef>
+
+/*
+ * Single producer, single consumer ring
+ *
+ * One context (eg the main loop) only ever calls the producer side, and one other context (eg an ISR) only
+ * ever calls the consumer side, so neither needs to disable interrupts:
+ *   - head_i is only written by the producer and tail_i only by the consumer
+ *   - both indices run freely and are masked into the ring, so the length must be a power of two
+ *   - a barrier separates every slot access from the index update that hands the slot to the other side
+ *
+ * One slot is always left empty, so head_ref() can be prepared in place while the consumer still works
+ * on a full ring.
+ */
+
+template<class kind> class SpscRing {
+public:
+    SpscRing();
+    SpscRing(kind* buffer, unsigned int length);
+
+    /*
+     * producer side
+     */
+    bool  push(const kind&);        // false if the ring is full
+    kind* head_ref(void);           // the slot the next item goes into, may be filled in place
+    void  produce_head(void);       // publish the slot from head_ref(), waiting for room if the ring is full
+
+    /*
+     * consumer side
+     */
+    bool  pop(kind&);               // false if the ring is empty
+    kind* tail_ref(void);           // the oldest item, only valid if the ring is not empty
+    void  consume_tail(void);       // release the slot from tail_ref()
+    unsigned int span(kind** first); // how many items sit in one piece from the tail, eg for a DMA transfer
+    void  consume(unsigned int n);  // release n items from the tail
+    kind* peek(unsigned int offset); // the offset-th oldest item, or NULL if there are not that many
+    void  flush(void);              // drop everything queued
+
+    /*
+     * either side, the answer may be stale by the time it is used but errs on the safe side for the caller
+     */
+    unsigned int size(void);
+    unsigned int free(void);
+    unsigned int capacity(void) { return mask; };
+    bool is_empty(void) { return head_i == tail_i; };
+    bool is_full(void)  { return (head_i - tail_i) >= mask; };
+
+    // n rounded up or down to a length a ring can have
+    static unsigned int round_length(unsigned int n);
+    static unsigned int round_length_down(unsigned int n);
+
+    // give the ring its storage, only while neither side is using it
+    bool attach(kind* buffer, unsigned int length);
+
+protected:
+
+    // on the M3 this is a dmb, and it also stops the compiler moving slot accesses across the index update
+    static inline void barrier(void) { __sync_synchronize(); };
+
+    kind* ring;
+    unsigned int mask;
+
+    volatile unsigned int head_i;
+    volatile unsigned int tail_i;
+};
+
+template<class kind> SpscRing<kind>::SpscRing()
+{
+    ring = NULL;
+    mask = 0;
+    head_i = tail_i = 0;
+}
+
+template<class kind> SpscRing<kind>::SpscRing(kind* buffer, unsigned int length)
+{
+    ring = NULL;
+    mask = 0;
+    head_i = tail_i = 0;
+    attach(buffer, length);
+}
+
+template<class kind> bool SpscRing<kind>::attach(kind* buffer, unsigned int length)
+{
+    if ((buffer == NULL) || (length < 2) || (length & (length - 1)))
+        return false;
+
+    ring = buffer;
+    mask = length - 1;
+    head_i = tail_i = 0;
+    return true;
+}
+
+template<class kind> unsigned int SpscRing<kind>::round_length(unsigned int n)
+{
+    unsigned int length = 2;
+    while (length < n)
+        length <<= 1;
+    return length;
+}
+
+template<class kind> unsigned int SpscRing<kind>::round_length_down(unsigned int n)
+{
+    unsigned int length = 2;
+    while ((length << 1) <= n)
+        length <<= 1;
+    return length;
+}
+
+template<class kind> unsigned int SpscRing<kind>::size()
+{
+    return head_i - tail_i;
+}
+
+template<class kind> unsigned int SpscRing<kind>::free()
+{
+    return mask - (head_i - tail_i);
+}
+
+/*
+ * producer side
+ */
+
+template<class kind> bool SpscRing<kind>::push(const kind& object)
+{
+    unsigned int h = head_i;
+    if ((h - tail_i) >= mask)
+        return false;
+
+    ring[h & mask] = object;
+    barrier();
+    head_i = h + 1;
+    return true;
+}
+
+template<class kind> kind* SpscRing<kind>::head_ref()
+{
+    return &ring[head_i & mask];
+}
+
+template<class kind> void SpscRing<kind>::produce_head()
+{
+    while (is_full());
+    barrier();
+    head_i = head_i + 1;
+}
+
+/*
+ * consumer side
+ */
+
+template<class kind> bool SpscRing<kind>::pop(kind& object)
+{
+    unsigned int t = tail_i;
+    if (t == head_i)
+        return false;
+
+    barrier();
+    object = ring[t & mask];
+    barrier();
+    tail_i = t + 1;
+    return true;
+}
+
+template<class kind> kind* SpscRing<kind>::tail_ref()
+{
+    barrier();
+    return &ring[tail_i & mask];
+}
+
+template<class kind> void SpscRing<kind>::consume_tail()
+{
+    unsigned int t = tail_i;
+    if (t == head_i)
+        return;
+
+    barrier();
+    tail_i = t + 1;
+}
+
+template<class kind> unsigned int SpscRing<kind>::span(kind** first)
+{
+    unsigned int t = tail_i;
+    unsigned int n = head_i - t;
+    unsigned int to_end = (mask + 1) - (t & mask);
+
+    barrier();
+    *first = &ring[t & mask];
+    return (n < to_end) ? n : to_end;
+}
+
+template<class kind> void SpscRing<kind>::consume(unsigned int n)
+{
+    unsigned int t = tail_i;
+    if (n > head_i - t)
+        n = head_i - t;
+
+    barrier();
+    tail_i = t + n;
+}
+
+template<class kind> kind* SpscRing<kind>::peek(unsigned int offset)
+{
+    unsigned int t = tail_i;
+    if (offset >= (head_i - t))
+        return NULL;
+
+    barrier();
+    return &ring[(t + offset) & mask];
+}
+
+template<class kind> void SpscRing<kind>::flush()
+{
+    barrier();
+    tail_i = head_i;
+}
+
+/*
+ * a ring that carries its own storage, for fixed size buffers that live inside an object
+ */
+
+template<class kind, unsigned int length> class SpscBuffer : public SpscRing<kind> {
+    static_assert(length >= 2 && (length & (length - 1)) == 0, "SpscBuffer length must be a power of two");
+
+public:
+    SpscBuffer() : SpscRing<kind>(storage, length) {};
+
+private:
+    kind storage[length];
+};
+
+#endif /* _SPSCRING_H */
@@ -24,8 +24,8 @@ StepperMotor::StepperMotor(){
     this->steps_to_move = 0;
     this->remove_from_active_list_next_reset = false;
     this->is_move_finished = false;
-    this->signal_step = false;
-    this->step_signal_hook = new Hook();
+    this->signal_count = 0;
+    this->next_signal = 0;
 
     steps_per_mm         = 1.0F;
     max_rate             = 50.0F;
@@ -43,8 +43,8 @@ StepperMotor::StepperMotor(Pin& step, Pin& dir, Pin& en) : step_pin(step), dir_p
     this->steps_to_move = 0;
     this->remove_from_active_list_next_reset = false;
     this->is_move_finished = false;
-    this->signal_step = false;
-    this->step_signal_hook = new Hook();
+    this->signal_count = 0;
+    this->next_signal = 0;
 
     enable(false);
     set_high_on_debug(en.port_number, en.pin);
@@ -71,8 +71,9 @@ void StepperMotor::step(){
     this->stepped++;
 
     // Do we need to signal this step
-    if( this->stepped == this->signal_step_number && this->signal_step ){
-        this->step_signal_hook->call();
+    while( this->next_signal < this->signal_count && this->signals[this->next_signal].step == this->stepped ){
+        StepSignal& signal = this->signals[this->next_signal++];
+        signal.hook.call(signal.argument);
     }
 
     // Is this move finished ?
@@ -94,7 +95,7 @@ void StepperMotor::signal_move_finished(){
             this->steps_to_move = 0;
 
             // signal it to whatever cares 41t 411t
-            this->end_hook->call();
+            this->end_hook.call();
 
             // We only need to do this if we were not instructed to move
             if( this->moving == false ){
@@ -133,7 +134,8 @@ void StepperMotor::move( bool direction, unsigned int steps ){
     this->stepped = 0;
 
     // Do not signal steps until we get instructed to
-    this->signal_step = false;
+    this->signal_count = 0;
+    this->next_signal = 0;
 
     // Starting now we are moving
     if( steps > 0 ){
@@ -145,6 +147,27 @@ void StepperMotor::move( bool direction, unsigned int steps ){
 
 }
 
+// Call a hook when the given step of the current move is reached, steps past the end of the move are signaled on the last step
+// Must be called after move(), from the step interrupt or from on_block_begin
+bool StepperMotor::attach_signal_step(uint32_t step, const Hook& hook, uint32_t argument){
+    if( this->signal_count >= MAX_STEP_SIGNALS ){ return false; }
+
+    if( step > this->steps_to_move ){ step = this->steps_to_move; }
+    if( step <= this->stepped ){ step = this->stepped + 1; }
+
+    // Keep the list sorted by step so step() only ever has to look at the next one
+    int index = this->signal_count;
+    while( index > this->next_signal && this->signals[index - 1].step > step ){
+        this->signals[index] = this->signals[index - 1];
+        index--;
+    }
+    this->signals[index].step = step;
+    this->signals[index].hook = hook;
+    this->signals[index].argument = argument;
+    this->signal_count++;
+    return true;
+}
+
 // Set the speed at which this steper moves
 void StepperMotor::set_speed( float speed ){
 
@@ -12,7 +12,9 @@
 #include "Pin.h"
 
 class StepTicker;
-class Hook;
+
+// How many step signals can be attached to a single move
+#define MAX_STEP_SIGNALS 8
 
 class StepperMotor {
     public:
@@ -54,16 +56,15 @@ class StepperMotor {
         uint32_t get_stepped() const { return stepped; }
 
         template<typename T> void attach( T *optr, uint32_t ( T::*fptr )( uint32_t ) ){
-            Hook* hook = new Hook();
-            hook->attach(optr, fptr);
-            this->end_hook = hook;
+            this->end_hook.attach(optr, fptr);
         }
 
-        template<typename T> void attach_signal_step(uint32_t step, T *optr, uint32_t ( T::*fptr )( uint32_t ) ){
-            this->step_signal_hook->attach(optr, fptr);
-            this->signal_step_number = step;
-            this->signal_step = true;
+        template<typename T> bool attach_signal_step(uint32_t step, T *optr, uint32_t ( T::*fptr )( uint32_t ) ){
+            Hook hook;
+            hook.attach(optr, fptr);
+            return this->attach_signal_step(step, hook, 0);
         }
+        bool attach_signal_step(uint32_t step, const Hook& hook, uint32_t argument);
 
         friend class StepTicker;
         friend class Stepper;
@@ -71,11 +72,17 @@ class StepperMotor {
         friend class Robot;
 
     private:
-        Hook* end_hook;
-        Hook* step_signal_hook;
+        Hook end_hook;
 
-        bool signal_step;
-        uint32_t signal_step_number;
+        // Hooks to call when a given step of the current move is reached, sorted by step
+        struct StepSignal {
+            uint32_t step;
+            Hook     hook;
+            uint32_t argument;
+        };
+        StepSignal signals[MAX_STEP_SIGNALS];
+        uint8_t signal_count;
+        uint8_t next_signal;
 
         StepTicker* step_ticker;
         Pin step_pin;
@@ -115,6 +115,17 @@
  * +------+---------+---------+- -  - -+---------+-----------+----------+
  * | 0xFE | data[0] | data[1] |        | data[n] | crc[15:8] | crc[7:0] |
  * +------+---------+---------+- -  - -+---------+-----------+----------+
+ *
+ * Multiple Block Read and Write
+ * -----------------------------
+ *
+ * CMD18 streams blocks, each framed as above, until CMD12 stops it. The
+ * byte after CMD12 is a stuff byte, then comes an R1b response.
+ *
+ * CMD25 takes blocks starting with 0xFC instead of 0xFE, each answered by
+ * a data response token and a busy signal. A 0xFD token ends the stream.
+ * ACMD23 beforehand tells the card how many blocks are coming, so it can
+ * erase them in one go.
  */
 
 #include <stdio.h>
@@ -125,6 +136,8 @@
 static const uint8_t OXFF = 0xFF;
 
 #define SD_COMMAND_TIMEOUT 5000
+// in bytes clocked, at 10MHz this is about 250ms which covers the worst case read access and write busy times
+#define SD_DATA_TIMEOUT    300000
 
 SDCard::SDCard(PinName mosi, PinName miso, PinName sclk, PinName cs) :
   _spi(mosi, miso, sclk), _cs(cs) {
@@ -199,8 +212,8 @@ SDCard::SDCard(PinName mosi, PinName miso, PinName sclk, PinName cs) :
 #define BLOCK2ADDR(block)   (((cardtype == SDCARD_V1) || (cardtype == SDCARD_V2))?(block << 9):((cardtype == SDCARD_V2HC)?(block):0))
 
 SDCard::CARD_TYPE SDCard::initialise_card() {
-    // Set to 25kHz for initialisation, and clock card with cs = 1
-    _spi.frequency(25000);
+    // Set to 100kHz for initialisation, and clock card with cs = 1
+    _spi.frequency(100000);
     _cs = 1;
 
     for(int i=0; i<24; i++) {
@@ -277,7 +290,7 @@ int SDCard::disk_initialize()
         return 1;
     }
 
-    _spi.frequency(2500000); // Set to 2.5MHz for data transfer
+    _spi.frequency(10000000); // Set to 10MHz for data transfer
 
     busyflag = false;
 
@@ -328,6 +341,98 @@ int SDCard::disk_read(char *buffer, uint32_t block_number)
     return 0;
 }
 
+int SDCard::disk_read_blocks(char *buffer, uint32_t block_number, uint32_t count)
+{
+    // the card is part way through another transfer, fail rather than report a transfer that never happened
+    if (busyflag)
+        return 1;
+
+    if (count == 1)
+        return disk_read(buffer, block_number);
+
+    if (cardtype == SDCARD_FAIL)
+        return -1;
+
+    busyflag = true;
+
+    // set read address for multiple blocks (CMD18)
+    if(_cmd(SDCMD_READ_MULTIPLE_BLOCK, BLOCK2ADDR(block_number)) != 0) {
+        busyflag = false;
+        return 1;
+    }
+
+    _cs = 0;
+
+    int r = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (_read_block(buffer, 512)) {
+            r = 1;
+            break;
+        }
+        buffer += 512;
+    }
+
+    if (_stop_read())
+        r = 1;
+
+    _cs = 1;
+    _spi.write(0xFF);
+
+    busyflag = false;
+
+    return r;
+}
+
+int SDCard::disk_write_blocks(const char *buffer, uint32_t block_number, uint32_t count)
+{
+    // the card is part way through another transfer, fail rather than report a transfer that never happened
+    if (busyflag)
+        return 1;
+
+    if (count == 1)
+        return disk_write(buffer, block_number);
+
+    if (cardtype == SDCARD_FAIL)
+        return -1;
+
+    busyflag = true;
+
+    // pre-erase hint (ACMD23), a card that ignores it still takes the write
+    _cmd(SDCMD_APP_CMD, 0);
+    _cmd(SD_ACMD_SET_WR_BLK_ERASE_COUNT, count);
+
+    // set write address for multiple blocks (CMD25)
+    if(_cmd(SDCMD_WRITE_MULTIPLE_BLOCK, BLOCK2ADDR(block_number)) != 0) {
+        busyflag = false;
+        return 1;
+    }
+
+    _cs = 0;
+    _spi.write(0xFF);
+
+    int r = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (_write_block(0xFC, buffer, 512)) {
+            r = 1;
+            break;
+        }
+        buffer += 512;
+    }
+
+    // stop token, then the card is busy while it programs the last block
+    _spi.write(0xFD);
+    _spi.write(0xFF);
+    if (_wait_ready())
+        r = 1;
+
+    _cs = 1;
+    _spi.write(0xFF);
+
+    busyflag = false;
+
+    return r;
+}
+
 int SDCard::disk_status() { return (_sectors > 0)?0:1; }
 int SDCard::disk_sync() {
     // TODO: wait for DMA, wait for card not busy
@@ -336,7 +441,7 @@ int SDCard::disk_sync() {
 uint32_t SDCard::disk_sectors() { return _sectors; }
 uint64_t SDCard::disk_size() { return ((uint64_t) _sectors) << 9; }
 uint32_t SDCard::disk_blocksize() { return (1<<9); }
-bool SDCard::disk_canDMA() { return false; }
+bool SDCard::disk_canDMA() { return _spi.can_DMA(); }
 
 SDCard::CARD_TYPE SDCard::card_type()
 {
@@ -468,9 +573,7 @@ int SDCard::_read(char *buffer, int length) {
 //     iprintf("Got start byte, reading data\n");
 
     // read data
-    for(int i=0; i<length; i++) {
-        buffer[i] = _spi.write(0xFF);
-    }
+    _spi.transfer(NULL, (uint8_t *)buffer, length);
     _spi.write(0xFF); // checksum
     _spi.write(0xFF);
 
@@ -486,9 +589,7 @@ int SDCard::_write(const char *buffer, int length) {
     _spi.write(0xFE);
 
     // write the data
-    for(int i=0; i<length; i++) {
-        _spi.write(buffer[i]);
-    }
+    _spi.transfer((const uint8_t *)buffer, NULL, length);
 
     // write the checksum
     _spi.write(0xFF);
@@ -509,6 +610,79 @@ int SDCard::_write(const char *buffer, int length) {
     return 0;
 }
 
+int SDCard::_read_block(char *buffer, int length) {
+    // wait for the start byte, anything else but 0xFF is an error token
+    int token = 0xFF;
+    for(int i=0; i<SD_DATA_TIMEOUT && token == 0xFF; i++) {
+        token = _spi.write(0xFF);
+    }
+    if(token != 0xFE) {
+        return 1;
+    }
+
+    if(_spi.transfer(NULL, (uint8_t *)buffer, length)) {
+        return 1;
+    }
+    _spi.write(0xFF); // checksum
+    _spi.write(0xFF);
+    return 0;
+}
+
+int SDCard::_write_block(uint8_t token, const char *buffer, int length) {
+    _spi.write(token);
+
+    if(_spi.transfer((const uint8_t *)buffer, NULL, length)) {
+        return 1;
+    }
+
+    // write the checksum
+    _spi.write(0xFF);
+    _spi.write(0xFF);
+
+    // check the repsonse token
+    if((_spi.write(0xFF) & 0x1F) != 0x05) {
+        return 1;
+    }
+
+    return _wait_ready();
+}
+
+int SDCard::_wait_ready() {
+    // the card holds miso low while it is busy
+    for(int i=0; i<SD_DATA_TIMEOUT; i++) {
+        if(_spi.write(0xFF) == 0xFF) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int SDCard::_stop_read() {
+    // CMD12, which may be clocked in while the card is already sending the next block
+    _spi.write(0x40 | SDCMD_STOP_TRANSMISSION);
+    _spi.write(0x00);
+    _spi.write(0x00);
+    _spi.write(0x00);
+    _spi.write(0x00);
+    _spi.write(0x95);
+
+    // skip the stuff byte
+    _spi.write(0xFF);
+
+    // wait for the repsonse (response[7] == 0)
+    for(int i=0; i<SD_COMMAND_TIMEOUT; i++) {
+        int response = _spi.write(0xFF);
+        if(!(response & 0x80)) {
+            if(response != 0) {
+                _wait_ready();
+                return 1;
+            }
+            return _wait_ready();
+        }
+    }
+    return 1; // timeout
+}
+
 static int ext_bits(char *data, int msb, int lsb) {
     int bits = 0;
     int size = 1 + msb - lsb;
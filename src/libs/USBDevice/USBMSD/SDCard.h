@@ -70,6 +70,8 @@ public:
     virtual int disk_initialize();
     virtual int disk_write(const char *buffer, uint32_t block_number);
     virtual int disk_read(char *buffer, uint32_t block_number);
+    virtual int disk_read_blocks(char *buffer, uint32_t block_number, uint32_t count);
+    virtual int disk_write_blocks(const char *buffer, uint32_t block_number, uint32_t count);
     virtual int disk_status();
     virtual int disk_sync();
     virtual uint32_t disk_sectors();
@@ -96,6 +98,12 @@ protected:
     int _read(char *buffer, int length);
     int _write(const char *buffer, int length);
 
+    // multiple block transfers keep cs low across the blocks, these do not touch it
+    int _read_block(char *buffer, int length);
+    int _write_block(uint8_t token, const char *buffer, int length);
+    int _wait_ready();
+    int _stop_read();
+
     uint32_t _sd_sectors();
     uint32_t _sectors;
 
@@ -26,14 +26,25 @@
 #include "descriptor_msc.h"
 
 #include "Kernel.h"
+#include "Config.h"
+#include "ConfigValue.h"
+#include "checksumm.h"
+#include "SerialMessage.h"
+#include "StreamOutput.h"
+#include "utils.h"
+#include "us_ticker_api.h"
 
 #include "platform_memory.h"
+#include "diskio.h"
+#include "DirectoryIndex.h"
 
 #define DISK_OK         0x00
 #define NO_INIT         0x01
 #define NO_DISK         0x02
 #define WRITE_PROTECT   0x04
 
+#define msd_buffer_blocks_checksum CHECKSUM("msd_buffer_blocks")
+
 #define CBW_Signature   0x43425355
 #define CSW_Signature   0x53425355
 
@@ -84,6 +95,16 @@ USBMSD::USBMSD(USB *u, MSD_Disk *d) {
     this->usb = u;
     this->disk = d;
 
+    buffers[0].data = buffers[1].data = NULL;
+    buffers[0].state = buffers[1].state = BUFFER_FREE;
+    buffer_blocks = 4;
+    usb_buffer = 0;
+    offset = 0;
+    next_lba = blocks_left = 0;
+    writing = write_done = write_failed = ep_waiting = false;
+    generation = 0;
+    bytes_read = bytes_written = us_reading = us_writing = disk_commands = 0;
+
     usbdesc_interface i = {
         DL_INTERFACE,           // bLength
         DT_INTERFACE,           // bDescType
@@ -191,9 +212,14 @@ bool USBMSD::connect()
     BlockSize = disk->disk_blocksize();
 
     if ((BlockCount > 0) && (BlockSize != 0)) {
-        page = (uint8_t*) AHB0.alloc(BlockSize);
-        if (page == NULL)
+        // both buffers in one piece, as many sectors as AHB0 can spare down to one each
+        uint8_t *data;
+        while ((data = (uint8_t*) AHB0.alloc(2 * buffer_blocks * BlockSize)) == NULL && buffer_blocks > 1)
+            buffer_blocks >>= 1;
+        if (data == NULL)
             return false;
+        buffers[0].data = data;
+        buffers[1].data = data + (buffer_blocks * BlockSize);
     } else {
         return false;
     }
@@ -204,6 +230,13 @@ bool USBMSD::connect()
 
 void USBMSD::reset() {
     stage = READ_CBW;
+
+    // drop the transfer, on_idle finishes a disk command it may be in the middle of but forgets about it
+    generation++;
+    buffers[0].state = buffers[1].state = BUFFER_FREE;
+    write_done = false;
+    ep_waiting = false;
+
     usb->endpointSetInterrupt(MSC_BulkOut.bEndpointAddress, true);
     usb->endpointSetInterrupt(MSC_BulkIn.bEndpointAddress, false);
 }
@@ -214,6 +247,13 @@ void USBMSD::reset() {
 bool USBMSD::USBEvent_EPOut(uint8_t bEP, uint8_t bEPStatus) {
     uint32_t size = 0;
 //     uint8_t buf[MAX_PACKET_SIZE_EPBULK];
+
+    // a write waits for on_idle to free a buffer, leaving the packet in the endpoint NAKs the host meanwhile
+    if ((stage == PROCESS_CBW) && ((cbw.CB[0] == WRITE10) || (cbw.CB[0] == WRITE12)) && !claimBuffer()) {
+        ep_waiting = true;
+        return false;
+    }
+
     usb->readEP(MSC_BulkOut.bEndpointAddress, buffer, &size, MAX_PACKET_SIZE_EPBULK);
     iprintf("MSD:EPOut:Read %lu\n", size);
     switch (stage) {
@@ -269,8 +309,7 @@ bool USBMSD::USBEvent_EPIn(uint8_t bEP, uint8_t bEPStatus) {
             switch (cbw.CB[0]) {
                 case READ10:
                 case READ12:
-                    memoryRead();
-                    gotMoreData = true;
+                    gotMoreData = memoryRead();
                     break;
             }
             break;
@@ -302,37 +341,28 @@ bool USBMSD::USBEvent_EPIn(uint8_t bEP, uint8_t bEPStatus) {
 }
 
 void USBMSD::memoryWrite (uint8_t * buf, uint16_t size) {
+    msd_buffer& b = buffers[usb_buffer];
+    uint32_t room = (b.blocks * BlockSize) - offset;
 
-    if (lba > BlockCount) {
-        size = (BlockCount - lba) * BlockSize + addr_in_block;
-        stage = ERROR;
-        usb->stallEndpoint(MSC_BulkOut.bEndpointAddress);
-    }
-
-    // we fill an array in RAM of 1 block before writing it in memory
-    for (int i = 0; i < size; i++)
-        page[addr_in_block + i] = buf[i];
+    if (size > room)
+        size = room;
 
-    // if the array is filled, write it in memory
-    if ((addr_in_block + size) >= BlockSize) {
-        if (!(disk->disk_status() & WRITE_PROTECT)) {
-            disk->disk_write((const char *)page, lba);
-        }
-    }
+    memcpy(&b.data[offset], buf, size);
 
-    addr_in_block += size;
+    offset += size;
     length -= size;
     csw.DataResidue -= size;
-    if (addr_in_block >= BlockSize)
-    {
-        addr_in_block = 0;
-        lba++;
-    }
 
-    if ((!length) || (stage != PROCESS_CBW)) {
-        csw.Status = (stage == ERROR) ? CSW_FAILED : CSW_PASSED;
-        sendCSW();
+    // full, which the last one of the transfer also is, so it goes to the disk
+    if (offset >= (b.blocks * BlockSize)) {
+        offset = 0;
+        b.state = BUFFER_DISK;
+        usb_buffer ^= 1;
     }
+
+    // the CSW is sent by on_idle, once the disk has all of it
+    if (!length)
+        write_done = true;
 }
 
 void USBMSD::memoryVerify (uint8_t * buf, uint16_t size) {
@@ -344,7 +374,8 @@ void USBMSD::memoryVerify (uint8_t * buf, uint16_t size) {
         usb->stallEndpoint(MSC_BulkOut.bEndpointAddress);
     }
 
-    // beginning of a new block -> load a whole block in RAM
+    // beginning of a new block -> load a whole block in RAM, verify is rare enough to do it here
+    uint8_t *page = buffers[0].data;
     if (addr_in_block == 0)
         disk->disk_read((char *)page, lba);
 
@@ -544,6 +575,7 @@ void USBMSD::CBWDecode(uint8_t * buf, uint16_t size) {
                         if (infoTransfer()) {
                             if ((cbw.Flags & 0x80)) {
                                 iprintf("MSD: Read %lu blocks from LBA %lu\n", blocks, lba);
+                                startTransfer(false);
                                 stage = PROCESS_CBW;
 //                                 memoryRead();
                                 usb->endpointSetInterrupt(MSC_BulkIn.bEndpointAddress, true);
@@ -559,6 +591,7 @@ void USBMSD::CBWDecode(uint8_t * buf, uint16_t size) {
                         if (infoTransfer()) {
                             if (!(cbw.Flags & 0x80)) {
                                 iprintf("MSD: Write %lu blocks from LBA %lu\n", blocks, lba);
+                                startTransfer(true);
                                 stage = PROCESS_CBW;
                             } else {
                                 usb->stallEndpoint(MSC_BulkIn.bEndpointAddress);
@@ -636,39 +669,41 @@ void USBMSD::testUnitReady (void) {
     sendCSW();
 }
 
-void USBMSD::memoryRead (void) {
+bool USBMSD::memoryRead (void) {
+    msd_buffer& b = buffers[usb_buffer];
     uint32_t n;
 
-    n = (length > MAX_PACKET_SIZE_EPBULK) ? MAX_PACKET_SIZE_EPBULK : length;
-
-    if (lba > BlockCount) {
-        iprintf("MSD:Attemt to read beyond end of disk! Read LBA %lu > Disk LBAs %lu\n", lba, BlockCount);
-        n = (BlockCount - lba) * BlockSize + addr_in_block;
-        stage = ERROR;
+    // on_idle has not read it yet, the endpoint interrupt goes off until it has
+    if (b.state != BUFFER_USB) {
+        ep_waiting = true;
+        return false;
     }
 
-    // we read an entire block
-    if (addr_in_block == 0)
-    {
-        iprintf("MSD:LBA %lu:", lba);
-        disk->disk_read((char *)page, lba);
+    if (b.failed) {
+        iprintf("MSD:Read of LBA %lu failed\n", b.lba);
+        csw.Status = CSW_FAILED;
+        stage = ERROR;
+        usb->endpointSetInterrupt(MSC_BulkIn.bEndpointAddress, true);
+        return true;
     }
 
-    iprintf(" %u", addr_in_block / MAX_PACKET_SIZE_EPBULK);
+    n = (length > MAX_PACKET_SIZE_EPBULK) ? MAX_PACKET_SIZE_EPBULK : length;
 
     // write data which are in RAM
-    usb->writeNB(MSC_BulkIn.bEndpointAddress, &page[addr_in_block], n, MAX_PACKET_SIZE_EPBULK);
+    usb->writeNB(MSC_BulkIn.bEndpointAddress, &b.data[offset], n, MAX_PACKET_SIZE_EPBULK);
 
-    addr_in_block += n;
+    offset += n;
 
     length -= n;
     csw.DataResidue -= n;
 
-    if (addr_in_block >= BlockSize)
-    {
-        iprintf("\n");
-        addr_in_block = 0;
-        lba++;
+    // drained, so on_idle can read ahead into it while the other one goes to the host
+    if (offset >= (b.blocks * BlockSize)) {
+        offset = 0;
+        b.state = BUFFER_FREE;
+        if (blocks_left > 0)
+            assignBuffer(b);
+        usb_buffer ^= 1;
     }
 
     if ( !length || (stage != PROCESS_CBW)) {
@@ -676,6 +711,51 @@ void USBMSD::memoryRead (void) {
         stage = (stage == PROCESS_CBW) ? SEND_CSW : stage;
     }
     usb->endpointSetInterrupt(MSC_BulkIn.bEndpointAddress, true);
+    return true;
+}
+
+// Called in ISR context once a READ or WRITE command is accepted, lba and blocks are set by infoTransfer
+void USBMSD::startTransfer(bool write) {
+    writing = write;
+    write_done = false;
+    write_failed = false;
+    ep_waiting = false;
+
+    next_lba = lba;
+    blocks_left = blocks;
+    offset = 0;
+    usb_buffer = 0;
+    buffers[0].state = buffers[1].state = BUFFER_FREE;
+
+    // a read starts both buffers filling straight away, a write claims them as the host sends
+    if (!write) {
+        assignBuffer(buffers[0]);
+        if (blocks_left > 0)
+            assignBuffer(buffers[1]);
+    }
+}
+
+// gives a free buffer the next run of sectors
+void USBMSD::assignBuffer(msd_buffer& b) {
+    uint32_t n = (blocks_left > buffer_blocks) ? buffer_blocks : blocks_left;
+
+    b.lba = next_lba;
+    b.blocks = n;
+    b.failed = false;
+    next_lba += n;
+    blocks_left -= n;
+
+    b.state = writing ? BUFFER_USB : BUFFER_DISK;
+}
+
+// true if the ISR has a buffer to put the host's data in
+bool USBMSD::claimBuffer(void) {
+    msd_buffer& b = buffers[usb_buffer];
+
+    if ((b.state == BUFFER_FREE) && (blocks_left > 0))
+        assignBuffer(b);
+
+    return b.state == BUFFER_USB;
 }
 
 bool USBMSD::infoTransfer (void) {
@@ -734,7 +814,100 @@ bool USBMSD::infoTransfer (void) {
 
 void USBMSD::on_module_loaded()
 {
-    connect();
+    // sectors in each of the two buffers, a bigger buffer means fewer and longer disk commands
+    int n = THEKERNEL->config->value(msd_buffer_blocks_checksum)->by_default(4)->as_int();
+    buffer_blocks = (n < 1) ? 1 : (n > 32) ? 32 : n;
+
+    if (connect()) {
+        this->register_for_event(ON_IDLE);
+        this->register_for_event(ON_CONSOLE_LINE_RECEIVED);
+    }
+}
+
+// All the disk access for READ and WRITE happens here, where it can not cut into FatFs
+void USBMSD::on_idle(void*)
+{
+    // at most both buffers each time round, in sector order which is also the order the ISR handed them over
+    for (int i = 0; i < 2; i++) {
+        msd_buffer* b = NULL;
+        for (int j = 0; j < 2; j++) {
+            if ((buffers[j].state == BUFFER_DISK) && ((b == NULL) || (buffers[j].lba < b->lba)))
+                b = &buffers[j];
+        }
+        if (b == NULL)
+            break;
+
+        uint32_t gen = generation;
+        bool write = writing;
+        uint32_t bytes = b->blocks * BlockSize;
+        uint32_t start = us_ticker_read();
+        int r = 0;
+
+        if (write) {
+            if (!(disk->disk_status() & WRITE_PROTECT)) {
+                r = disk->disk_write_blocks((const char *)b->data, b->lba, b->blocks);
+                // the host writes behind FatFs' back
+                disk_cache_invalidate(b->lba, b->blocks);
+                DirectoryIndex::invalidate();
+            }
+            us_writing += us_ticker_read() - start;
+            bytes_written += bytes;
+        } else {
+            r = disk->disk_read_blocks((char *)b->data, b->lba, b->blocks);
+            us_reading += us_ticker_read() - start;
+            bytes_read += bytes;
+        }
+        disk_commands++;
+
+        // a reset came in meanwhile, the buffer may already belong to the next transfer
+        if (gen != generation)
+            continue;
+
+        if (write) {
+            if (r)
+                write_failed = true;
+            b->state = BUFFER_FREE;
+        } else {
+            b->failed = (r != 0);
+            b->state = BUFFER_USB;
+        }
+    }
+
+    // everything the host sent is on the disk, the ISR sends the CSW from the IN endpoint
+    if (write_done && (buffers[0].state != BUFFER_DISK) && (buffers[1].state != BUFFER_DISK)) {
+        write_done = false;
+        csw.Status = write_failed ? CSW_FAILED : CSW_PASSED;
+        stage = SEND_CSW;
+        usb->endpointSetInterrupt(MSC_BulkIn.bEndpointAddress, true);
+    }
+
+    // if the ISR is still short of a buffer it just turns its interrupt off again
+    if (ep_waiting) {
+        ep_waiting = false;
+        usb->endpointSetInterrupt(writing ? MSC_BulkOut.bEndpointAddress : MSC_BulkIn.bEndpointAddress, true);
+    }
+}
+
+void USBMSD::on_console_line_received(void* argument)
+{
+    SerialMessage new_message = *static_cast<SerialMessage *>(argument);
+
+    // ignore comments and blank lines and if this is a G code then also ignore it
+    char first_char = new_message.message[0];
+    if (strchr(";( \n\rGMTN", first_char) != NULL) return;
+
+    string possible_command = new_message.message;
+    if (shift_parameter(possible_command) != "msd") return;
+
+    if (shift_parameter(possible_command) == "reset") {
+        bytes_read = bytes_written = us_reading = us_writing = disk_commands = 0;
+    }
+
+    // rates are for the time the disk took, the USB side runs alongside
+    uint32_t read_rate = us_reading ? (uint32_t)(((uint64_t)bytes_read * 1000000 / us_reading) / 1024) : 0;
+    uint32_t write_rate = us_writing ? (uint32_t)(((uint64_t)bytes_written * 1000000 / us_writing) / 1024) : 0;
+    new_message.stream->printf("MSD: %u sectors per buffer, read %lu KB at %lu KB/s, wrote %lu KB at %lu KB/s, %lu disk commands\r\n",
+                               buffer_blocks, bytes_read / 1024, read_rate, bytes_written / 1024, write_rate, disk_commands);
 }
 
 bool USBMSD::USBEvent_busReset(void)
@@ -90,6 +90,8 @@ public:
     bool USBEvent_suspendStateChanged(bool suspended);
 
     virtual void on_module_loaded(void);
+    virtual void on_idle(void*);
+    virtual void on_console_line_received(void*);
 
     // USB descriptors
     usbdesc_interface MSC_Interface;
@@ -158,8 +160,44 @@ private:
     // memory OK (after a memoryVerify)
     bool memOK;
 
-    // cache in RAM before writing in memory. Useful also to read a block.
-    uint8_t * page;
+    /*
+     * Sectors move between the host and the disk through two buffers of several sectors each. The USB ISR fills
+     * or drains one while on_idle reads or writes the other with a single multi-block disk command, so the
+     * card is never touched from the ISR and a transfer costs one command per buffer rather than per sector.
+     * Whoever owns a buffer is the only one to touch it, and the endpoint NAKs the host while the ISR waits.
+     */
+    enum BufferState {
+        BUFFER_FREE,  // nobody's, the ISR assigns it the next run of sectors
+        BUFFER_USB,   // the ISR is filling it from the host, or draining it to the host
+        BUFFER_DISK,  // on_idle has to write it to, or read it from, the disk
+    };
+
+    struct msd_buffer {
+        uint8_t* data;
+        uint32_t lba;
+        uint16_t blocks;
+        bool failed;
+        volatile uint8_t state;
+    };
+
+    msd_buffer buffers[2];
+    uint16_t buffer_blocks;     // sectors each buffer holds
+    uint8_t usb_buffer;         // the one the ISR works on next
+    uint32_t offset;            // bytes into the ISR's buffer
+    uint32_t next_lba;          // first sector not yet given to a buffer
+    uint32_t blocks_left;       // sectors not yet given to a buffer
+    volatile bool writing;      // the transfer goes to the disk
+    volatile bool write_done;   // the host has sent everything, the CSW waits for the disk
+    volatile bool write_failed;
+    volatile bool ep_waiting;   // an endpoint interrupt was turned off to wait for a buffer
+    volatile uint32_t generation; // bumped by a reset, so on_idle drops what it was doing
+
+    // throughput, in bytes moved and microseconds the disk took
+    uint32_t bytes_read;
+    uint32_t bytes_written;
+    uint32_t us_reading;
+    uint32_t us_writing;
+    uint32_t disk_commands;
 
     // USB packet buffer
     uint8_t buffer[MAX_PACKET_SIZE_EPBULK];
@@ -175,12 +213,15 @@ private:
     bool readFormatCapacity();
     bool readCapacity (void);
     bool infoTransfer (void);
-    void memoryRead (void);
+    bool memoryRead (void);
     bool modeSense6 (void);
     void testUnitReady (void);
     bool requestSense (void);
     void memoryVerify (uint8_t * buf, uint16_t size);
     void memoryWrite (uint8_t * buf, uint16_t size);
+    void startTransfer(bool write);
+    void assignBuffer(msd_buffer& b);
+    bool claimBuffer(void);
     void reset();
     void fail();
 };
@@ -20,27 +20,91 @@
 #include <cstdio>
 
 #include "USBSerial.h"
+#include "platform_memory.h"
 
 #include "libs/Kernel.h"
 #include "libs/SerialMessage.h"
 #include "StreamOutputPool.h"
+#include "checksumm.h"
+#include "Config.h"
+#include "ConfigValue.h"
+
+#include <string.h>
+
+#define usb_serial_checksum        CHECKSUM("usb_serial")
+#define rx_buffer_size_checksum    CHECKSUM("rx_buffer_size")
+#define tx_buffer_size_checksum    CHECKSUM("tx_buffer_size")
 
 // extern void setled(int, bool);
 #define setled(a, b) do {} while (0)
 
 #define iprintf(...) do { } while (0)
 
-USBSerial::USBSerial(USB *u): USBCDC(u), rxbuf(256 + 8), txbuf(128 + 8)
+// the buffers are allocated once the config is loaded, until then they hold nothing and the endpoint NAKs
+USBSerial::USBSerial(USB *u): USBCDC(u)
 {
     usb = u;
-    nl_in_rx = 0;
+    nl_received = nl_consumed = 0;
     attach = attached = false;
     flush_to_nl = false;
+    flush_rx = false;
+    flush_rx_count = 0;
+    rx_stalled = false;
+}
+
+// sizes are rounded up to a power of two, and halved until they fit in AHB0
+// if AHB0 can not even take the smallest ones they come from main memory instead
+bool USBSerial::allocate_buffers()
+{
+    unsigned int rx_size = SpscRing<uint8_t>::round_length(THEKERNEL->config->value(usb_serial_checksum, rx_buffer_size_checksum)->by_default(512)->as_int());
+    unsigned int tx_size = SpscRing<uint8_t>::round_length(THEKERNEL->config->value(usb_serial_checksum, tx_buffer_size_checksum)->by_default(256)->as_int());
+
+    // the receive buffer must at least take a packet and a line
+    if (rx_size < 4 * MAX_PACKET_SIZE_EPBULK) rx_size = 4 * MAX_PACKET_SIZE_EPBULK;
+    if (tx_size < 2 * MAX_PACKET_SIZE_EPBULK) tx_size = 2 * MAX_PACKET_SIZE_EPBULK;
+
+    uint8_t *rx, *tx;
+    while ((rx = (uint8_t *) AHB0.alloc(rx_size)) == NULL && rx_size > 4 * MAX_PACKET_SIZE_EPBULK)
+        rx_size >>= 1;
+    while ((tx = (uint8_t *) AHB0.alloc(tx_size)) == NULL && tx_size > 2 * MAX_PACKET_SIZE_EPBULK)
+        tx_size >>= 1;
+
+    if (rx == NULL)
+        rx = new uint8_t[rx_size];
+    if (tx == NULL)
+        tx = new uint8_t[tx_size];
+
+    // without buffers the endpoints NAK forever, so say why the port never answers
+    if (rx == NULL || tx == NULL)
+    {
+        THEKERNEL->streams->printf("error: no memory for the USB serial buffers, %u and %u bytes\r\n", rx_size, tx_size);
+        delete [] rx;
+        delete [] tx;
+        return false;
+    }
+
+    rxbuf.attach(rx, rx_size);
+    txbuf.attach(tx, tx_size);
+    return true;
+}
+
+void USBSerial::service_flush_rx()
+{
+    if (!flush_rx)
+        return;
+
+    // the part of a long line that was queued holds no newline, so nl_consumed stays as it is
+    rxbuf.consume(flush_rx_count);
+    flush_rx = false;
+
+    // the buffer is empty now, so the endpoint can take packets again
+    rx_stalled = false;
+    usb->endpointSetInterrupt(CDC_BulkOut.bEndpointAddress, true);
 }
 
 void USBSerial::ensure_tx_space(int space)
 {
-    while (txbuf.free() < space)
+    while ((int) txbuf.free() < space)
     {
         usb->endpointSetInterrupt(CDC_BulkIn.bEndpointAddress, true);
         usb->usbisr();
@@ -52,7 +116,7 @@ int USBSerial::_putc(int c)
     if (!attached)
         return 1;
     ensure_tx_space(1);
-    txbuf.queue(c);
+    txbuf.push(c);
 
     usb->endpointSetInterrupt(CDC_BulkIn.bEndpointAddress, true);
     return 1;
@@ -63,25 +127,17 @@ int USBSerial::_getc()
     if (!attached)
         return 0;
     uint8_t c = 0;
-    setled(4, 1); while (rxbuf.isEmpty()); setled(4, 0);
-    rxbuf.dequeue(&c);
-    if (rxbuf.free() == MAX_PACKET_SIZE_EPBULK)
-    {
-        usb->endpointSetInterrupt(CDC_BulkOut.bEndpointAddress, true);
-        iprintf("rxbuf has room for another packet, interrupt enabled\n");
-    }
-    else if ((rxbuf.free() < MAX_PACKET_SIZE_EPBULK) && (nl_in_rx == 0))
-    {
-        // handle potential deadlock where a short line, and the beginning of a very long line are bundled in one usb packet
-        rxbuf.flush();
-        flush_to_nl = true;
+    setled(4, 1); while (rxbuf.is_empty()); setled(4, 0);
+    rxbuf.pop(c);
+    if (c == '\n' || c == '\r')
+        nl_consumed++;
 
+    if (rx_stalled && rxbuf.free() >= MAX_PACKET_SIZE_EPBULK)
+    {
+        rx_stalled = false;
         usb->endpointSetInterrupt(CDC_BulkOut.bEndpointAddress, true);
         iprintf("rxbuf has room for another packet, interrupt enabled\n");
     }
-    if (nl_in_rx > 0)
-        if (c == '\n' || c == '\r')
-            nl_in_rx--;
 
     return c;
 }
@@ -94,8 +150,8 @@ int USBSerial::puts(const char *str)
     while (*str)
     {
         ensure_tx_space(1);
-        txbuf.queue(*str);
-        if ((txbuf.available() % 64) == 0)
+        txbuf.push(*str);
+        if ((txbuf.size() % 64) == 0)
             usb->endpointSetInterrupt(CDC_BulkIn.bEndpointAddress, true);
         i++;
         str++;
@@ -114,9 +170,9 @@ uint16_t USBSerial::writeBlock(const uint8_t * buf, uint16_t size)
     }
     if (size > 0)
     {
-        for (uint8_t i = 0; i < size; i++)
+        for (uint16_t i = 0; i < size; i++)
         {
-            txbuf.queue(buf[i]);
+            txbuf.push(buf[i]);
         }
         usb->endpointSetInterrupt(CDC_BulkIn.bEndpointAddress, true);
     }
@@ -140,7 +196,7 @@ bool USBSerial::USBEvent_EPIn(uint8_t bEP, uint8_t bEPStatus)
 
     uint8_t b[MAX_PACKET_SIZE_EPBULK];
 
-    int l = txbuf.available();
+    int l = txbuf.size();
     iprintf("%d bytes queued\n", l);
     if (l > 0)
     {
@@ -149,7 +205,7 @@ bool USBSerial::USBEvent_EPIn(uint8_t bEP, uint8_t bEPStatus)
         iprintf("Sending %d bytes:\n\t", l);
         int i;
         for (i = 0; i < l; i++) {
-            txbuf.dequeue(&b[i]);
+            txbuf.pop(b[i]);
             if (b[i] >= 32 && b[i] < 128)
                 iprintf("%c", b[i]);
             else {
@@ -159,7 +215,7 @@ bool USBSerial::USBEvent_EPIn(uint8_t bEP, uint8_t bEPStatus)
         iprintf("\nSending...\n");
         send(b, l);
         iprintf("Sent\n");
-        if (txbuf.available() == 0)
+        if (txbuf.is_empty())
             r = false;
     }
     else
@@ -182,9 +238,10 @@ bool USBSerial::USBEvent_EPOut(uint8_t bEP, uint8_t bEPStatus)
     if (bEP != CDC_BulkOut.bEndpointAddress)
         return false;
 
-    if (rxbuf.free() < MAX_PACKET_SIZE_EPBULK)
+    if ((rxbuf.free() < MAX_PACKET_SIZE_EPBULK) || flush_rx)
     {
-//         usb->endpointSetInterrupt(bEP, false);
+        // leave the packet in the endpoint, which NAKs the host until we turn the interrupt back on
+        rx_stalled = true;
         return false;
     }
 
@@ -197,7 +254,7 @@ bool USBSerial::USBEvent_EPOut(uint8_t bEP, uint8_t bEPStatus)
     for (uint8_t i = 0; i < size; i++) {
 
         if (flush_to_nl == false)
-            rxbuf.queue(c[i]);
+            rxbuf.push(c[i]);
 
         if (c[i] >= 32 && c[i] < 128)
         {
@@ -213,13 +270,15 @@ bool USBSerial::USBEvent_EPOut(uint8_t bEP, uint8_t bEPStatus)
             if (flush_to_nl)
                 flush_to_nl = false;
             else
-                nl_in_rx++;
+                nl_received++;
         }
-        else if (rxbuf.isFull() && (nl_in_rx == 0))
+        else if (rxbuf.is_full() && (lines_in_rx() == 0) && !flush_rx)
         {
             // to avoid a deadlock with very long lines, we must dump the buffer
             // and continue flushing to the next newline
-            rxbuf.flush();
+            // the rest of this packet is still scanned, so a line after that newline is kept
+            flush_rx_count = rxbuf.size();
+            flush_rx = true;
             flush_to_nl = true;
         }
     }
@@ -229,15 +288,15 @@ bool USBSerial::USBEvent_EPOut(uint8_t bEP, uint8_t bEPStatus)
     {
         // if buffer is full, stall endpoint, do not accept more data
         r = false;
+        rx_stalled = true;
 
-        if (nl_in_rx == 0)
+        if ((lines_in_rx() == 0) && !flush_rx)
         {
             // we have to check for long line deadlock here too
+            // the main loop empties the buffer and then lets more data in
+            flush_rx_count = rxbuf.size();
             flush_to_nl = true;
-            rxbuf.flush();
-
-            // and since our buffer is empty, we can accept more data
-            r = true;
+            flush_rx = true;
         }
     }
 
@@ -246,18 +305,57 @@ bool USBSerial::USBEvent_EPOut(uint8_t bEP, uint8_t bEPStatus)
     return r;
 }
 
-uint8_t USBSerial::available()
+uint16_t USBSerial::available()
 {
-    return rxbuf.available();
+    return rxbuf.size();
+}
+
+// take the next complete line out of rxbuf, copying it in at most two pieces rather than a char at a time
+bool USBSerial::read_line(string& line)
+{
+    if (lines_in_rx() == 0)
+        return false;
+
+    line.clear();
+    uint8_t *first;
+    unsigned int n;
+    while ((n = rxbuf.span(&first)) > 0)
+    {
+        uint8_t *end = (uint8_t *) memchr(first, '\n', n);
+        uint8_t *cr = (uint8_t *) memchr(first, '\r', (end != NULL) ? (end - first) : n);
+        if (cr != NULL)
+            end = cr;
+
+        if (end != NULL)
+        {
+            line.append((const char *) first, end - first);
+            rxbuf.consume((end - first) + 1);
+            nl_consumed++;
+            return true;
+        }
+
+        // the line carries on from the start of the ring
+        line.append((const char *) first, n);
+        rxbuf.consume(n);
+    }
+
+    // the newline was flushed away under us
+    nl_consumed = nl_received;
+    return false;
 }
 
 void USBSerial::on_module_loaded()
 {
+    // without the main loop the port never counts as attached, so nothing waits on a buffer that is not there
+    if (!allocate_buffers())
+        return;
     this->register_for_event(ON_MAIN_LOOP);
 }
 
 void USBSerial::on_main_loop(void *argument)
 {
+    service_flush_rx();
+
     // apparently some OSes don't assert DTR when a program opens the port
     if (available() && !attach)
         attach = true;
@@ -274,31 +372,31 @@ void USBSerial::on_main_loop(void *argument)
         {
             attached = false;
             THEKERNEL->streams->remove_stream(this);
+            // txbuf is consumed by the IN endpoint ISR, so keep it out while we flush from this side
+            usb->endpointSetInterrupt(CDC_BulkIn.bEndpointAddress, false);
             txbuf.flush();
             rxbuf.flush();
-            nl_in_rx = 0;
+            nl_consumed = nl_received;
         }
     }
-    if (nl_in_rx)
+
+    string received;
+    bool got_line = read_line(received);
+
+    // a line has made room, so let the host send again
+    if (rx_stalled && rxbuf.free() >= MAX_PACKET_SIZE_EPBULK)
     {
-        string received;
-        while (available())
-        {
-            char c = _getc();
-            if( c == '\n' || c == '\r')
-            {
-                struct SerialMessage message;
-                message.message = received;
-                message.stream = this;
-                iprintf("USBSerial Received: %s\n", message.message.c_str());
-                THEKERNEL->call_event(ON_CONSOLE_LINE_RECEIVED, &message );
-                return;
-            }
-            else
-            {
-                received += c;
-            }
-        }
+        rx_stalled = false;
+        usb->endpointSetInterrupt(CDC_BulkOut.bEndpointAddress, true);
+    }
+
+    if (got_line)
+    {
+        struct SerialMessage message;
+        message.message = received;
+        message.stream = this;
+        iprintf("USBSerial Received: %s\n", message.message.c_str());
+        THEKERNEL->call_event(ON_CONSOLE_LINE_RECEIVED, &message );
     }
 }
 
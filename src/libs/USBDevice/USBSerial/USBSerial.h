@@ -21,7 +21,9 @@
 
 #include "USBCDC.h"
 // #include "Stream.h"
-#include "CircBuffer.h"
+#include "SpscRing.h"
+
+#include <string>
 
 #include "Module.h"
 #include "StreamOutput.h"
@@ -39,12 +41,13 @@ public:
     int _getc();
     int puts(const char *);
 
-    uint8_t available();
+    uint16_t available();
 
     uint16_t writeBlock(const uint8_t * buf, uint16_t size);
 
-    CircBuffer<uint8_t> rxbuf;
-    CircBuffer<uint8_t> txbuf;
+    // rxbuf is filled by the OUT endpoint ISR and emptied by the main loop, txbuf the other way around
+    SpscRing<uint8_t> rxbuf;
+    SpscRing<uint8_t> txbuf;
 
     void on_module_loaded(void);
     void on_main_loop(void *);
@@ -66,7 +69,13 @@ protected:
 
     // keep track of number of newlines in the buffer
     // this makes it trivial to detect if there's a new line available
-    volatile int nl_in_rx;
+    // the ISR counts them in and the main loop counts them out, so neither has to modify the other's counter
+    volatile uint32_t nl_received;
+    volatile uint32_t nl_consumed;
+    uint32_t lines_in_rx(void) { return nl_received - nl_consumed; };
+
+    bool read_line(std::string&);
+    bool allocate_buffers(void);
 
     // if we receive a line that's longer than the buffer, to avoid a deadlock
     // we must flush the buffer.
@@ -74,6 +83,16 @@ protected:
     // flushing until we find a newline.
     // this flag asserts when we are doing this
     bool flush_to_nl;
+
+    // only the main loop may flush rxbuf, so the ISR asks for it with this flag
+    // and says how much of it to drop, anything queued after that is the start of the next line
+    volatile bool flush_rx;
+    volatile uint32_t flush_rx_count;
+    void service_flush_rx(void);
+
+    // set by the ISR when it leaves a packet in the endpoint for lack of room, so the host is NAKed
+    // until the main loop has made room and turns the endpoint interrupt back on
+    volatile bool rx_stalled;
 private:
     USB *usb;
 //     mbed::FunctionPointer rx;
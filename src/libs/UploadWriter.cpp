@@ -0,0 +1,141 @@
+#include "UploadWriter.h"
+
+#include <string.h>
+
+UploadWriter::UploadWriter()
+{
+    fd = NULL;
+    buffer = NULL;
+    buffered = 0;
+    size = written = synced = 0;
+    idle = 0;
+    failed = false;
+}
+
+UploadWriter::~UploadWriter()
+{
+    close();
+}
+
+bool UploadWriter::open(const std::string& filename)
+{
+    close();
+
+    this->buffer = new char[buffer_size];
+    if(this->buffer == NULL) return false;
+
+    this->fd = fopen(filename.c_str(), "w");
+    if(this->fd == NULL) {
+        delete [] this->buffer;
+        this->buffer = NULL;
+        return false;
+    }
+
+    // we do our own buffering, in whole sectors
+    setvbuf(this->fd, NULL, _IONBF, 0);
+
+    this->filename = filename;
+    this->buffered = 0;
+    this->size = this->written = this->synced = 0;
+    this->digest.start();
+    this->idle = 0;
+    this->failed = false;
+    return true;
+}
+
+bool UploadWriter::write(const char *data, size_t len)
+{
+    if(this->fd == NULL) return false;
+
+    this->digest.update(data, len);
+    this->size += len;
+    this->idle = 0;
+
+    while(len > 0) {
+        size_t n = buffer_size - this->buffered;
+        if(n > len) n = len;
+        memcpy(this->buffer + this->buffered, data, n);
+        this->buffered += n;
+        data += n;
+        len -= n;
+
+        if(this->buffered == buffer_size && !flush(false)) return false;
+    }
+
+    if(this->written - this->synced >= sync_bytes && !flush(true)) return false;
+
+    return true;
+}
+
+// writes out as much as ends on a buffer boundary in the file, or everything if sync is set
+bool UploadWriter::flush(bool sync)
+{
+    // a partial write earlier leaves the file off the boundary, so only write up to it
+    size_t to_boundary = buffer_size - (this->written % buffer_size);
+
+    if(this->buffered >= to_boundary) {
+        if(!write_out(to_boundary)) return false;
+    }
+
+    if(sync) {
+        if(this->buffered > 0 && !write_out(this->buffered)) return false;
+
+        // closing is the only way to make FatFs update the directory entry through stdio
+        fclose(this->fd);
+        this->fd = fopen(this->filename.c_str(), "a");
+        if(this->fd == NULL) {
+            this->failed = true;
+            return false;
+        }
+        setvbuf(this->fd, NULL, _IONBF, 0);
+        this->synced = this->written;
+    }
+
+    return true;
+}
+
+bool UploadWriter::write_out(size_t n)
+{
+    if(fwrite(this->buffer, 1, n, this->fd) != n) {
+        fclose(this->fd);
+        this->fd = NULL;
+        this->failed = true;
+        return false;
+    }
+
+    this->written += n;
+    this->buffered -= n;
+    if(this->buffered > 0) memmove(this->buffer, this->buffer + n, this->buffered);
+    return true;
+}
+
+bool UploadWriter::close()
+{
+    bool ok = !this->failed;
+
+    if(this->fd != NULL) {
+        if(this->buffered > 0 && !write_out(this->buffered)) ok = false;
+        if(this->fd != NULL) fclose(this->fd);
+        this->fd = NULL;
+
+        // only a complete file is worth remembering
+        this->digest.finish(ok ? this->filename : "");
+    }
+
+    if(this->buffer != NULL) {
+        delete [] this->buffer;
+        this->buffer = NULL;
+    }
+    this->buffered = 0;
+
+    return ok;
+}
+
+void UploadWriter::second_tick()
+{
+    if(this->fd == NULL) return;
+
+    if(++this->idle == idle_seconds && (this->buffered > 0 || this->written != this->synced)) {
+        flush(true);
+    }
+}
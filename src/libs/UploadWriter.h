@@ -0,0 +1,59 @@
+#ifndef _UPLOADWRITER_H_
+#define _UPLOADWRITER_H_
+
+#include "FileDigest.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+
+/*
+ * Writes a file that arrives a line at a time, as in M28 uploads
+ *
+ * Lines are gathered into a buffer that is written out whenever it fills, and every write ends on a sector
+ * boundary of the file, so FatFs writes whole sectors straight from the buffer instead of read-modify-writing
+ * them through its window. The file is synced by closing and reopening it every sync_bytes, or when the sender
+ * has gone quiet for idle_seconds, so an interrupted upload keeps most of what was sent.
+ *
+ * A CRC-32 and MD5 of everything written are kept as it goes, for the sender to check.
+ */
+
+class UploadWriter {
+    public:
+        UploadWriter();
+        ~UploadWriter();
+
+        bool open(const std::string& filename);
+        bool write(const char *data, size_t len);
+        bool close();
+
+        // once a second, flushes and syncs if nothing has arrived for a while
+        void second_tick();
+
+        bool is_open() const { return fd != NULL; };
+        uint32_t get_size() const { return size; };
+        uint32_t get_crc() const { return digest.get_crc(); };
+        const char *get_md5() const { return digest.get_md5(); };   // once closed
+
+    private:
+        bool flush(bool sync);
+        bool write_out(size_t n);
+
+        static const size_t buffer_size = 2048;     // a multiple of the sector size
+        static const uint32_t sync_bytes = 256 * 1024;
+        static const uint8_t idle_seconds = 2;
+
+        std::string filename;
+        FILE *fd;
+        char *buffer;
+        size_t buffered;
+
+        uint32_t size;              // bytes accepted so far
+        uint32_t written;           // bytes handed to the file so far
+        uint32_t synced;            // written when the file was last synced
+        FileDigest digest;
+        uint8_t idle;
+        bool failed;
+};
+
+#endif
@@ -22,14 +22,7 @@ void* ahbmalloc(size_t size, BANK bank)
 
 void ahbfree(void* ptr, size_t size)
 {
-	MemoryPool* m = MemoryPool::first;
-	while (m)
-	{
-		if (m->has(ptr))
-		{
-			m->dealloc(ptr);
-			return;
-		}
-		m = m->next;
-	}
+	MemoryPool* m = MemoryPool::owner(ptr);
+	if (m)
+		m->dealloc(ptr);
 }
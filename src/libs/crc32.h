@@ -0,0 +1,11 @@
+#ifndef _CRC32_H_
+#define _CRC32_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+// CRC-32 as zip, ethernet and crc32(1) compute it, fed a piece at a time
+// start with crc = 0 and pass the result of each call to the next
+uint32_t crc32_update(uint32_t crc, const void *data, size_t len);
+
+#endif
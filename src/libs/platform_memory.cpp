@@ -2,3 +2,19 @@
 
 MemoryPool* _AHB0;
 MemoryPool* _AHB1;
+
+MemoryPool* memory_bank_pool(const std::string& name)
+{
+    if (name == "ahb0")
+        return _AHB0;
+    if (name == "ahb1")
+        return _AHB1;
+    return NULL;
+}
+
+const char* memory_bank_name(MemoryPool* pool)
+{
+    if (pool == NULL)
+        return "main";
+    return pool == _AHB0 ? "ahb0" : "ahb1";
+}
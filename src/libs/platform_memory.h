@@ -9,4 +9,10 @@
 extern MemoryPool* _AHB0;
 extern MemoryPool* _AHB1;
 
+#include <string>
+
+// The pool for a bank named in the config, ahb0 or ahb1, NULL for main memory
+MemoryPool* memory_bank_pool(const std::string& name);
+const char* memory_bank_name(MemoryPool* pool);
+
 #endif /* _PLATFORM_MEMORY_H */
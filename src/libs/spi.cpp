@@ -4,15 +4,36 @@
 #include "lpc17xx_pinsel.h"
 #include "lpc17xx_ssp.h"
 #include "lpc17xx_gpio.h"
+#include "lpc17xx_gpdma.h"
+#include "system_LPC17xx.h"
+
+#include "Gpdma.h"
+#include "platform_memory.h"
 
 #include <stdio.h>
 
 SPI* SPI::isr_dispatch[N_SPI_INTERRUPT_ROUTINES];
+SPI* SPI::owner[N_SPI_INTERRUPT_ROUTINES];
+SPI::dma_dummy_t *SPI::dma_dummy[N_SPI_INTERRUPT_ROUTINES];
 
-class DMA;
+// a transfer this short is over before the DMA has been set up
+#define DMA_MIN_LENGTH 16
+// the GPDMA transfer size field is 12 bits
+#define DMA_MAX_CHUNK  4095
 
 SPI::SPI(PinName mosi, PinName miso, PinName sclk)
 {
+    port = -1;
+    cr0 = cpsr = 0;
+    dma_tx_channel = dma_rx_channel = -1;
+    dma_tx = NULL;
+    dma_rx = NULL;
+    dma_remaining = 0;
+    dma_callback = NULL;
+    dma_user = NULL;
+    dma_active = false;
+    dma_error = false;
+
     this->mosi.port = (mosi >> 5) & 7;
     this->mosi.pin = mosi & 0x1F;
 
@@ -23,35 +44,47 @@ SPI::SPI(PinName mosi, PinName miso, PinName sclk)
     this->sclk.pin = sclk & 0x1F;
 
     FIO_SetDir(this->mosi.port, 1UL << this->mosi.pin, 1);
-    FIO_SetDir(this->miso.port, 1UL << this->miso.pin, 0);
+    // write only devices like the panels leave miso unconnected
+    if (miso != NC)
+        FIO_SetDir(this->miso.port, 1UL << this->miso.pin, 0);
     FIO_SetDir(this->sclk.port, 1UL << this->sclk.pin, 1);
 
-    if (mosi == P0_9 && miso == P0_8 && sclk == P0_7)
+    if (mosi == P0_9 && (miso == P0_8 || miso == NC) && sclk == P0_7)
     {
 //         iprintf("SPI: using 0.7,0.8,0.9 with SSP1\n");
         // SSP1 on 0.7,0.8,0.9
         sspr = LPC_SSP1;
+        port = 1;
         isr_dispatch[1] = this;
 
-        LPC_PINCON->PINSEL0 &= ~((3 << (7*2)) | (3 << (8*2)) | (3 << (9*2)));
-        LPC_PINCON->PINSEL0 |=  ((2 << (7*2)) | (2 << (8*2)) | (2 << (9*2)));
+        LPC_PINCON->PINSEL0 &= ~((3 << (7*2)) | (3 << (9*2)));
+        LPC_PINCON->PINSEL0 |=  ((2 << (7*2)) | (2 << (9*2)));
+        if (miso != NC) {
+            LPC_PINCON->PINSEL0 &= ~(3 << (8*2));
+            LPC_PINCON->PINSEL0 |=  (2 << (8*2));
+        }
 
         LPC_SC->PCLKSEL0 &= 0xFFCFFFFF;
         LPC_SC->PCLKSEL0 |= 0x00100000;
 
         LPC_SC->PCONP |= CLKPWR_PCONP_PCSSP1;
     }
-    else if (mosi == P0_18 && miso == P0_17 && sclk == P0_15)
+    else if (mosi == P0_18 && (miso == P0_17 || miso == NC) && sclk == P0_15)
     {
 //         iprintf("SPI: using 0.15,0.17,0.18 with SSP0\n");
         // SSP0 on 0.15,0.16,0.17,0.18
         sspr = LPC_SSP0;
+        port = 0;
         isr_dispatch[0] = this;
 
         LPC_PINCON->PINSEL0 &= ~(3 << (15*2));
         LPC_PINCON->PINSEL0 |=  (2 << (15*2));
-        LPC_PINCON->PINSEL1 &= ~( (3 << ((17*2)&30)) | (3 << ((18*2)&30)) );
-        LPC_PINCON->PINSEL1 |=  ( (2 << ((17*2)&30)) | (2 << ((18*2)&30)) );
+        LPC_PINCON->PINSEL1 &= ~(3 << ((18*2)&30));
+        LPC_PINCON->PINSEL1 |=  (2 << ((18*2)&30));
+        if (miso != NC) {
+            LPC_PINCON->PINSEL1 &= ~(3 << ((17*2)&30));
+            LPC_PINCON->PINSEL1 |=  (2 << ((17*2)&30));
+        }
 
         LPC_SC->PCLKSEL1 &= 0xFFFFF3FF;
         LPC_SC->PCLKSEL1 |= 0x00000400;
@@ -63,6 +96,7 @@ SPI::SPI(PinName mosi, PinName miso, PinName sclk)
 //         iprintf("SPI: using 1.20,1.23,1.24 with SSP0\n");
         // SSP0 on 1.20,1.23,1.24
         sspr = LPC_SSP0;
+        port = 0;
         isr_dispatch[0] = this;
 
 // //         LPC_PINCON->PINSEL3 &= 0xFFFC3CFF;
@@ -83,8 +117,9 @@ SPI::SPI(PinName mosi, PinName miso, PinName sclk)
     }
 
     if (sspr) {
-        sspr->CR0 = SSP_DATABIT_8 |
-                    SSP_FRAME_SPI;
+        cr0 = SSP_DATABIT_8 |
+              SSP_FRAME_SPI;
+        sspr->CR0 = cr0;
         sspr->CR1 = SSP_MASTER_MODE;
         frequency(10000);
         sspr->CR1 |= SSP_CR1_SSP_EN;
@@ -93,43 +128,64 @@ SPI::SPI(PinName mosi, PinName miso, PinName sclk)
 
 SPI::~SPI()
 {
+    while (dma_active);
+    if (dma_tx_channel >= 0) Gpdma::release(dma_tx_channel);
+    if (dma_rx_channel >= 0) Gpdma::release(dma_rx_channel);
+    if (port >= 0 && owner[port] == this)
+        owner[port] = NULL;
+
     if (sspr == LPC_SSP0)
         LPC_SC->PCONP &= CLKPWR_PCONP_PCSSP0;
     else if (sspr == LPC_SSP1)
         LPC_SC->PCONP &= CLKPWR_PCONP_PCSSP1;
 }
 
+void SPI::take_port()
+{
+    // wait for our own or anyone else's transfer on this SSP to finish
+    while (dma_active);
+    if (port < 0)
+        return;
+    while (owner[port] != NULL && owner[port]->dma_active);
+
+    if (owner[port] != this) {
+        owner[port] = this;
+        sspr->CPSR = cpsr;
+        sspr->CR0 = cr0;
+    }
+}
+
 void SPI::frequency(uint32_t f)
 {
-    // CCLK = 25MHz
+    // PCLK = CCLK, see the PCLKSEL setup in the constructor
     // CPSR = 2 to 254, even only
     // CR0[8:15] (SCR, 0..255) is a further prescale
+    // f = PCLK / (CPSR . [SCR + 1]), rounded down so the device is never clocked faster than asked for
 
 //     iprintf("SPI: frequency %lu:", f);
+    // the soft SPI half bit delay, in nops
     delay = 25000000 / f;
-    // f = 25MHz / (CPSR . [SCR + 1])
-    // CPSR . (SCR + 1) = 25MHz / f
-    // min freq is 25MHz / (254 * 256)
     if (sspr) {
-        if (f < 385) {
-            sspr->CPSR = 254;
-            sspr->CR0 &= 0x00FF;
-            sspr->CR0 |= 255 << 8;
-        }
-        // max freq is 25MHz / (2 * 1)
-        else if (f > 12500000) {
-            sspr->CPSR = 2;
-            sspr->CR0 &= 0x00FF;
-        }
-        else {
-            sspr->CPSR = delay & 0xFE;
-            // CPSR . (SCR + 1) = f;
-            // (SCR + 1) = f / CPSR;
-            // SCR = (f / CPSR) - 1
-            sspr->CR0 &= 0x00FF;
-            sspr->CR0 |= (((delay / sspr->CPSR) - 1) & 0xFF) << 8;
-        }
+        take_port();
+        uint32_t divider = (SystemCoreClock + f - 1) / f;
+        if (divider < 2)
+            divider = 2;
+
+        // the smallest prescaler that leaves SCR in range
+        uint32_t prescale = 2;
+        while (prescale < 254 && divider > prescale * 256)
+            prescale += 2;
+
+        uint32_t scr = (divider + prescale - 1) / prescale;
+        if (scr > 256)
+            scr = 256;
+
+        sspr->CPSR = prescale;
+        sspr->CR0 &= 0x00FF;
+        sspr->CR0 |= ((scr - 1) & 0xFF) << 8;
 //         iprintf(" CPSR=%lu, CR0=%lu", sspr->CPSR, sspr->CR0);
+        cpsr = sspr->CPSR;
+        cr0 = sspr->CR0;
     }
 //    iprintf("\n");
 }
@@ -145,6 +201,7 @@ uint8_t SPI::write(uint8_t data)
     uint8_t r = 0;
 //     iprintf("SPI: >0x%02X", data);
     if (sspr) {
+        acquire();
         while ((sspr->SR & SSP_SR_TNF) == 0);
         sspr->DR = data;
         while ((sspr->SR & SSP_SR_RNE) == 0);
@@ -176,58 +233,136 @@ uint8_t SPI::write(uint8_t data)
     return r;
 }
 
-// TODO: timer feeds DMA feeds 0xFFs to card then we listen for responses using our interrupt
-// allow me to do something like:
-// disk.start_multi_write(int blocks, int blocksize, void *buffer);
-// enable_usb_isr();
-// [...]
-// usb_isr() {
-//    if (disk.buffer_in_use(void *buffer))
-//        return;
-//    usb_ep_read(buffer);
-//    if (buffer_full)
-//        disk.validate_buffer(buffer);
-//    if (disk.finished_transfer())
-//        disk.end_multi_write();
-// };
-
 bool SPI::can_DMA()
 {
     return (sspr != NULL);
 }
 
-// int SPI::setup_DMA_rx(DMA_REG *dma)
-// {
-//     if (!sspr)
-//         return -1;
-//
-//     dma->DMACCControl = 0;
-//     dma->DMACCConfiguration = 0;
-//     if (sspr == LPC_SSP0)
-//         dma->DMACCConfiguration |= (GPDMA_CONN_SSP0_Rx << 6);
-//     if (sspr == LPC_SSP1)
-//         dma->DMACCConfiguration |= (GPDMA_CONN_SSP1_Rx << 6);
-//
-//     dma->DMACCConfiguration |= GPDMA_TRANSFERTYPE_M2P << 11;
-//     return 0;
-// }
-//
-// int SPI::start_DMA_rx(DMA_REG *dma)
-// {
-//     dma->DMACCConfiguration |=
-// }
-
-// int SPI::writeblock(uint8_t *block, int blocklen)
-// {
-//     static DMA *d = new DMA();
-//     d.sourceaddr(block);
-//     d.transferlength(blocklen);
-//     d.destinationperipheral(sspr);
-//     d.start();
-//     while (d.active());
-//     return blocklen;
-//     return 0;
-// }
+int SPI::transfer(const uint8_t *tx, uint8_t *rx, uint32_t length)
+{
+    if (length >= DMA_MIN_LENGTH && transfer_async(tx, rx, length, NULL, NULL)) {
+        while (dma_active);
+        return dma_error ? -1 : 0;
+    }
+
+    for (uint32_t i = 0; i < length; i++) {
+        uint8_t r = write(tx ? tx[i] : 0xFF);
+        if (rx)
+            rx[i] = r;
+    }
+    return 0;
+}
+
+// Two channels per SPI, claimed the first time they are needed. The receive channel is claimed first so it wins
+// arbitration and the RX FIFO never overruns
+bool SPI::claim_dma()
+{
+    if (dma_rx_channel >= 0)
+        return true;
+
+    if (dma_dummy[port] == NULL) {
+        dma_dummy[port] = (dma_dummy_t *)AHB0.alloc(sizeof(dma_dummy_t));
+        if (dma_dummy[port] == NULL)
+            return false;
+        dma_dummy[port]->tx_ones = 0xFFFFFFFF;
+    }
+
+    dma_rx_channel = Gpdma::claim(&SPI::dma_done, this);
+    dma_tx_channel = Gpdma::claim(&SPI::dma_done, this);
+    if (dma_rx_channel < 0 || dma_tx_channel < 0) {
+        if (dma_rx_channel >= 0) Gpdma::release(dma_rx_channel);
+        if (dma_tx_channel >= 0) Gpdma::release(dma_tx_channel);
+        dma_rx_channel = dma_tx_channel = -1;
+        return false;
+    }
+    return true;
+}
+
+bool SPI::transfer_async(const uint8_t *tx, uint8_t *rx, uint32_t length, spi_callback_t callback, void *user)
+{
+    if (sspr == NULL || length == 0)
+        return false;
+    if ((tx && !Gpdma::reachable(tx)) || (rx && !Gpdma::reachable(rx)))
+        return false;
+
+    acquire();
+    if (!claim_dma())
+        return false;
+
+    // nothing left over from polled transfers may end up in the receive buffer
+    while (sspr->SR & SSP_SR_BSY);
+    while (sspr->SR & SSP_SR_RNE)
+        (void)sspr->DR;
+    sspr->ICR = SSP_ICR_ROR;
+
+    dma_tx = tx;
+    dma_rx = rx;
+    dma_remaining = length;
+    dma_callback = callback;
+    dma_user = user;
+    dma_error = false;
+    dma_active = true;
+
+    sspr->DMACR = SSP_DMA_RXDMA_EN | SSP_DMA_TXDMA_EN;
+    start_dma_chunk();
+    return true;
+}
+
+void SPI::start_dma_chunk()
+{
+    uint32_t n = (dma_remaining > DMA_MAX_CHUNK) ? DMA_MAX_CHUNK : dma_remaining;
+    uint32_t conn_tx = (port == 0) ? GPDMA_CONN_SSP0_Tx : GPDMA_CONN_SSP1_Tx;
+    uint32_t conn_rx = (port == 0) ? GPDMA_CONN_SSP0_Rx : GPDMA_CONN_SSP1_Rx;
+
+    // receive side first, it raises the interrupt once the last byte of the chunk is in
+    LPC_GPDMACH_TypeDef *ch = Gpdma::channel(dma_rx_channel);
+    ch->DMACCSrcAddr = (uint32_t)&sspr->DR;
+    ch->DMACCDestAddr = dma_rx ? (uint32_t)dma_rx : (uint32_t)&dma_dummy[port]->rx_sink;
+    ch->DMACCLLI = 0;
+    ch->DMACCControl = GPDMA_DMACCxControl_TransferSize(n) | GPDMA_DMACCxControl_SBSize(GPDMA_BSIZE_4) | GPDMA_DMACCxControl_DBSize(GPDMA_BSIZE_4)
+                     | GPDMA_DMACCxControl_SWidth(GPDMA_WIDTH_BYTE) | GPDMA_DMACCxControl_DWidth(GPDMA_WIDTH_BYTE)
+                     | (dma_rx ? GPDMA_DMACCxControl_DI : 0) | GPDMA_DMACCxControl_I;
+    ch->DMACCConfig = GPDMA_DMACCxConfig_E | GPDMA_DMACCxConfig_SrcPeripheral(conn_rx)
+                    | GPDMA_DMACCxConfig_TransferType(GPDMA_TRANSFERTYPE_P2M) | GPDMA_DMACCxConfig_IE | GPDMA_DMACCxConfig_ITC;
+
+    // the transmit side only interrupts on an error
+    ch = Gpdma::channel(dma_tx_channel);
+    ch->DMACCSrcAddr = dma_tx ? (uint32_t)dma_tx : (uint32_t)&dma_dummy[port]->tx_ones;
+    ch->DMACCDestAddr = (uint32_t)&sspr->DR;
+    ch->DMACCLLI = 0;
+    ch->DMACCControl = GPDMA_DMACCxControl_TransferSize(n) | GPDMA_DMACCxControl_SBSize(GPDMA_BSIZE_4) | GPDMA_DMACCxControl_DBSize(GPDMA_BSIZE_4)
+                     | GPDMA_DMACCxControl_SWidth(GPDMA_WIDTH_BYTE) | GPDMA_DMACCxControl_DWidth(GPDMA_WIDTH_BYTE)
+                     | (dma_tx ? GPDMA_DMACCxControl_SI : 0);
+    ch->DMACCConfig = GPDMA_DMACCxConfig_E | GPDMA_DMACCxConfig_DestPeripheral(conn_tx)
+                    | GPDMA_DMACCxConfig_TransferType(GPDMA_TRANSFERTYPE_M2P) | GPDMA_DMACCxConfig_IE;
+
+    if (dma_tx) dma_tx += n;
+    if (dma_rx) dma_rx += n;
+    dma_remaining -= n;
+}
+
+void SPI::dma_done(void *user, bool error)
+{
+    SPI *self = (SPI *)user;
+    if (!self->dma_active)
+        return;
+
+    if (!error && self->dma_remaining > 0) {
+        self->start_dma_chunk();
+        return;
+    }
+
+    if (error) {
+        Gpdma::stop(self->dma_tx_channel);
+        Gpdma::stop(self->dma_rx_channel);
+    }
+    self->sspr->DMACR = 0;
+    self->dma_error = error;
+    self->dma_active = false;
+
+    if (self->dma_callback)
+        self->dma_callback(self->dma_user, error);
+}
 
 void SPI::irq()
 {
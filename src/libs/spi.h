@@ -5,6 +5,9 @@
 
 #include "spi_hal.h"
 
+// The callback runs in the DMA interrupt, error is set if a channel stopped on a bus error
+typedef void (*spi_callback_t)(void *user, bool error);
+
 class SPI {
 public:
     SPI(PinName mosi, PinName miso, PinName sclk);
@@ -13,22 +16,63 @@ public:
     void frequency(uint32_t);
     uint8_t write(uint8_t);
 
-//     int writeblock(uint8_t *, int);
+    /*
+     * Block transfers
+     *
+     * tx may be NULL to clock out 0xFF, rx may be NULL to throw away what comes back.
+     * The GPDMA moves the bytes when both buffers are somewhere it can reach, see Gpdma::reachable
+     */
+
+    // blocking, falls back to one byte at a time when the DMA can not be used
+    // returns 0 if successful
+    int transfer(const uint8_t *tx, uint8_t *rx, uint32_t length);
+
+    // returns straight away, callback (which may be NULL) is called once the last byte has been received
+    // returns false if the transfer can not be done by DMA, nothing has been sent then
+    bool transfer_async(const uint8_t *tx, uint8_t *rx, uint32_t length, spi_callback_t callback, void *user);
 
     bool can_DMA();
-    int setup_DMA_rx(DMA_REG *);
-    int setup_DMA_tx(DMA_REG *);
+    bool dma_busy() { return dma_active; }
 
     void irq(void);
 
     static SPI* isr_dispatch[N_SPI_INTERRUPT_ROUTINES];
 
 protected:
+    // several SPI objects may share an SSP, eg the sd card and a panel, so the SSP settings follow whoever uses it
+    void acquire(void) { if (dma_active || (port >= 0 && owner[port] != this)) take_port(); }
+    void take_port(void);
+
+    bool claim_dma(void);
+    void start_dma_chunk(void);
+    static void dma_done(void *user, bool error);
+
+    static SPI* owner[N_SPI_INTERRUPT_ROUTINES];
+    // what a one sided transfer sends from and receives into, one per port so two ports can run at once
+    struct dma_dummy_t {
+        uint32_t tx_ones;   // always 0xFF bytes, nothing writes it after it is set up
+        uint32_t rx_sink;
+    };
+    static dma_dummy_t *dma_dummy[N_SPI_INTERRUPT_ROUTINES];
+
     uint32_t delay;
     Pin_t miso;
     Pin_t mosi;
     Pin_t sclk;
     SPI_REG *sspr;
+    int port;
+    uint32_t cr0;
+    uint32_t cpsr;
+
+    int dma_tx_channel;
+    int dma_rx_channel;
+    const uint8_t *dma_tx;
+    uint8_t *dma_rx;
+    uint32_t dma_remaining;
+    spi_callback_t dma_callback;
+    void *dma_user;
+    volatile bool dma_active;
+    volatile bool dma_error;
 };
 
 #endif /* _SPI_H */
@@ -24,6 +24,7 @@
 #include "modules/utils/pausebutton/PauseButton.h"
 #include "modules/utils/PlayLed/PlayLed.h"
 #include "modules/utils/panel/Panel.h"
+#include "modules/utils/datalogger/DataLogger.h"
 #include "libs/Network/uip/Network.h"
 #include "Config.h"
 #include "checksumm.h"
@@ -150,6 +151,10 @@ void init() {
     #ifndef NO_TOOLS_TEMPERATURESWITCH
     kernel->add_module( new TemperatureSwitch() );
     #endif
+    #ifndef NO_UTILS_DATALOGGER
+    // after the temperature controls, it names them when it starts
+    kernel->add_module( new DataLogger() );
+    #endif
 
     // Create and initialize USB stuff
     u.init();
@@ -180,21 +185,7 @@ void init() {
     }
 
     if(sdok) {
-        // load config override file if present
-        // NOTE only Mxxx commands that set values should be put in this file. The file is generated by M500
-        FILE *fp= fopen(kernel->config_override_filename(), "r");
-        if(fp != NULL) {
-            char buf[132];
-            kernel->streams->printf("Loading config override file: %s...\n", kernel->config_override_filename());
-            while(fgets(buf, sizeof buf, fp) != NULL) {
-                kernel->streams->printf("  %s", buf);
-                if(buf[0] == ';') continue; // skip the comments
-                struct SerialMessage message= {&(StreamOutput::NullStream), buf};
-                kernel->call_event(ON_CONSOLE_LINE_RECEIVED, &message);
-            }
-            kernel->streams->printf("config override file executed\n");
-            fclose(fp);
-        }
+        kernel->config->load_override(kernel->streams);
     }
 }
 
@@ -27,11 +27,18 @@ void GcodeDispatch::on_module_loaded()
 {
     return_error_on_unhandled_gcode = THEKERNEL->config->value( return_error_on_unhandled_gcode_checksum )->by_default(false)->as_bool();
     this->register_for_event(ON_CONSOLE_LINE_RECEIVED);
+    this->register_for_event(ON_SECOND_TICK);
     currentline = -1;
     uploading = false;
     last_g= 255;
 }
 
+// Lets the upload write out and sync what it holds when the sender goes quiet
+void GcodeDispatch::on_second_tick(void *argument)
+{
+    if(uploading) this->upload.second_tick();
+}
+
 // When a command is received, if it is a Gcode, dispatch it as an object via an event
 void GcodeDispatch::on_console_line_received(void *line)
 {
@@ -118,30 +125,39 @@ try_again:
                             case 28: // start upload command
                                 delete gcode;
 
-                                this->upload_filename = "/sd/" + single_command.substr(4); // rest of line is filename
-                                // open file
-                                upload_fd = fopen(this->upload_filename.c_str(), "w");
-                                if(upload_fd != NULL) {
-                                    this->uploading = true;
-                                    new_message.stream->printf("Writing to file: %s\r\n", this->upload_filename.c_str());
-                                } else {
-                                    new_message.stream->printf("open failed, File: %s.\r\n", this->upload_filename.c_str());
+                                {
+                                    string upload_filename = "/sd/" + single_command.substr(4); // rest of line is filename
+                                    // open file
+                                    if(this->upload.open(upload_filename)) {
+                                        this->uploading = true;
+                                        new_message.stream->printf("Writing to file: %s\r\n", upload_filename.c_str());
+                                    } else {
+                                        new_message.stream->printf("open failed, File: %s.\r\n", upload_filename.c_str());
+                                    }
                                 }
-                                //printf("Start Uploading file: %s, %p\n", upload_filename.c_str(), upload_fd);
                                 continue;
 
                             case 500: // M500 save volatile settings to config-override
-                                // replace stream with one that writes to config-override file
-                                gcode->stream = new FileStream(THEKERNEL->config_override_filename());
-                                // dispatch the M500 here so we can free up the stream when done
-                                THEKERNEL->call_event(ON_GCODE_RECEIVED, gcode );
-                                delete gcode->stream;
-                                delete gcode;
-                                new_message.stream->printf("Settings Stored to %s\r\nok\r\n", THEKERNEL->config_override_filename());
+                                {
+                                    // replace stream with one that writes to config-override file
+                                    FileStream *fs = new FileStream(THEKERNEL->config_override_filename(), true);
+                                    gcode->stream = fs;
+                                    // dispatch the M500 here so we can free up the stream when done
+                                    THEKERNEL->call_event(ON_GCODE_RECEIVED, gcode );
+                                    delete gcode;
+                                    // the old file is only replaced once the new one has been written completely
+                                    if(fs->close()) {
+                                        new_message.stream->printf("Settings Stored to %s\r\nok\r\n", THEKERNEL->config_override_filename());
+                                    } else {
+                                        new_message.stream->printf("Error: unable to store settings to %s\r\nok\r\n", THEKERNEL->config_override_filename());
+                                    }
+                                    delete fs;
+                                }
                                 continue;
 
                             case 502: // M502 deletes config-override so everything defaults to what is in config
                                 remove(THEKERNEL->config_override_filename());
+                                remove(FileStream::temp_filename(THEKERNEL->config_override_filename()).c_str());
                                 new_message.stream->printf("config override file deleted %s, reboot needed\r\nok\r\n", THEKERNEL->config_override_filename());
                                 delete gcode;
                                 continue;
@@ -179,41 +195,30 @@ try_again:
                 } else {
                     // we are uploading a file so save it
                     if(single_command.substr(0, 3) == "M29") {
-                        // done uploading, close file
-                        fclose(upload_fd);
-                        upload_fd = NULL;
+                        // done uploading, write out what is left and close file
+                        bool ok = this->upload.close();
                         uploading = false;
-                        upload_filename.clear();
-                        new_message.stream->printf("Done saving file.\r\n");
+                        if(ok) {
+                            new_message.stream->printf("Done saving file. %lu bytes, crc32 %08lx, md5 %s\r\n", this->upload.get_size(), this->upload.get_crc(), this->upload.get_md5());
+                        } else {
+                            new_message.stream->printf("Error:error writing to file, it is incomplete.\r\n");
+                        }
                         continue;
                     }
 
-                    if(upload_fd == NULL) {
+                    if(!this->upload.is_open()) {
                         // error detected writing to file so discard everything until it stops
                         new_message.stream->printf("ok\r\n");
                         continue;
                     }
 
                     single_command.append("\n");
-                    static int cnt = 0;
-                    if(fwrite(single_command.c_str(), 1, single_command.size(), upload_fd) != single_command.size()) {
+                    if(!this->upload.write(single_command.data(), single_command.size())) {
                         // error writing to file
                         new_message.stream->printf("Error:error writing to file.\r\n");
-                        fclose(upload_fd);
-                        upload_fd = NULL;
                         continue;
-
-                    } else {
-                        cnt += single_command.size();
-                        if (cnt > 400) {
-                            // HACK ALERT to get around fwrite corruption close and re open for append
-                            fclose(upload_fd);
-                            upload_fd = fopen(upload_filename.c_str(), "a");
-                            cnt = 0;
-                        }
-                        new_message.stream->printf("ok\r\n");
-                        //printf("uploading file write ok\n");
                     }
+                    new_message.stream->printf("ok\r\n");
                 }
             }
 
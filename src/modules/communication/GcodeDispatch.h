@@ -15,6 +15,7 @@ using std::string;
 #include "utils/Gcode.h"
 
 #include "libs/StreamOutput.h"
+#include "libs/UploadWriter.h"
 #define return_error_on_unhandled_gcode_checksum    CHECKSUM("return_error_on_unhandled_gcode")
 
 class GcodeDispatch : public Module {
@@ -23,12 +24,12 @@ class GcodeDispatch : public Module {
 
         virtual void on_module_loaded();
         virtual void on_console_line_received(void* line);
+        virtual void on_second_tick(void* argument);
         bool return_error_on_unhandled_gcode;
     private:
         int currentline;
         bool uploading;
-        string upload_filename;
-        FILE *upload_fd;
+        UploadWriter upload;
         uint8_t last_g;
 };
 
@@ -12,23 +12,52 @@ using std::string;
 #include "libs/Kernel.h"
 #include "libs/nuts_bolts.h"
 #include "SerialConsole.h"
-#include "libs/RingBuffer.h"
+#include "libs/SpscRing.h"
 #include "libs/SerialMessage.h"
 #include "libs/StreamOutput.h"
 #include "libs/StreamOutputPool.h"
+#include "libs/DmaRxRing.h"
+#include "libs/Gpdma.h"
+#include "libs/platform_memory.h"
+#include "checksumm.h"
+#include "Config.h"
+#include "ConfigValue.h"
+
+#include "lpc17xx_gpdma.h"
+
+#define uart0_checksum             CHECKSUM("uart0")
+#define dma_enable_checksum        CHECKSUM("dma_enable")
+
+#define RX_DMA_SIZE 256
+#define TX_DMA_SIZE 256
+
+// mbed keeps the UART registers to itself, the DMA needs them
+class ConsoleSerial : public mbed::Serial {
+    public:
+        ConsoleSerial(PinName tx, PinName rx) : mbed::Serial(tx, rx) {}
+        LPC_UART_TypeDef *uart() { return _serial.uart; }
+        int index() { return _serial.index; }
+};
 
 // Serial reading module
 // Treats every received line as a command and passes it ( via event call ) to the command dispatcher.
 // The command dispatcher will then ask other modules if they can do something with it
 SerialConsole::SerialConsole( PinName rx_pin, PinName tx_pin, int baud_rate ){
-    this->serial = new mbed::Serial( rx_pin, tx_pin );
+    ConsoleSerial *s = new ConsoleSerial( rx_pin, tx_pin );
+    this->serial = s;
     this->serial->baud(baud_rate);
+    this->uart = s->uart();
+    this->uart_index = s->index();
+    this->dma_rx = NULL;
+    this->dma_tx = NULL;
 }
 
 // Called when the module has just been loaded
 void SerialConsole::on_module_loaded() {
-    // We want to be called every time a new char is received
-    this->serial->attach(this, &SerialConsole::on_serial_char_received, mbed::Serial::RxIrq);
+    // Either the DMA takes the received chars, or we want to be called every time a new char is received
+    if( !(THEKERNEL->config->value(uart0_checksum, dma_enable_checksum)->by_default(false)->as_bool() && this->enable_dma()) ){
+        this->serial->attach(this, &SerialConsole::on_serial_char_received, mbed::Serial::RxIrq);
+    }
 
     // We only call the command dispatcher in the main loop, nowhere else
     this->register_for_event(ON_MAIN_LOOP);
@@ -43,18 +72,24 @@ void SerialConsole::on_serial_char_received(){
         char received = this->serial->getc();
         // convert CR to NL (for host OSs that don't send NL)
         if( received == '\r' ){ received = '\n'; }
-        this->buffer.push_back(received);
+        // a full buffer drops what does not fit, rather than corrupting the line being read
+        this->buffer.push(received);
     }
 }
 
 // Actual event calling must happen in the main loop because if it happens in the interrupt we will loose data
 void SerialConsole::on_main_loop(void * argument){
+    if( this->dma_rx != NULL ){
+        this->dma_line_received();
+        return;
+    }
+
     if( this->has_char('\n') ){
         string received;
         received.reserve(20);
         while(1){
            char c;
-           this->buffer.pop_front(c);
+           this->buffer.pop(c);
            if( c == '\n' ){
                 struct SerialMessage message;
                 message.message = received;
@@ -65,18 +100,41 @@ void SerialConsole::on_main_loop(void * argument){
                 received += c;
             }
         }
+    }else if( this->buffer.is_full() ){
+        // a line longer than the buffer can never complete, so drop it
+        this->buffer.flush();
     }
 }
 
 
 int SerialConsole::puts(const char* s)
 {
-    return fwrite(s, strlen(s), 1, (FILE*)(*this->serial));
+    if( this->dma_tx == NULL ){
+        return fwrite(s, strlen(s), 1, (FILE*)(*this->serial));
+    }
+
+    // queue for the TX channel, only waiting when the queue is full
+    int n = 0;
+    for( ; *s; s++, n++ ){
+        while( !this->dma_tx->push(*s) ){
+            this->kick_tx_dma();
+        }
+    }
+    this->kick_tx_dma();
+    return n;
 }
 
 int SerialConsole::_putc(int c)
 {
-    return this->serial->putc(c);
+    if( this->dma_tx == NULL ){
+        return this->serial->putc(c);
+    }
+
+    while( !this->dma_tx->push(c) ){
+        this->kick_tx_dma();
+    }
+    this->kick_tx_dma();
+    return c;
 }
 
 int SerialConsole::_getc()
@@ -86,12 +144,116 @@ int SerialConsole::_getc()
 
 // Does the queue have a given char ?
 bool SerialConsole::has_char(char letter){
-    int index = this->buffer.tail;
-    while( index != this->buffer.head ){
-        if( this->buffer.buffer[index] == letter ){
+    char *c;
+    for( unsigned int offset = 0; (c = this->buffer.peek(offset)) != NULL; offset++ ){
+        if( *c == letter ){
             return true;
         }
-        index = this->buffer.next_block_index(index);
     }
     return false;
 }
+
+/*
+ * DMA mode
+ *
+ * RX: a channel copies from the UART into rx_buffer round and round, linked to itself, without taking any interrupts
+ * except one per lap so we can tell if it overran us. The UART asks for a transfer when its FIFO reaches the
+ * trigger level, or when the line has been idle for a few characters with less than that in it, so the end of
+ * a line arrives without waiting for more. The main loop finds complete lines with DmaRxRing.
+ *
+ * TX: output is queued in dma_tx and a channel sends the longest contiguous piece of it, then the next one from
+ * its completion interrupt, until the queue is empty.
+ */
+bool SerialConsole::enable_dma(){
+    this->rx_buffer = (uint8_t *)AHB0.alloc(RX_DMA_SIZE);
+    this->rx_lli = (GpdmaLli *)AHB0.alloc(sizeof(GpdmaLli));
+    char *tx_buffer = (char *)AHB0.alloc(TX_DMA_SIZE);
+    this->rx_channel = Gpdma::claim(&SerialConsole::on_rx_dma_lap, this);
+    this->tx_channel = Gpdma::claim(&SerialConsole::on_tx_dma_done, this);
+
+    if( this->rx_buffer == NULL || this->rx_lli == NULL || tx_buffer == NULL || this->rx_channel < 0 || this->tx_channel < 0 ){
+        if( this->rx_buffer != NULL ) AHB0.dealloc(this->rx_buffer);
+        if( this->rx_lli != NULL ) AHB0.dealloc(this->rx_lli);
+        if( tx_buffer != NULL ) AHB0.dealloc(tx_buffer);
+        if( this->rx_channel >= 0 ) Gpdma::release(this->rx_channel);
+        if( this->tx_channel >= 0 ) Gpdma::release(this->tx_channel);
+        THEKERNEL->streams->printf("Not enough AHB0 memory or DMA channels for the serial DMA\r\n");
+        return false;
+    }
+
+    this->rx_laps = 0;
+    this->tx_in_flight = 0;
+    this->dma_rx = new DmaRxRing(this->rx_buffer, RX_DMA_SIZE);
+    this->dma_tx = new SpscRing<char>(tx_buffer, TX_DMA_SIZE);
+
+    // keep the FIFOs, make them ask the DMA for service, with the RX trigger at 8 characters
+    this->uart->FCR = (1 << 0) | (1 << 3) | (2 << 6);
+
+    // RX lap, linked to itself, with an interrupt at the end of each lap
+    this->rx_lli->src = (uint32_t)&this->uart->RBR;
+    this->rx_lli->dst = (uint32_t)this->rx_buffer;
+    this->rx_lli->next = (uint32_t)this->rx_lli;
+    this->rx_lli->control = GPDMA_DMACCxControl_TransferSize(RX_DMA_SIZE) | GPDMA_DMACCxControl_SBSize(GPDMA_BSIZE_1) | GPDMA_DMACCxControl_DBSize(GPDMA_BSIZE_1)
+                          | GPDMA_DMACCxControl_SWidth(GPDMA_WIDTH_BYTE) | GPDMA_DMACCxControl_DWidth(GPDMA_WIDTH_BYTE) | GPDMA_DMACCxControl_DI | GPDMA_DMACCxControl_I;
+
+    LPC_GPDMACH_TypeDef *ch = Gpdma::channel(this->rx_channel);
+    ch->DMACCSrcAddr = this->rx_lli->src;
+    ch->DMACCDestAddr = this->rx_lli->dst;
+    ch->DMACCLLI = this->rx_lli->next;
+    ch->DMACCControl = this->rx_lli->control;
+    ch->DMACCConfig = GPDMA_DMACCxConfig_E | GPDMA_DMACCxConfig_SrcPeripheral((GPDMA_CONN_UART0_Rx + 2 * this->uart_index))
+                    | GPDMA_DMACCxConfig_TransferType(GPDMA_TRANSFERTYPE_P2M) | GPDMA_DMACCxConfig_IE | GPDMA_DMACCxConfig_ITC;
+
+    return true;
+}
+
+void SerialConsole::on_rx_dma_lap(void *user, bool error){
+    SerialConsole *self = static_cast<SerialConsole *>(user);
+    self->rx_laps++;
+}
+
+// pass on one complete line per main loop, like the interrupt driven path does
+void SerialConsole::dma_line_received(){
+    // read the lap count before the position, DmaRxRing sorts out a lap that finished in between
+    uint32_t laps = this->rx_laps;
+    uint32_t offset = Gpdma::channel(this->rx_channel)->DMACCDestAddr - (uint32_t)this->rx_buffer;
+    this->dma_rx->update(laps, offset);
+
+    string received;
+    if( this->dma_rx->read_line(received) ){
+        struct SerialMessage message;
+        message.message = received;
+        message.stream = this;
+        THEKERNEL->call_event(ON_CONSOLE_LINE_RECEIVED, &message );
+    }
+}
+
+// only called with the DMA interrupt unable to run, either from it or from kick_tx_dma
+void SerialConsole::start_tx_dma(){
+    char *first;
+    uint32_t n = this->dma_tx->span(&first);
+    if( n > 0xFFF ) n = 0xFFF;
+    this->tx_in_flight = n;
+    if( n == 0 ) return;
+
+    LPC_GPDMACH_TypeDef *ch = Gpdma::channel(this->tx_channel);
+    ch->DMACCSrcAddr = (uint32_t)first;
+    ch->DMACCDestAddr = (uint32_t)&this->uart->THR;
+    ch->DMACCLLI = 0;
+    ch->DMACCControl = GPDMA_DMACCxControl_TransferSize(n) | GPDMA_DMACCxControl_SBSize(GPDMA_BSIZE_1) | GPDMA_DMACCxControl_DBSize(GPDMA_BSIZE_1)
+                     | GPDMA_DMACCxControl_SWidth(GPDMA_WIDTH_BYTE) | GPDMA_DMACCxControl_DWidth(GPDMA_WIDTH_BYTE) | GPDMA_DMACCxControl_SI | GPDMA_DMACCxControl_I;
+    ch->DMACCConfig = GPDMA_DMACCxConfig_E | GPDMA_DMACCxConfig_DestPeripheral((GPDMA_CONN_UART0_Tx + 2 * this->uart_index))
+                    | GPDMA_DMACCxConfig_TransferType(GPDMA_TRANSFERTYPE_M2P) | GPDMA_DMACCxConfig_IE | GPDMA_DMACCxConfig_ITC;
+}
+
+void SerialConsole::kick_tx_dma(){
+    NVIC_DisableIRQ(DMA_IRQn);
+    if( this->tx_in_flight == 0 ) this->start_tx_dma();
+    NVIC_EnableIRQ(DMA_IRQn);
+}
+
+void SerialConsole::on_tx_dma_done(void *user, bool error){
+    SerialConsole *self = static_cast<SerialConsole *>(user);
+    self->dma_tx->consume(self->tx_in_flight);
+    self->start_tx_dma();
+}
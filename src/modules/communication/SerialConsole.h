@@ -14,9 +14,12 @@
 #include <vector>
 #include <string>
 using std::string;
-#include "libs/RingBuffer.h"
+#include "libs/SpscRing.h"
 #include "libs/StreamOutput.h"
 
+class DmaRxRing;
+struct GpdmaLli;
+
 
 #define baud_rate_setting_checksum CHECKSUM("baud_rate")
 
@@ -33,10 +36,33 @@ class SerialConsole : public Module, public StreamOutput {
         int _getc(void);
         int puts(const char*);
 
+        bool enable_dma(void);
+
         //string receive_buffer;                 // Received chars are stored here until a newline character is received
         //vector<std::string> received_lines;    // Received lines are stored here until they are requested
-        RingBuffer<char,256> buffer;             // Receive buffer
+        SpscBuffer<char,256> buffer;             // Receive buffer, filled by the RX interrupt and emptied by the main loop
         mbed::Serial* serial;
+
+    private:
+        static void on_rx_dma_lap(void *user, bool error);
+        static void on_tx_dma_done(void *user, bool error);
+        void start_tx_dma(void);
+        void kick_tx_dma(void);
+        void dma_line_received(void);
+
+        LPC_UART_TypeDef *uart;
+        int uart_index;
+
+        // DMA mode, dma_rx is NULL when the RX interrupt takes the bytes instead
+        DmaRxRing *dma_rx;
+        uint8_t *rx_buffer;
+        GpdmaLli *rx_lli;
+        volatile uint32_t rx_laps;
+        int rx_channel;
+
+        SpscRing<char> *dma_tx;
+        volatile uint32_t tx_in_flight;           // bytes the TX channel is sending, 0 when it is idle
+        int tx_channel;
 };
 
 #endif
@@ -38,6 +38,7 @@ void Block::clear()
     //travel_distances.clear();
     gcodes.clear();
     std::vector<Gcode>().swap(gcodes); // this resizes the vector releasing its memory
+    std::vector<BlockOutput>().swap(outputs);
 
     clear_vector(this->steps);
 
@@ -244,6 +245,33 @@ void Block::append_gcode(Gcode* gcode)
     gcodes.push_back(new_gcode);
 }
 
+// Fire a hook from the step interrupt once the given distance into this block is reached
+void Block::append_output(float distance, float lead_time, const Hook& hook, uint32_t argument)
+{
+    BlockOutput output;
+    output.distance = distance;
+    output.lead_time = lead_time;
+    output.hook = hook;
+    output.argument = argument;
+    outputs.push_back(output);
+}
+
+// The step of the main axis at which an output must fire, moved earlier by its lead time
+// The lead time is converted using the nominal rate, so it is exact if the block is cruising at that point
+unsigned int Block::output_step(const BlockOutput& output) const
+{
+    if (this->millimeters <= 0.0F || output.distance <= 0.0F)
+        return 0;
+
+    float step = (output.distance / this->millimeters) * this->steps_event_count;
+    step -= output.lead_time * this->nominal_rate;
+    if (step <= 0.0F)
+        return 0;
+    if (step >= this->steps_event_count)
+        return this->steps_event_count;
+    return lroundf(step);
+}
+
 void Block::begin()
 {
     recalculate_flag = false;
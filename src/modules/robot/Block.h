@@ -12,8 +12,18 @@ using namespace std;
 #include <string>
 #include <vector>
 
+#include "libs/Hook.h"
+
 class Gcode;
 
+// An output change ( laser, pen, valve, trigger ... ) to make at a given position inside a block, instead of at its start
+struct BlockOutput {
+    float    distance;  // mm from the start of the block
+    float    lead_time; // seconds to fire early by, to compensate for the output's own latency
+    Hook     hook;
+    uint32_t argument;  // passed to the hook
+};
+
 float max_allowable_speed( float acceleration, float target_velocity, float distance);
 
 class Block {
@@ -32,6 +42,8 @@ class Block {
         void debug();
 
         void append_gcode(Gcode* gcode);
+        void append_output(float distance, float lead_time, const Hook& hook, uint32_t argument);
+        unsigned int output_step(const BlockOutput& output) const;
 
         void take();
         void release();
@@ -45,6 +57,7 @@ class Block {
         //vector<std::string> commands;
         //vector<float> travel_distances;
         vector<Gcode> gcodes;
+        vector<BlockOutput> outputs;
 
         unsigned int   steps[3];           // Number of steps for each axis for this block
         unsigned int   steps_event_count;  // Steps for the longest axis
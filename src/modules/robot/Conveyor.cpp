@@ -22,8 +22,10 @@ using namespace std;
 #include "Config.h"
 #include "libs/StreamOutputPool.h"
 #include "ConfigValue.h"
+#include "platform_memory.h"
 
 #define planner_queue_size_checksum CHECKSUM("planner_queue_size")
+#define planner_queue_bank_checksum CHECKSUM("planner_queue_bank")
 
 /*
  * The conveyor holds the queue of blocks, takes care of creating them, and starting the executing chain of blocks
@@ -61,7 +63,7 @@ void Conveyor::on_module_loaded(){
     register_for_event(ON_IDLE);
     register_for_event(ON_MAIN_LOOP);
 
-    on_config_reload(this);
+    load_config();
 }
 
 // Delete blocks here, because they can't be deleted in interrupt context ( see Block.cpp:release )
@@ -118,9 +120,27 @@ void Conveyor::on_main_loop(void*)
         ensure_running();
 }
 
-void Conveyor::on_config_reload(void* argument)
+// Only read when loaded, resizing the queue resets its indices under gc_pending, so a change to it needs a reset
+void Conveyor::load_config()
 {
-    queue.resize(THEKERNEL->config->value(planner_queue_size_checksum)->by_default(32)->as_number());
+    unsigned int size = THEKERNEL->config->value(planner_queue_size_checksum)->by_default(32)->as_number();
+    // the blocks can live in one of the AHB banks, which leaves main memory for everything else
+    MemoryPool *pool = memory_bank_pool(THEKERNEL->config->value(planner_queue_bank_checksum)->by_default("main")->as_string());
+
+    if(!queue.resize(size, pool) && pool != NULL) {
+        THEKERNEL->streams->printf("Planner queue of %u blocks does not fit in %s, using main memory\r\n", size, memory_bank_name(pool));
+        pool = NULL;
+        queue.resize(size);
+    }
+
+    // the ring is a power of two long, so say so if that is not what was asked for
+    if(queue.capacity() + 1 != size) {
+        THEKERNEL->streams->printf("Planner queue size %u is not a power of two, using %u blocks\r\n", size, queue.capacity() + 1);
+    }
+
+    if(pool != NULL) {
+        THEKERNEL->streams->printf("Planner queue: %u blocks of %u bytes in %s, room for %lu more\r\n", queue.capacity() + 1, (unsigned int)sizeof(Block), memory_bank_name(pool), pool->largest_free() / sizeof(Block));
+    }
 }
 
 void Conveyor::append_gcode(Gcode* gcode)
@@ -129,6 +149,12 @@ void Conveyor::append_gcode(Gcode* gcode)
     queue.head_ref()->append_gcode(gcode);
 }
 
+// Fire an output at a given distance into the next move, see Block::append_output
+void Conveyor::append_output(float distance, float lead_time, const Hook& hook, uint32_t argument)
+{
+    queue.head_ref()->append_output(distance, lead_time, hook, argument);
+}
+
 // Process a new block in the queue
 void Conveyor::on_block_end(void* block)
 {
@@ -17,6 +17,7 @@ using namespace std;
 
 class Gcode;
 class Block;
+class Hook;
 
 class Conveyor : public Module
 {
@@ -27,16 +28,18 @@ public:
     void on_idle(void *);
     void on_main_loop(void *);
     void on_block_end(void *);
-    void on_config_reload(void *);
 
     void notify_block_finished(Block *);
 
     void wait_for_empty_queue();
     bool is_queue_empty() { return queue.is_empty(); };
+    unsigned int queue_size() { return queue.size(); };
+    unsigned int queue_capacity() { return queue.capacity(); };
 
     void ensure_running(void);
 
     void append_gcode(Gcode *);
+    void append_output(float distance, float lead_time, const Hook& hook, uint32_t argument);
     void queue_head_block(void);
 
     void dump_queue(void);
@@ -44,6 +47,8 @@ public:
     friend class Planner; // for queue
 
 private:
+    void load_config(void);
+
     typedef HeapRing<Block> Queue_t;
 
     Queue_t queue;  // Queue of Blocks
@@ -134,10 +134,11 @@ void Robot::on_module_loaded()
     this->register_for_event(ON_SET_PUBLIC_DATA);
 
     // Configuration
-    this->on_config_reload(this);
+    this->load_config();
 }
 
-void Robot::on_config_reload(void *argument)
+// Only read when loaded, it makes the arm solution and the stepper motors, so a change to it needs a reset
+void Robot::load_config()
 {
 
     // Arm solutions are used to convert positions in millimeters into position in steps for each stepper motor.
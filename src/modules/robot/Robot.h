@@ -22,7 +22,6 @@ class Robot : public Module {
     public:
         Robot();
         void on_module_loaded();
-        void on_config_reload(void* argument);
         void on_gcode_received(void* argument);
         void on_get_public_data(void* argument);
         void on_set_public_data(void* argument);
@@ -32,6 +31,11 @@ class Robot : public Module {
         float to_millimeters(float value);
         float from_millimeters(float value);
         float get_seconds_per_minute() const { return seconds_per_minute; }
+        // modal state, eg for Player to checkpoint a job
+        float get_feed_rate() const { return feed_rate; }
+        float get_seek_rate() const { return seek_rate; }
+        bool is_inch_mode() const { return inch_mode; }
+        void get_tool_offset(float offset[]) const { memcpy(offset, this->toolOffset, sizeof(float)*3 ); }
 
         BaseSolution* arm_solution;                           // Selected Arm solution ( millimeters to step calculation )
         bool absolute_mode;                                   // true for absolute mode ( default ), false for relative mode
@@ -41,6 +45,7 @@ class Robot : public Module {
         std::vector<StepperMotor*> actuators;
 
     private:
+        void load_config();
         void distance_in_gcode_is_known(Gcode* gcode);
         void append_milestone( float target[], float rate_mm_s);
         void append_line( Gcode* gcode, float target[], float rate_mm_s);
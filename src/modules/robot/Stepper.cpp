@@ -23,7 +23,6 @@
 using namespace std;
 
 #include "libs/nuts_bolts.h"
-#include "libs/Hook.h"
 
 #include <mri.h>
 
@@ -52,6 +51,12 @@ void Stepper::on_module_loaded(){
     // Get onfiguration
     this->on_config_reload(this);
 
+    // The tick rate is only read here, the acceleration ticks of other modules and the planner's rate_delta follow it
+    this->acceleration_ticks_per_second =  THEKERNEL->config->value(acceleration_ticks_per_second_checksum)->by_default(100   )->as_number();
+
+    // Steppers start off by default
+    this->turn_enable_pins_off();
+
     // Acceleration ticker
     this->acceleration_tick_hook = THEKERNEL->slow_ticker->attach( this->acceleration_ticks_per_second, this, &Stepper::trapezoid_generator_tick );
 
@@ -61,14 +66,9 @@ void Stepper::on_module_loaded(){
     THEKERNEL->robot->gamma_stepper_motor->attach(this, &Stepper::stepper_motor_finished_move );
 }
 
-// Get configuration from the config file
+// Get configuration from the config file, also on a reload while the machine may be moving
 void Stepper::on_config_reload(void* argument){
-
-    this->acceleration_ticks_per_second =  THEKERNEL->config->value(acceleration_ticks_per_second_checksum)->by_default(100   )->as_number();
     this->minimum_steps_per_second      =  THEKERNEL->config->value(minimum_steps_per_minute_checksum     )->by_default(3000  )->as_number() / 60.0F;
-
-    // Steppers start off by default
-    this->turn_enable_pins_off();
 }
 
 // When the play/pause button is set to pause, or a module calls the ON_PAUSE event
@@ -128,16 +128,18 @@ void Stepper::turn_enable_pins_off(){
 void Stepper::on_block_begin(void* argument){
     Block* block  = static_cast<Block*>(argument);
 
-    // The stepper does not care about 0-blocks
-    if( block->millimeters == 0.0F ){ return; }
-
-    // Mark the new block as of interrest to us
-    if( block->steps[ALPHA_STEPPER] > 0 || block->steps[BETA_STEPPER] > 0 || block->steps[GAMMA_STEPPER] > 0 ){
-        block->take();
-    }else{
+    // The stepper does not care about 0-blocks, or blocks without XYZ movement
+    if( block->millimeters == 0.0F || (block->steps[ALPHA_STEPPER] == 0 && block->steps[BETA_STEPPER] == 0 && block->steps[GAMMA_STEPPER] == 0) ){
+        // Outputs have no position to wait for, so make them now
+        for (BlockOutput& output : block->outputs) {
+            output.hook.call(output.argument);
+        }
         return;
     }
 
+    // Mark the new block as of interrest to us
+    block->take();
+
     // We can't move with the enable pins off
     if( this->enable_pins_status == false ){
         this->turn_enable_pins_on();
@@ -161,9 +163,17 @@ void Stepper::on_block_begin(void* argument){
     // Set the initial speed for this move
     this->trapezoid_generator_tick(0);
 
-    // Synchronise the acceleration curve with the stepping
+    // Synchronise the acceleration curve with the stepping, this attaches the deceleration signal so it goes first
     this->synchronize_acceleration(0);
 
+    // Outputs that must happen at a given position in this move are signaled by the main stepper, in the slots left
+    for (BlockOutput& output : block->outputs) {
+        unsigned int step = block->output_step(output);
+        if( step == 0 || !this->main_stepper->attach_signal_step(step, output.hook, output.argument) ){
+            output.hook.call(output.argument);
+        }
+    }
+
 }
 
 // Current block is discarded
@@ -273,7 +283,7 @@ void Stepper::set_step_events_per_second( float steps_per_second )
 // This function has the role of making sure acceleration and deceleration curves have their
 // rhythm synchronized. The accel/decel must start at the same moment as the speed update routine
 // This is caller in "step just occured" or "block just began" ( step Timer ) context, so we need to be fast.
-// All we do is reset the other timer so that it does what we want
+// All we do is ask the SlowTicker to call the acceleration tick right away
 uint32_t Stepper::synchronize_acceleration(uint32_t dummy){
 
     // No move was done, this is called from on_block_begin
@@ -284,21 +294,18 @@ uint32_t Stepper::synchronize_acceleration(uint32_t dummy){
         // Because it will set the initial rate
         // We also want to synchronize in case we start accelerating or decelerating now
 
-        // Accel interrupt must happen asap
-        NVIC_SetPendingIRQ(TIMER2_IRQn);
-        // Synchronize both counters
-        LPC_TIM2->TC = LPC_TIM0->TC;
+        // Accel interrupt must happen asap, and keep its rhythm from there
+        THEKERNEL->slow_ticker->fire_now(this->acceleration_tick_hook);
 
         // If we start decelerating after this, we must ask the actuator to warn us
         // so we can do what we do in the "else" bellow
+        // on_block_begin attaches this before the block's outputs, so there is always a signal left for it
         if( this->current_block->decelerate_after > 0 && this->current_block->decelerate_after < this->main_stepper->steps_to_move ){
             this->main_stepper->attach_signal_step(this->current_block->decelerate_after, this, &Stepper::synchronize_acceleration);
         }
     }else{
         // If we are called not at the first steps, this means we are beginning deceleration
-        NVIC_SetPendingIRQ(TIMER2_IRQn);
-        // Synchronize both counters
-        LPC_TIM2->TC = LPC_TIM0->TC;
+        THEKERNEL->slow_ticker->fire_now(this->acceleration_tick_hook);
     }
 
     return 0;
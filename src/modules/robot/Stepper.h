@@ -12,7 +12,6 @@
 #include <stdint.h>
 
 class Block;
-class Hook;
 class StepperMotor;
 
 class Stepper : public Module
@@ -64,7 +63,7 @@ private:
     bool paused;
     bool force_speed_update;
     bool enable_pins_status;
-    Hook *acceleration_tick_hook;
+    int acceleration_tick_hook;
 
     StepperMotor *main_stepper;
 
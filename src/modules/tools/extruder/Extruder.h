@@ -37,6 +37,7 @@ class Extruder : public Tool {
 
     private:
         void on_get_public_data(void* argument);
+        void load_pins();
         void update_steps_per_millimeter();
 
         Pin             step_pin;                     // Step pin for the stepper driver
@@ -20,6 +20,7 @@
 #include "checksumm.h"
 #include "ConfigValue.h"
 #include "libs/StreamOutput.h"
+#include "libs/Hook.h"
 
 #include "MRI_Hooks.h"
 
@@ -36,6 +37,10 @@
 #define    max_pwm_checksum             CHECKSUM("max_pwm")
 #define    output_on_command_checksum   CHECKSUM("output_on_command")
 #define    output_off_command_checksum  CHECKSUM("output_off_command")
+#define    output_lead_time_checksum    CHECKSUM("output_lead_time")
+
+// set in the argument passed to output_at_position when turning the output on, the pwm value is in the low bits
+#define    OUTPUT_ON_FLAG               (1 << 16)
 
 Switch::Switch() {}
 
@@ -56,20 +61,16 @@ void Switch::on_module_loaded()
     this->register_for_event(ON_SET_PUBLIC_DATA);
 
     // Settings
+    this->load_hardware_config();
     this->on_config_reload(this);
 }
 
 
-// Get config
-void Switch::on_config_reload(void *argument)
+// Get the pins, their startup state and the ticks that drive them, only once as the ticks use them from then on
+void Switch::load_hardware_config()
 {
     this->input_pin.from_string( THEKERNEL->config->value(switch_checksum, this->name_checksum, input_pin_checksum )->by_default("nc")->as_string())->as_input();
-    this->input_pin_behavior =   THEKERNEL->config->value(switch_checksum, this->name_checksum, input_pin_behavior_checksum )->by_default(momentary_checksum)->as_number();
-    std::string input_on_command =    THEKERNEL->config->value(switch_checksum, this->name_checksum, input_on_command_checksum )->by_default("")->as_string();
-    std::string input_off_command =   THEKERNEL->config->value(switch_checksum, this->name_checksum, input_off_command_checksum )->by_default("")->as_string();
     this->output_pin.from_string(THEKERNEL->config->value(switch_checksum, this->name_checksum, output_pin_checksum )->by_default("nc")->as_string())->as_output();
-    this->output_on_command =    THEKERNEL->config->value(switch_checksum, this->name_checksum, output_on_command_checksum )->by_default("")->as_string();
-    this->output_off_command =   THEKERNEL->config->value(switch_checksum, this->name_checksum, output_off_command_checksum )->by_default("")->as_string();
     this->switch_state =         THEKERNEL->config->value(switch_checksum, this->name_checksum, startup_state_checksum )->by_default(false)->as_bool();
     string type =                THEKERNEL->config->value(switch_checksum, this->name_checksum, output_type_checksum )->by_default("pwm")->as_string();
 
@@ -93,6 +94,30 @@ void Switch::on_config_reload(void *argument)
 
     set_low_on_debug(output_pin.port_number, output_pin.pin);
 
+    if(input_pin.connected()) {
+        // set to initial state
+        this->input_pin_state = this->input_pin.get();
+        // input pin polling
+        THEKERNEL->slow_ticker->attach( 100, this, &Switch::pinpoll_tick);
+    }
+
+    if(this->output_type == PWM && this->output_pin.connected()) {
+        // PWM
+        THEKERNEL->slow_ticker->attach(1000, &this->output_pin, &Pwm::on_tick);
+    }
+}
+
+// Get the commands and behaviour, also on a reload so it must leave the pins as they are
+// The pins, output type, max pwm and startup state need a reset to change
+void Switch::on_config_reload(void *argument)
+{
+    this->input_pin_behavior =   THEKERNEL->config->value(switch_checksum, this->name_checksum, input_pin_behavior_checksum )->by_default(momentary_checksum)->as_number();
+    std::string input_on_command =    THEKERNEL->config->value(switch_checksum, this->name_checksum, input_on_command_checksum )->by_default("")->as_string();
+    std::string input_off_command =   THEKERNEL->config->value(switch_checksum, this->name_checksum, input_off_command_checksum )->by_default("")->as_string();
+    this->output_on_command =    THEKERNEL->config->value(switch_checksum, this->name_checksum, output_on_command_checksum )->by_default("")->as_string();
+    this->output_off_command =   THEKERNEL->config->value(switch_checksum, this->name_checksum, output_off_command_checksum )->by_default("")->as_string();
+    this->output_lead_time =     THEKERNEL->config->value(switch_checksum, this->name_checksum, output_lead_time_checksum )->by_default(0)->as_number() / 1000.0F; // ms
+
     // Set the on/off command codes, Use GCode to do the parsing
     input_on_command_letter = 0;
     input_off_command_letter = 0;
@@ -117,18 +142,6 @@ void Switch::on_config_reload(void *argument)
             input_off_command_code = gc.m;
         }
     }
-
-    if(input_pin.connected()) {
-        // set to initial state
-        this->input_pin_state = this->input_pin.get();
-        // input pin polling
-        THEKERNEL->slow_ticker->attach( 100, this, &Switch::pinpoll_tick);
-    }
-
-    if(this->output_type == PWM && this->output_pin.connected()) {
-        // PWM
-        THEKERNEL->slow_ticker->attach(1000, &this->output_pin, &Pwm::on_tick);
-    }
 }
 
 bool Switch::match_input_on_gcode(const Gcode *gcode) const
@@ -148,10 +161,42 @@ void Switch::on_gcode_received(void *argument)
     Gcode *gcode = static_cast<Gcode *>(argument);
     // Add the gcode to the queue ourselves if we need it
     if (match_input_on_gcode(gcode) || match_input_off_gcode(gcode)) {
+        if (gcode->has_letter('D') && this->output_pin.connected()) {
+            // switch when the next move has travelled D mm, instead of before it starts
+            gcode->mark_as_taken();
+            uint32_t argument = 0;
+            if (match_input_on_gcode(gcode)) {
+                int v = this->switch_value;
+                if (this->output_type == PWM && gcode->has_letter('S')) {
+                    v = round(gcode->get_value('S') * output_pin.max_pwm() / 255.0);
+                }
+                argument = OUTPUT_ON_FLAG | (v & 0xFFFF);
+            }
+            Hook hook;
+            hook.attach(this, &Switch::output_at_position);
+            THEKERNEL->conveyor->append_output(gcode->get_value('D'), this->output_lead_time, hook, argument);
+            return;
+        }
         THEKERNEL->conveyor->append_gcode(gcode);
     }
 }
 
+// Called from the step interrupt when the move reaches the position given with D
+uint32_t Switch::output_at_position(uint32_t argument)
+{
+    this->switch_state = (argument & OUTPUT_ON_FLAG) != 0;
+    if (this->switch_state) {
+        if (this->output_type == PWM) {
+            this->output_pin.pwm(argument & 0xFFFF);
+        } else {
+            this->output_pin.set(true);
+        }
+    } else {
+        this->output_pin.set(false);
+    }
+    return 0;
+}
+
 // Turn pin on and off
 void Switch::on_gcode_execute(void *argument)
 {
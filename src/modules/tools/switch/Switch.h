@@ -31,8 +31,10 @@ class Switch : public Module {
         void on_get_public_data(void* argument);
         void on_set_public_data(void* argument);
         uint32_t pinpoll_tick(uint32_t dummy);
+        uint32_t output_at_position(uint32_t argument);
         enum OUTPUT_TYPE {PWM, DIGITAL};
     private:
+        void load_hardware_config();
         void flip();
         void send_gcode(string msg, StreamOutput* stream);
         bool match_input_on_gcode(const Gcode* gcode) const;
@@ -53,6 +55,7 @@ class Switch : public Module {
         Pwm       output_pin;
         string    output_on_command;
         string    output_off_command;
+        float     output_lead_time;
 };
 
 #endif // SWITCH_H
@@ -35,6 +35,7 @@ class TemperatureControl : public Module {
         friend class PID_Autotuner;
 
     private:
+        void load_hardware_config();
         uint32_t thermistor_read_tick(uint32_t dummy);
         void pid_process(float);
 
@@ -20,19 +20,27 @@ using namespace std;
 
 #define enable_checksum              CHECKSUM("enable")
 
-void TemperatureControlPool::load_tools(){
-
+void TemperatureControlPool::get_heater_list(vector<uint16_t> *list){
     vector<uint16_t> modules;
     THEKERNEL->config->get_module_list( &modules, temperature_control_checksum );
-    int cnt= 0;
     for( auto cs : modules ){
         // If module is enabled
         if( THEKERNEL->config->value(temperature_control_checksum, cs, enable_checksum )->as_bool() ){
-            TemperatureControl* controller = new TemperatureControl(cs, cnt++);
-            //controllers.push_back( controller );
-            THEKERNEL->add_module(controller);
+            list->push_back(cs);
         }
     }
+}
+
+void TemperatureControlPool::load_tools(){
+
+    vector<uint16_t> modules;
+    get_heater_list( &modules );
+    int cnt= 0;
+    for( auto cs : modules ){
+        TemperatureControl* controller = new TemperatureControl(cs, cnt++);
+        //controllers.push_back( controller );
+        THEKERNEL->add_module(controller);
+    }
 
     // no need to create one of these if no heaters defined
     if(cnt > 0) {
@@ -8,9 +8,15 @@
 #ifndef TEMPERATURECONTROLPOOL_H
 #define TEMPERATURECONTROLPOOL_H
 
+#include <stdint.h>
+#include <vector>
+
 class TemperatureControlPool {
     public:
         void load_tools();
+
+        // checksums of the enabled temperature controls, only while the config cache is loaded
+        static void get_heater_list(std::vector<uint16_t> *list);
 };
 
 
@@ -49,11 +49,11 @@ void TemperatureSwitch::on_module_loaded()
     }
 
     // settings
-    this->on_config_reload(this);
+    this->load_config();
 }
 
-// Get config
-void TemperatureSwitch::on_config_reload(void *argument)
+// Get config, only when loaded as it adds to the controller list and registers for events, so a change to it needs a reset
+void TemperatureSwitch::load_config()
 {
     // get the list of temperature controllers and remove any that fon't have designator == "T"
     vector<uint16_t> controller_list;  
@@ -27,10 +27,11 @@ class TemperatureSwitch : public Module
     public:
         TemperatureSwitch();
         void on_module_loaded();
-        void on_config_reload(void *argument);
         void on_second_tick(void *argument);
         
     private:
+        void load_config();
+
         // turn the switch on or off
         void set_switch(bool cooler_state);
         
@@ -33,6 +33,7 @@ void Touchprobe::on_module_loaded() {
         return;
     }
     this->probe_rate = 5;
+    this->logfile = NULL;
     // load settings
     this->on_config_reload(this);
     // register event-handlers
@@ -51,9 +52,13 @@ void Touchprobe::on_config_reload(void* argument){
 
     this->should_log = this->enabled = THEKERNEL->config->value( touchprobe_log_enable_checksum )->by_default(false)->as_bool();
     if( this->should_log){
-        this->filename = THEKERNEL->config->value(touchprobe_logfile_name_checksum)->by_default("/sd/probe_log.csv")->as_string();
+        string filename = THEKERNEL->config->value(touchprobe_logfile_name_checksum)->by_default("/sd/probe_log.csv")->as_string();
         this->mcode = THEKERNEL->config->value(touchprobe_log_rotate_mcode_checksum)->by_default(0)->as_int();
-        this->logfile = NULL;
+        // on a reload the open log is closed if it moved, on_idle opens the new one
+        if( this->logfile != NULL && filename != this->filename ){
+            this->flush_log();
+        }
+        this->filename = filename;
     }
 }
 
@@ -19,6 +19,7 @@
 #include "FileConfigSource.h"
 #include "ConfigValue.h"
 #include "ConfigCache.h"
+#include "Conveyor.h"
 
 #define CONF_NONE       0
 #define CONF_ROM        1
@@ -144,6 +145,14 @@ void Configurator::config_load_command( string parameters, StreamOutput *stream
         THEKERNEL->config->config_cache_clear();
         stream->printf( "config cache unloaded\r\n" );
 
+    } else if(source == "reload") {
+        // modules reconfigure pins and motion settings, so not while anything is moving
+        if(!THEKERNEL->conveyor->is_queue_empty()) {
+            stream->printf( "cannot reload the config while moves are queued\r\n" );
+            return;
+        }
+        THEKERNEL->config->reload_changed(stream);
+
     } else if(source == "dump") {
         THEKERNEL->config->config_cache_load();
         THEKERNEL->config->config_cache->dump(stream);
@@ -156,7 +165,7 @@ void Configurator::config_load_command( string parameters, StreamOutput *stream
         stream->printf( "checksum of %s = %02X %02X %02X\n", key.c_str(), cs[0], cs[1], cs[2]);
 
     } else {
-        stream->printf( "unsupported option: must be one of load|unload|dump|checksum\n" );
+        stream->printf( "unsupported option: must be one of load|unload|reload|dump|checksum\n" );
     }
 }
 
@@ -0,0 +1,302 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "DataLogger.h"
+
+#include "libs/Kernel.h"
+#include "libs/nuts_bolts.h"
+#include "libs/utils.h"
+#include "libs/SerialMessage.h"
+#include "libs/StreamOutput.h"
+#include "libs/StreamOutputPool.h"
+#include "SlowTicker.h"
+#include "Config.h"
+#include "ConfigValue.h"
+#include "checksumm.h"
+#include "PublicData.h"
+#include "modules/robot/Conveyor.h"
+#include "modules/robot/Robot.h"
+#include "modules/tools/temperaturecontrol/TemperatureControlPublicAccess.h"
+#include "modules/tools/temperaturecontrol/TemperatureControlPool.h"
+#include "platform_memory.h"
+#include "us_ticker_api.h"
+
+#include <string.h>
+
+#define data_logger_checksum            CHECKSUM("data_logger")
+#define enable_checksum                 CHECKSUM("enable")
+#define file_checksum                   CHECKSUM("file")
+#define rate_checksum                   CHECKSUM("rate")
+#define channels_checksum               CHECKSUM("channels")
+#define buffer_records_checksum         CHECKSUM("buffer_records")
+#define buffer_bank_checksum            CHECKSUM("buffer_bank")
+#define autostart_checksum              CHECKSUM("autostart")
+
+// FatFs only updates the directory entry on close, so the file is reopened every so many batches to keep the
+// size on the card close to what has been logged should the power go
+#define SYNC_BATCHES 16
+
+DataLogger::DataLogger()
+{
+    this->batch = NULL;
+    this->batched = 0;
+    this->pool = NULL;
+    this->file = NULL;
+    this->records_written = 0;
+    this->records_dropped = 0;
+    this->ticks = 0;
+    this->ticks_sampled = 0;
+}
+
+void DataLogger::on_module_loaded()
+{
+    if( !THEKERNEL->config->value( data_logger_checksum, enable_checksum )->by_default(false)->as_bool() ){
+        delete this;
+        return;
+    }
+
+    this->filename = THEKERNEL->config->value( data_logger_checksum, file_checksum )->by_default("/sd/datalog.bin")->as_string();
+    this->rate = THEKERNEL->config->value( data_logger_checksum, rate_checksum )->by_default(10)->as_number();
+    if( this->rate < 1 ) this->rate = 1;
+    if( this->rate > 100 ) this->rate = 100;
+
+    // channels are named in a comma separated list
+    string names = THEKERNEL->config->value( data_logger_checksum, channels_checksum )->by_default("temperature,planner,position")->as_string();
+    this->channels = 0;
+    while( !names.empty() ){
+        size_t pos = names.find(',');
+        string name = names.substr(0, pos);
+        names = (pos == string::npos) ? "" : names.substr(pos + 1);
+        // allow "temperature, planner" as well
+        size_t first = name.find_first_not_of(" \t");
+        if( first == string::npos ) continue;
+        name = name.substr(first, name.find_last_not_of(" \t") - first + 1);
+        if( name == "temperature" )   this->channels |= (1 << CHANNEL_TEMPERATURE);
+        else if( name == "planner" )  this->channels |= (1 << CHANNEL_PLANNER);
+        else if( name == "position" ) this->channels |= (1 << CHANNEL_POSITION);
+    }
+
+    // the heaters have to be found now, the config cache is cleared once everything is loaded
+    if( this->channels & (1 << CHANNEL_TEMPERATURE) ){
+        TemperatureControlPool::get_heater_list( &this->heaters );
+    }
+
+    // the ring and the batch live in the configured bank, or main memory if they do not fit there
+    this->ring_records = SpscRing<log_record_t>::round_length(THEKERNEL->config->value( data_logger_checksum, buffer_records_checksum )->by_default(64)->as_number());
+    this->pool = memory_bank_pool(THEKERNEL->config->value( data_logger_checksum, buffer_bank_checksum )->by_default("ahb0")->as_string());
+    log_record_t *records = NULL;
+    if( this->pool != NULL ){
+        records = (log_record_t *)this->pool->alloc(this->ring_records * record_size);
+        this->batch = (char *)this->pool->alloc(batch_size);
+        if( records == NULL || this->batch == NULL ){
+            if( records != NULL ) this->pool->dealloc(records);
+            if( this->batch != NULL ) this->pool->dealloc(this->batch);
+            records = NULL;
+            this->batch = NULL;
+            this->pool = NULL;
+        }
+    }
+    if( this->pool == NULL ){
+        records = new log_record_t[this->ring_records];
+        this->batch = new char[batch_size];
+    }
+    this->ring.attach(records, this->ring_records);
+
+    THEKERNEL->slow_ticker->attach( this->rate, this, &DataLogger::sample_tick );
+
+    this->register_for_event(ON_IDLE);
+    this->register_for_event(ON_CONSOLE_LINE_RECEIVED);
+
+    if( THEKERNEL->config->value( data_logger_checksum, autostart_checksum )->by_default(false)->as_bool() ){
+        this->start(this->filename, THEKERNEL->streams);
+    }
+}
+
+// Only counts, the sampling itself is done from on_idle where it is safe to ask the other modules
+uint32_t DataLogger::sample_tick(uint32_t dummy)
+{
+    this->ticks++;
+    return 0;
+}
+
+void DataLogger::on_idle(void* argument)
+{
+    if( this->file == NULL ) return;
+
+    // one sample however many ticks have gone by, a long wait just means a gap in the log
+    if( this->ticks != this->ticks_sampled ){
+        this->ticks_sampled = this->ticks;
+        this->take_samples();
+    }
+
+    // at most one write each time round
+    this->write_batch(false);
+}
+
+void DataLogger::take_samples()
+{
+    float v[6];
+
+    if( this->channels & (1 << CHANNEL_TEMPERATURE) ){
+        for( size_t i = 0; i < this->heaters.size(); i++ ){
+            void *returned_data;
+            if( PublicData::get_value( temperature_control_checksum, this->heaters[i], current_temperature_checksum, &returned_data ) ){
+                struct pad_temperature *t = static_cast<struct pad_temperature *>(returned_data);
+                v[0] = t->current_temperature;
+                v[1] = t->target_temperature;
+                v[2] = t->pwm;
+                this->add_record(CHANNEL_TEMPERATURE, i, v, 3);
+            }
+        }
+    }
+
+    if( this->channels & (1 << CHANNEL_PLANNER) ){
+        v[0] = THEKERNEL->conveyor->queue_size();
+        v[1] = THEKERNEL->conveyor->queue_capacity();
+        this->add_record(CHANNEL_PLANNER, 0, v, 2);
+    }
+
+    if( this->channels & (1 << CHANNEL_POSITION) ){
+        THEKERNEL->robot->get_axis_position(v);
+        this->add_record(CHANNEL_POSITION, 0, v, 3);
+    }
+}
+
+void DataLogger::add_record(uint8_t channel, uint8_t index, const float* values, uint8_t count)
+{
+    log_record_t *r = this->ring.head_ref();
+    if( this->ring.is_full() ){
+        this->records_dropped++;
+        return;
+    }
+
+    memset(r, 0, sizeof(log_record_t));
+    r->time = us_ticker_read();
+    r->channel = channel;
+    r->index = index;
+    r->count = count;
+    memcpy(r->value, values, count * sizeof(float));
+    this->ring.produce_head();
+}
+
+// Moves records into the batch and writes it once it is full, or whatever there is if all is set
+bool DataLogger::write_batch(bool all)
+{
+    log_record_t *first;
+    unsigned int n;
+    while( this->batched < batch_size && (n = this->ring.span(&first)) > 0 ){
+        unsigned int room = (batch_size - this->batched) / record_size;
+        if( n > room ) n = room;
+        memcpy(this->batch + this->batched, first, n * record_size);
+        this->batched += n * record_size;
+        this->ring.consume(n);
+    }
+
+    if( this->batched == 0 || (this->batched < batch_size && !all) ) return true;
+
+    if( fwrite(this->batch, 1, this->batched, this->file) != this->batched ){
+        THEKERNEL->streams->printf("Data logger: write to %s failed, stopped\r\n", this->filename.c_str());
+        fclose(this->file);
+        this->file = NULL;
+        this->batched = 0;
+        return false;
+    }
+    this->records_written += this->batched / record_size;
+    this->batched = 0;
+
+    if( (this->records_written % (SYNC_BATCHES * batch_size / record_size)) == 0 ){
+        fclose(this->file);
+        this->file = fopen(this->filename.c_str(), "a");
+        if( this->file == NULL ) return false;
+        setvbuf(this->file, NULL, _IONBF, 0);
+    }
+    return true;
+}
+
+bool DataLogger::start(const string& fn, StreamOutput* stream)
+{
+    if( this->file != NULL ) this->stop(stream);
+
+    this->file = fopen(fn.c_str(), "w");
+    if( this->file == NULL ){
+        stream->printf("Data logger: could not open %s\r\n", fn.c_str());
+        return false;
+    }
+    // the batches are whole sectors, stdio buffering would only copy them again
+    setvbuf(this->file, NULL, _IONBF, 0);
+
+    this->filename = fn;
+    this->ring.flush();
+    this->records_written = 0;
+    this->records_dropped = 0;
+
+    // the header takes the place of the first record, so every batch still ends on a sector boundary
+    memset(this->batch, 0, record_size);
+    memcpy(this->batch, "SDLG", 4);
+    uint16_t version = 1;
+    uint16_t size = record_size;
+    memcpy(this->batch + 4, &version, 2);
+    memcpy(this->batch + 6, &size, 2);
+    memcpy(this->batch + 8, &this->rate, 4);
+    memcpy(this->batch + 12, &this->channels, 4);
+    this->batched = record_size;
+
+    // name the heaters, so the decoder can tell them apart
+    for( size_t i = 0; i < this->heaters.size(); i++ ){
+        void *returned_data;
+        if( PublicData::get_value( temperature_control_checksum, this->heaters[i], current_temperature_checksum, &returned_data ) ){
+            float v[6];
+            memset(v, 0, sizeof(v));
+            strncpy((char *)v, static_cast<struct pad_temperature *>(returned_data)->designator.c_str(), sizeof(v) - 1);
+            this->add_record(CHANNEL_NAME, i, v, 6);
+        }
+    }
+
+    this->ticks_sampled = this->ticks;
+    stream->printf("Data logger: logging to %s at %luHz\r\n", fn.c_str(), this->rate);
+    return true;
+}
+
+void DataLogger::stop(StreamOutput* stream)
+{
+    if( this->file == NULL ) return;
+
+    this->write_batch(true);
+    // the ring may have held more than one batch
+    while( this->file != NULL && !this->ring.is_empty() ) this->write_batch(true);
+
+    if( this->file != NULL ){
+        fclose(this->file);
+        this->file = NULL;
+    }
+    stream->printf("Data logger: stopped, %lu records written, %lu dropped\r\n", this->records_written, this->records_dropped);
+}
+
+void DataLogger::on_console_line_received(void* argument)
+{
+    SerialMessage new_message = *static_cast<SerialMessage *>(argument);
+
+    // ignore comments and blank lines and if this is a G code then also ignore it
+    char first_char = new_message.message[0];
+    if(strchr(";( \n\rGMTN", first_char) != NULL) return;
+
+    string possible_command = new_message.message;
+    string cmd = shift_parameter(possible_command);
+    if( cmd != "datalog" ) return;
+
+    string what = shift_parameter(possible_command);
+    if( what == "start" ){
+        string fn = shift_parameter(possible_command);
+        this->start(fn.empty() ? this->filename : absolute_from_relative(fn), new_message.stream);
+    }else if( what == "stop" ){
+        this->stop(new_message.stream);
+    }else{
+        new_message.stream->printf("Data logger: %s, %s, %lu records written, %lu dropped, %u queued\r\n",
+                                   this->file != NULL ? "logging" : "stopped", this->filename.c_str(),
+                                   this->records_written, this->records_dropped, this->ring.size());
+    }
+}
@@ -0,0 +1,83 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DATALOGGER_H
+#define DATALOGGER_H
+
+#include "libs/Module.h"
+#include "SpscRing.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+class StreamOutput;
+class MemoryPool;
+
+/*
+ * The log file is a header followed by records, all 32 bytes and little endian, see smoothie-datalog.py
+ *
+ * header: "SDLG", uint16 version, uint16 record size, uint32 sample rate in Hz, uint32 channel mask, 16 bytes zero
+ * record: uint32 time in us (wraps), uint8 channel, uint8 index, uint8 value count, uint8 flags, 6 floats
+ */
+struct __attribute__ ((packed)) log_record_t {
+    uint32_t time;
+    uint8_t  channel;
+    uint8_t  index;
+    uint8_t  count;
+    uint8_t  flags;
+    float    value[6];
+};
+
+class DataLogger : public Module {
+    public:
+        DataLogger();
+
+        void on_module_loaded();
+        void on_idle(void* argument);
+        void on_console_line_received(void* argument);
+
+        // channels, also the bits of the channel mask
+        enum {
+            CHANNEL_NAME        = 0,    // index is a heater, the values hold its designator
+            CHANNEL_TEMPERATURE = 1,    // current, target, heater pwm
+            CHANNEL_PLANNER     = 2,    // blocks queued, queue capacity
+            CHANNEL_POSITION    = 3,    // x, y, z of the last planned move
+        };
+
+    private:
+        uint32_t sample_tick(uint32_t dummy);
+
+        bool start(const std::string& fn, StreamOutput* stream);
+        void stop(StreamOutput* stream);
+        void take_samples();
+        void add_record(uint8_t channel, uint8_t index, const float* values, uint8_t count);
+        bool write_batch(bool all);
+
+        static const uint16_t record_size = 32;
+        static const uint16_t batch_size = 2048;   // bytes per write, a multiple of the sector size
+
+        SpscRing<log_record_t> ring;               // samples not yet written
+        char* batch;                               // what goes into the next write
+        uint16_t batched;
+        MemoryPool* pool;                          // the bank the buffers came from, NULL for main memory
+
+        std::string filename;
+        FILE* file;
+        std::vector<uint16_t> heaters;             // checksums of the enabled temperature controls
+
+        uint32_t rate;
+        uint32_t channels;
+        uint32_t ring_records;
+        uint32_t records_written;
+        uint32_t records_dropped;
+        volatile uint32_t ticks;                   // counted by the SlowTicker
+        uint32_t ticks_sampled;
+};
+
+#endif
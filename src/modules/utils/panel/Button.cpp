@@ -9,8 +9,6 @@ Button::Button()
 {
     this->counter = 0;
     this->value = false;
-    this->up_hook = NULL;
-    this->down_hook = NULL;
     this->button_pin = NULL;
     this->repeat = false;
     this->first_timer = 0;
@@ -50,15 +48,15 @@ void Button::check_signal(int val)
 
     if ( start_value != this->value ) {
         if ( this->value ) {
-            if ( this->up_hook != NULL ) {
-                this->up_hook->call();
+            if ( this->up_hook.is_attached() ) {
+                this->up_hook.call();
                 this->first_timer = 0;
                 this->second_timer = 0;
                 this->repeat = false;
             }
         } else {
-            if ( this->down_hook != NULL ) {
-                this->down_hook->call();
+            if ( this->down_hook.is_attached() ) {
+                this->down_hook.call();
             }
         }
     }
@@ -68,7 +66,7 @@ void Button::check_signal(int val)
             if(this->repeat) {
                 this->second_timer++;
                 if(this->second_timer == 10) {
-                    this->up_hook->call();
+                    this->up_hook.call();
                     this->second_timer = 0;
                 }
             } else {
@@ -20,21 +20,19 @@ public:
 
     template<typename T> Button *up_attach( T *optr, uint32_t ( T::*fptr )( uint32_t ) )
     {
-        this->up_hook = new Hook();
-        this->up_hook->attach(optr, fptr);
+        this->up_hook.attach(optr, fptr);
         return this;
     }
 
     template<typename T> Button *down_attach( T *optr, uint32_t ( T::*fptr )( uint32_t ) )
     {
-        this->down_hook = new Hook();
-        this->down_hook->attach(optr, fptr);
+        this->down_hook.attach(optr, fptr);
         return this;
     }
 
 private:
-    Hook *up_hook;
-    Hook *down_hook;
+    Hook up_hook;
+    Hook down_hook;
     bool value;
     char counter;
     Pin *button_pin;
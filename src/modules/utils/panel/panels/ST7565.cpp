@@ -54,7 +54,7 @@ ST7565::ST7565() {
         mosi= P0_18; sclk= P0_15;
     }
 
-    this->spi= new mbed::SPI(mosi,NC,sclk);
+    this->spi= new ::SPI(mosi,NC,sclk);
     this->spi->frequency(THEKERNEL->config->value(panel_checksum, spi_frequency_checksum)->by_default(1000000)->as_number()); //4Mhz freq, can try go a little lower
 
     //chip select
@@ -96,9 +96,7 @@ ST7565::~ST7565() {
 void ST7565::send_commands(const unsigned char* buf, size_t size){
     cs.set(0);
     a0.set(0);
-    while(size-- >0){
-    	spi->write(*buf++);
-    }
+    spi->transfer(buf, NULL, size);
     cs.set(1);
 }
 
@@ -106,9 +104,8 @@ void ST7565::send_commands(const unsigned char* buf, size_t size){
 void ST7565::send_data(const unsigned char* buf, size_t size){
     cs.set(0);
     a0.set(1);
-    while(size-- >0){
-    	spi->write(*buf++);
-    }
+    // the framebuffer is in AHB0, so whole pages go out by DMA
+    spi->transfer(buf, NULL, size);
     cs.set(1);
     a0.set(0);
 }
@@ -11,6 +11,7 @@
 #include "LcdBase.h"
 #include "mbed.h"
 #include "libs/Pin.h"
+#include "libs/spi.h"
 
 class ST7565: public LcdBase {
 public:
@@ -51,7 +52,7 @@ public:
 private:
     //buffer
 	unsigned char *framebuffer;
-	mbed::SPI* spi;
+	::SPI* spi;
 	Pin cs;
 	Pin rst;
 	Pin a0;
@@ -138,24 +138,26 @@ static const uint8_t font5x8[] = {
 
 #define ST7920_CS()              {cs.set(1);wait_us(10);}
 #define ST7920_NCS()             {cs.set(0);wait_us(10);}
-#define ST7920_WRITE_BYTE(a)     {this->spi->write((a)&0xf0);this->spi->write((a)<<4);wait_us(10);}
-#define ST7920_WRITE_BYTES(p,l)  {uint8_t i;for(i=0;i<l;i++){this->spi->write(*p&0xf0);this->spi->write(*p<<4);p++;} wait_us(10); }
+#define ST7920_WRITE_BYTE(a)     {this->spi->write((a)&0xf0);this->spi->write(((a)<<4)&0xf0);wait_us(10);}
+#define ST7920_WRITE_BYTES(p,l)  {uint8_t i;for(i=0;i<l;i++){row[2*i]=*p&0xf0;row[2*i+1]=*p<<4;p++;} this->spi->transfer(row,NULL,2*(l)); wait_us(10); }
 #define ST7920_SET_CMD()         {this->spi->write(0xf8);wait_us(10);}
 #define ST7920_SET_DAT()         {this->spi->write(0xfa);wait_us(10);}
 #define PAGE_HEIGHT 32  //512 byte framebuffer
 #define WIDTH 128
 #define HEIGHT 64
 #define FB_SIZE WIDTH*HEIGHT/8
+#define ROW_SIZE WIDTH/8*2
 
 RrdGlcd::RrdGlcd(PinName mosi, PinName sclk, Pin cs) {
-    this->spi= new mbed::SPI(mosi, NC, sclk);
+    this->spi= new ::SPI(mosi, NC, sclk);
      //chip select
     this->cs= cs;
     this->cs.set(0);
-    fb= (uint8_t *)AHB0.alloc(FB_SIZE); // grab some memoery from USB_RAM
+    fb= (uint8_t *)AHB0.alloc(FB_SIZE + ROW_SIZE); // grab some memoery from USB_RAM, where the DMA can reach the row buffer
     if(fb == NULL) {
         THEKERNEL->streams->printf("Not enough memory available for frame buffer");
     }
+    row= fb + FB_SIZE;
     inited= false;
     dirty= false;
 }
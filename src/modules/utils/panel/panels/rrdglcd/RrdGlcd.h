@@ -17,6 +17,7 @@
 #include "libs/Kernel.h"
 #include "libs/utils.h"
 #include <libs/Pin.h>
+#include "libs/spi.h"
 
 
 class RrdGlcd {
@@ -53,11 +54,12 @@ public:
 
 private:
     Pin cs;
-    mbed::SPI* spi;
+    ::SPI* spi;
     void renderChar(uint8_t *fb, char c, int ox, int oy);
     void displayChar(int row, int column,char inpChr);
 
     uint8_t *fb;
+    uint8_t *row; // one line of the frame buffer split into the nibbles the ST7920 wants
     bool inited;
     bool dirty;
 };
@@ -16,6 +16,7 @@
 #include "libs/SerialMessage.h"
 #include "StreamOutput.h"
 #include "DirHandle.h"
+#include "DirectoryIndex.h"
 #include "mri.h"
 
 using namespace std;
@@ -101,7 +102,7 @@ void FileScreen::clicked_line(uint16_t line)
             path = "";
         }
         path = path + "/" + this->file_at( line - 1 );
-        if ( this->is_a_folder( path ) ) {
+        if ( this->is_a_folder( line - 1 ) ) {
             this->enter_folder(path);
             return;
         }
@@ -114,64 +115,36 @@ void FileScreen::clicked_line(uint16_t line)
 }
 
 // Check wether a line is a folder or a file
-bool FileScreen::is_a_folder( string path )
+bool FileScreen::is_a_folder( uint16_t line )
 {
-    // In the special case of /local/ ( the mbed flash chip ) we don't have sub-folders, everything is a file
-    if ( path.substr(0, 7).compare("/local/") == 0 ) {
+    DirectoryIndex *index = THEKERNEL->directory_index;
+    if ( !index->load(this->current_folder) || line >= index->count() ) {
         return false;
     }
-    // Else, check if it's a folder or not
-    DIR *d;
-    d = opendir(path.c_str());
-    if (d == NULL) {
-        return false;
-    } else {
-        closedir(d);
-        return true;
-    }
+    return index->is_folder(line);
 }
 
 // Find the "line"th file in the current folder
 string FileScreen::file_at(uint16_t line)
 {
-    DIR *d;
-    struct dirent *p;
-    uint16_t count = 0;
-    d = opendir(this->current_folder.c_str());
-    if (d != NULL) {
-        while ((p = readdir(d)) != NULL) {
-            if ( count == line ) {
-                string to_return =  lc(string(p->d_name));
-                //printf("line: %u string:%s\r\n", line, to_return.c_str());
-                //if( to_return[to_return.length()-1] == '.' ){ to_return[to_return.length()-1] = 0x00; }
-                closedir(d);
-                return to_return;
-            }
-            count++;
-        }
+    // the listing is read once and kept, rather than walking the folder for every line shown
+    DirectoryIndex *index = THEKERNEL->directory_index;
+    if ( !index->load(this->current_folder) || line >= index->count() ) {
+        return "";
     }
-
-    if (d != NULL) closedir(d);
-    return "";
+    return lc(string(index->name(line)));
 }
 
 // Count how many files there are in the current folder
 uint16_t FileScreen::count_folder_content(std::string folder)
 {
-    DIR *d;
-    struct dirent *p;
-    uint16_t count = 0;
-    d = opendir(folder.c_str());
-    if (d != NULL) {
-        while ((p = readdir(d)) != NULL) {
-            count++;
-        }
-        closedir(d);
-        return count;
-    } else {
+    DirectoryIndex *index = THEKERNEL->directory_index;
+    if ( !index->load(folder) ) {
         return 0;
     }
+    return index->count();
 }
+
 void FileScreen::on_main_loop()
 {
     if (this->start_play) {
@@ -21,12 +21,25 @@
 #include "ConfigValue.h"
 
 #include "modules/robot/Conveyor.h"
+#include "modules/robot/Robot.h"
+#include "modules/tools/temperaturecontrol/TemperatureControlPublicAccess.h"
+#include "modules/tools/temperaturecontrol/TemperatureControlPool.h"
+#include "PublicData.h"
+#include "Hook.h"
 #include "DirHandle.h"
 #include "PublicDataRequest.h"
 #include "PlayerPublicAccess.h"
+#include "platform_memory.h"
 
 #define on_boot_gcode_checksum          CHECKSUM("on_boot_gcode")
 #define on_boot_gcode_enable_checksum   CHECKSUM("on_boot_gcode_enable")
+#define player_buffer_bank_checksum     CHECKSUM("player_buffer_bank")
+#define player_buffer_size_checksum     CHECKSUM("player_buffer_size")
+#define player_checkpoint_file_checksum     CHECKSUM("player_checkpoint_file")
+#define player_checkpoint_interval_checksum CHECKSUM("player_checkpoint_interval")
+
+// how far above the checkpointed height the head travels back to where the job stopped
+#define RESUME_LIFT_MM 5.0F
 
 void Player::on_module_loaded()
 {
@@ -42,8 +55,58 @@ void Player::on_module_loaded()
 
     this->on_boot_gcode = THEKERNEL->config->value(on_boot_gcode_checksum)->by_default("/sd/on_boot.gcode")->as_string();
     this->on_boot_gcode_enable = THEKERNEL->config->value(on_boot_gcode_enable_checksum)->by_default(true)->as_bool();
+    this->buffer_pool = memory_bank_pool(THEKERNEL->config->value(player_buffer_bank_checksum)->by_default("main")->as_string());
+    this->buffer_size = THEKERNEL->config->value(player_buffer_size_checksum)->by_default(1024)->as_number();
+    this->buffer = NULL;
     this->elapsed_secs = 0;
     this->reply_stream = NULL;
+
+    this->checkpoint_file = THEKERNEL->config->value(player_checkpoint_file_checksum)->by_default("/sd/checkpoint.bin")->as_string();
+    this->checkpoint_interval = THEKERNEL->config->value(player_checkpoint_interval_checksum)->by_default(30)->as_number();
+    this->last_checkpoint_secs = 0;
+    this->resuming = NULL;
+    this->marker_seq = 0;
+    this->marker_reached = 0;
+    this->marker_pending = false;
+    this->checkpoint_started = false;
+    this->checkpointing = false;
+    this->feeding = false;
+    this->digesting = false;
+    this->e_position = 0;
+    this->e_absolute = true;
+
+    // the heaters have to be found now, the config cache is cleared once everything is loaded
+    TemperatureControlPool::get_heater_list( &this->heaters );
+    if( this->heaters.size() > CHECKPOINT_HEATERS ) this->heaters.resize(CHECKPOINT_HEATERS);
+}
+
+// Open the file to play, with its read ahead buffer in the configured bank instead of the one stdio mallocs
+FILE *Player::open_file(const string& fn)
+{
+    // a new job, so whatever was being tracked for the last one is no use
+    this->checkpoint_started = false;
+    this->digest.start();
+    this->digesting = true;
+    this->checkpointing = false;
+    this->marker_pending = false;
+    this->e_position = 0;
+    this->e_absolute = true;
+
+    FILE *fp = fopen(fn.c_str(), "r");
+    if(fp != NULL && this->buffer_pool != NULL) {
+        this->buffer = (char *)this->buffer_pool->alloc(this->buffer_size);
+        if(this->buffer != NULL) setvbuf(fp, this->buffer, _IOFBF, this->buffer_size);
+    }
+    return fp;
+}
+
+void Player::close_file()
+{
+    fclose(this->current_file_handler);
+    if(this->buffer != NULL) {
+        this->buffer_pool->dealloc(this->buffer);
+        this->buffer = NULL;
+    }
 }
 
 void Player::on_second_tick(void *)
@@ -54,6 +117,8 @@ void Player::on_second_tick(void *)
 void Player::on_gcode_received(void *argument)
 {
     Gcode *gcode = static_cast<Gcode *>(argument);
+    if (this->feeding) track_gcode(gcode);
+
     string args = get_arguments(gcode->get_command());
     if (gcode->has_m) {
         if (gcode->m == 21) { // Dummy code; makes Octoprint happy -- supposed to initialize SD card
@@ -68,9 +133,9 @@ void Player::on_gcode_received(void *argument)
 
             if(this->current_file_handler != NULL) {
                 this->playing_file = false;
-                fclose(this->current_file_handler);
+                close_file();
             }
-            this->current_file_handler = fopen( this->filename.c_str(), "r");
+            this->current_file_handler = open_file(this->filename.c_str());
 
             if(this->current_file_handler == NULL) {
                 gcode->stream->printf("file.open failed: %s\r\n", this->filename.c_str());
@@ -118,7 +183,7 @@ void Player::on_gcode_received(void *argument)
 
                 if(!currentfn.empty()) {
                     // reload the last file opened
-                    this->current_file_handler = fopen(currentfn.c_str() , "r");
+                    this->current_file_handler = open_file(currentfn.c_str());
 
                     if(this->current_file_handler == NULL) {
                         gcode->stream->printf("file.open failed: %s\r\n", currentfn.c_str());
@@ -145,10 +210,10 @@ void Player::on_gcode_received(void *argument)
 
             if(this->current_file_handler != NULL) {
                 this->playing_file = false;
-                fclose(this->current_file_handler);
+                close_file();
             }
 
-            this->current_file_handler = fopen( this->filename.c_str(), "r");
+            this->current_file_handler = open_file(this->filename.c_str());
             if(this->current_file_handler == NULL) {
                 gcode->stream->printf("file.open failed: %s\r\n", this->filename.c_str());
             } else {
@@ -177,8 +242,10 @@ void Player::on_console_line_received( void *argument )
         this->play_command( possible_command, new_message.stream );
     }else if (cmd == "progress"){
         this->progress_command( possible_command, new_message.stream );
-    }else if (cmd == "abort")
+    }else if (cmd == "abort"){
         this->abort_command( possible_command, new_message.stream );
+    }else if (cmd == "resume")
+        this->resume_command( possible_command, new_message.stream );
 }
 
 // Play a gcode file by considering each line as if it was received on the serial console
@@ -195,10 +262,10 @@ void Player::play_command( string parameters, StreamOutput *stream )
     }
 
     if(this->current_file_handler != NULL) { // must have been a paused print
-        fclose(this->current_file_handler);
+        close_file();
     }
 
-    this->current_file_handler = fopen( this->filename.c_str(), "r");
+    this->current_file_handler = open_file(this->filename.c_str());
     if(this->current_file_handler == NULL) {
         stream->printf("File not found: %s\r\n", this->filename.c_str());
         return;
@@ -283,10 +350,18 @@ void Player::abort_command( string parameters, StreamOutput *stream )
     playing_file = false;
     played_cnt = 0;
     file_size = 0;
+    this->digesting = false;
     this->filename = "";
     this->current_stream = NULL;
-    fclose(current_file_handler);
+    close_file();
     current_file_handler = NULL;
+    // the checkpoint is left as it is, so the job can still be resumed
+    this->checkpointing = false;
+    this->marker_pending = false;
+    if(this->resuming != NULL) {
+        delete this->resuming;
+        this->resuming = NULL;
+    }
     stream->printf("Aborted playing or paused file\r\n");
 }
 
@@ -301,12 +376,48 @@ void Player::on_main_loop(void *argument)
         }
     }
 
+    if( this->resuming != NULL ) {
+        // wait for the heaters before moving back to the job
+        for (int i = 0; i < CHECKPOINT_HEATERS; i++) {
+            if(this->resuming->heater[i] == 0 || this->resuming->target[i] <= 0) continue;
+            void *returned_data;
+            if(PublicData::get_value( temperature_control_checksum, this->resuming->heater[i], current_temperature_checksum, &returned_data )) {
+                struct pad_temperature *t = static_cast<struct pad_temperature *>(returned_data);
+                if(t->current_temperature < this->resuming->target[i] - 1.0F) return;
+            }
+        }
+        finish_resume();
+    }
+
+    // the last line queued behind a marker has been executed, so the state taken then can be saved
+    if( this->marker_pending && this->marker_reached == this->marker_seq ) {
+        this->marker_pending = false;
+        if(this->checkpointing) write_checkpoint(&this->pending);
+    }
+
     if( this->playing_file ) {
         char buf[130]; // lines upto 128 characters are allowed, anything longer is discarded
         bool discard = false;
 
+        // preallocate the checkpoint file, so saving a checkpoint never has to grow it
+        if( !this->checkpoint_started ) {
+            this->checkpoint_started = true;
+            this->last_checkpoint_secs = this->elapsed_secs;
+            if( this->checkpoint_interval > 0 && this->filename != this->on_boot_gcode ) {
+                FILE *fp = fopen(this->checkpoint_file.c_str(), "w");
+                if(fp != NULL) {
+                    checkpoint_t empty;
+                    memset(&empty, 0, sizeof(empty));
+                    this->checkpointing = fwrite(&empty, sizeof(empty), 1, fp) == 1;
+                    fclose(fp);
+                }
+            }
+        }
+
         while(fgets(buf, sizeof(buf), this->current_file_handler) != NULL) {
             int len = strlen(buf);
+            // every byte read goes into the digest, skipped lines too
+            if(this->digesting) this->digest.update(buf, len);
             if(len == 0) continue; // empty line? should not be possible
             if(buf[len - 1] == '\n' || feof(this->current_file_handler)) {
                 if(discard) { // we are discarding a long line
@@ -321,8 +432,14 @@ void Player::on_main_loop(void *argument)
                 message.stream = this->current_stream;
 
                 // waits for the queue to have enough room
+                this->feeding = true;
                 THEKERNEL->call_event(ON_CONSOLE_LINE_RECEIVED, &message);
+                this->feeding = false;
                 played_cnt += len;
+
+                if(this->checkpointing && !this->marker_pending && this->elapsed_secs - this->last_checkpoint_secs >= this->checkpoint_interval) {
+                    queue_checkpoint();
+                }
                 return; // we feed one line per main loop
 
             } else {
@@ -332,17 +449,36 @@ void Player::on_main_loop(void *argument)
             }
         }
 
+        if(this->checkpointing) {
+            // nothing left to resume
+            checkpoint_t cp;
+            memset(&cp, 0, sizeof(cp));
+            cp.done = 1;
+            write_checkpoint(&cp);
+            this->checkpointing = false;
+            this->marker_pending = false;
+        }
+
+        // a file read all the way through, so the digest is of all of it
+        bool digested = this->digesting && this->digest.get_size() == file_size;
+        if(digested) this->digest.finish(this->filename);
+        this->digesting = false;
+
         this->playing_file = false;
         this->filename = "";
         played_cnt = 0;
         file_size = 0;
-        fclose(this->current_file_handler);
+        close_file();
         current_file_handler = NULL;
         this->current_stream = NULL;
 
         if(this->reply_stream != NULL) {
             // if we were printing from an M command from pronterface we need to send this back
-            this->reply_stream->printf("Done printing file\r\n");
+            if(digested) {
+                this->reply_stream->printf("Done printing file, %lu bytes, crc32 %08lx, md5 %s\r\n", this->digest.get_size(), this->digest.get_crc(), this->digest.get_md5());
+            } else {
+                this->reply_stream->printf("Done printing file\r\n");
+            }
             this->reply_stream = NULL;
         }
     }
@@ -383,3 +519,198 @@ void Player::on_set_public_data(void *argument)
         pdr->set_taken();
     }
 }
+
+// Follows the extruder position through the lines played, the extruder itself only knows it as they are executed
+void Player::track_gcode(Gcode *gcode)
+{
+    if (gcode->has_g) {
+        if (gcode->g == 90) {
+            this->e_absolute = true;
+        } else if (gcode->g == 91) {
+            this->e_absolute = false;
+        } else if (gcode->g == 92) {
+            if (gcode->has_letter('E')) {
+                this->e_position = gcode->get_value('E');
+            } else if (gcode->get_num_args() == 0) {
+                this->e_position = 0;
+            }
+        } else if ((gcode->g == 0 || gcode->g == 1) && gcode->has_letter('E')) {
+            if (this->e_absolute) {
+                this->e_position = gcode->get_value('E');
+            } else {
+                this->e_position += gcode->get_value('E');
+            }
+        }
+
+    } else if (gcode->has_m) {
+        if (gcode->m == 82) {
+            this->e_absolute = true;
+        } else if (gcode->m == 83) {
+            this->e_absolute = false;
+        }
+    }
+}
+
+// Takes the state after the line just played, and queues a marker behind it. Only once the marker is reached, ie
+// everything up to that line has really been executed, is the state written out, so a resume never skips a line
+// that was planned but not yet moved.
+void Player::queue_checkpoint()
+{
+    checkpoint_t *cp = &this->pending;
+    memset(cp, 0, sizeof(checkpoint_t));
+
+    cp->offset = ftell(this->current_file_handler);
+    cp->elapsed_secs = this->elapsed_secs;
+
+    float position[3], offset[3];
+    THEKERNEL->robot->get_axis_position(position);
+    THEKERNEL->robot->get_tool_offset(offset);
+    for (int i = 0; i < 3; i++) cp->position[i] = position[i] - offset[i];
+
+    cp->feed_rate = THEKERNEL->robot->get_feed_rate();
+    cp->seek_rate = THEKERNEL->robot->get_seek_rate();
+    cp->e_position = this->e_position;
+    if (THEKERNEL->robot->absolute_mode) cp->flags |= CHECKPOINT_ABSOLUTE;
+    if (this->e_absolute) cp->flags |= CHECKPOINT_E_ABSOLUTE;
+    if (THEKERNEL->robot->is_inch_mode()) cp->flags |= CHECKPOINT_INCH;
+
+    Hook hook;
+    hook.attach(this, &Player::checkpoint_reached);
+    THEKERNEL->conveyor->append_output(0, 0, hook, ++this->marker_seq);
+    this->marker_pending = true;
+    this->last_checkpoint_secs = this->elapsed_secs;
+}
+
+// Called from the step interrupt when the block after the marked line begins
+uint32_t Player::checkpoint_reached(uint32_t seq)
+{
+    this->marker_reached = seq;
+    return 0;
+}
+
+// Overwrites the checkpoint in place, adding what is the same for every checkpoint of the job
+bool Player::write_checkpoint(checkpoint_t *cp)
+{
+    memcpy(cp->magic, "SCKP", 4);
+    cp->version = 1;
+    cp->file_size = this->file_size;
+    strncpy(cp->filename, this->filename.c_str(), sizeof(cp->filename) - 1);
+
+    // the heaters are as they are now, which is when the marked line has been executed
+    for (size_t i = 0; i < this->heaters.size() && !cp->done; i++) {
+        void *returned_data;
+        if (PublicData::get_value( temperature_control_checksum, this->heaters[i], current_temperature_checksum, &returned_data )) {
+            cp->heater[i] = this->heaters[i];
+            cp->target[i] = static_cast<struct pad_temperature *>(returned_data)->target_temperature;
+        }
+    }
+
+    FILE *fp = fopen(this->checkpoint_file.c_str(), "r+");
+    if (fp == NULL) return false;
+    bool ok = fwrite(cp, sizeof(checkpoint_t), 1, fp) == 1;
+    fclose(fp);
+    return ok;
+}
+
+// Carry on with a job from its last checkpoint, after heating back up and moving to where it was
+// The machine has to have been homed first
+void Player::resume_command( string parameters, StreamOutput *stream )
+{
+    if(this->playing_file || this->resuming != NULL) {
+        stream->printf("Currently printing, abort print first\r\n");
+        return;
+    }
+
+    string fn = shift_parameter( parameters );
+    fn = fn.empty() ? this->checkpoint_file : absolute_from_relative(fn);
+
+    checkpoint_t cp;
+    FILE *fp = fopen(fn.c_str(), "r");
+    bool ok = fp != NULL && fread(&cp, sizeof(cp), 1, fp) == 1;
+    if(fp != NULL) fclose(fp);
+    if(!ok || memcmp(cp.magic, "SCKP", 4) != 0 || cp.version != 1 || cp.done) {
+        stream->printf("No job to resume in %s\r\n", fn.c_str());
+        return;
+    }
+    cp.filename[sizeof(cp.filename) - 1] = 0;
+
+    if(this->current_file_handler != NULL) { // must have been a paused print
+        close_file();
+    }
+
+    this->current_file_handler = open_file(cp.filename);
+    if(this->current_file_handler == NULL) {
+        stream->printf("File not found: %s\r\n", cp.filename);
+        return;
+    }
+
+    // the offset is only good for the file as it was
+    if(fseek(this->current_file_handler, 0, SEEK_END) != 0 || (unsigned long)ftell(this->current_file_handler) != cp.file_size ||
+       fseek(this->current_file_handler, cp.offset, SEEK_SET) != 0) {
+        stream->printf("%s has changed since the checkpoint, can not resume\r\n", cp.filename);
+        close_file();
+        this->current_file_handler = NULL;
+        return;
+    }
+
+    this->filename = cp.filename;
+    this->file_size = cp.file_size;
+    this->played_cnt = cp.offset;
+    this->elapsed_secs = cp.elapsed_secs;
+    // the lines before the checkpoint are never read, so there is no digest of the file this time
+    this->digesting = false;
+    this->current_stream = &(StreamOutput::NullStream);
+
+    // carry on checkpointing into the same file
+    this->checkpoint_started = true;
+    this->checkpointing = this->checkpoint_interval > 0 && fn == this->checkpoint_file;
+
+    for (int i = 0; i < CHECKPOINT_HEATERS; i++) {
+        float target = cp.target[i];
+        if(cp.heater[i] != 0 && target > 0) {
+            PublicData::set_value( temperature_control_checksum, cp.heater[i], &target );
+        }
+    }
+
+    this->resuming = new checkpoint_t(cp);
+    stream->printf("Resuming %s at byte %lu/%lu once the heaters are up to temperature\r\n", cp.filename, (unsigned long)cp.offset, (unsigned long)cp.file_size);
+}
+
+// Puts the machine back as it was at the checkpoint, and starts playing from there
+void Player::finish_resume()
+{
+    checkpoint_t *cp = this->resuming;
+    this->resuming = NULL;
+
+    char buf[64];
+    auto send = [&buf]() {
+        struct SerialMessage message = { &(StreamOutput::NullStream), buf };
+        THEKERNEL->call_event(ON_CONSOLE_LINE_RECEIVED, &message);
+    };
+
+    // positions and rates were saved in millimeters, come back down onto the job from above it
+    snprintf(buf, sizeof(buf), "G21 G90");
+    send();
+    snprintf(buf, sizeof(buf), "G0 Z%1.4f F%1.4f", cp->position[Z_AXIS] + RESUME_LIFT_MM, cp->seek_rate);
+    send();
+    snprintf(buf, sizeof(buf), "G0 X%1.4f Y%1.4f", cp->position[X_AXIS], cp->position[Y_AXIS]);
+    send();
+    snprintf(buf, sizeof(buf), "G0 Z%1.4f", cp->position[Z_AXIS]);
+    send();
+    snprintf(buf, sizeof(buf), "G92 E%1.5f", cp->e_position);
+    send();
+    snprintf(buf, sizeof(buf), "G1 F%1.4f", cp->feed_rate);
+    send();
+    // G90 and G91 switch the extruder too, so its own mode goes after
+    snprintf(buf, sizeof(buf), "%s %s %s", (cp->flags & CHECKPOINT_ABSOLUTE) ? "G90" : "G91",
+             (cp->flags & CHECKPOINT_E_ABSOLUTE) ? "M82" : "M83", (cp->flags & CHECKPOINT_INCH) ? "G20" : "G21");
+    send();
+
+    this->e_position = cp->e_position;
+    this->e_absolute = (cp->flags & CHECKPOINT_E_ABSOLUTE) != 0;
+    this->last_checkpoint_secs = this->elapsed_secs;
+    delete cp;
+
+    this->playing_file = true;
+    THEKERNEL->streams->printf("Resumed %s\r\n", this->filename.c_str());
+}
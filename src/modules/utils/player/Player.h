@@ -10,12 +10,44 @@
 #define PLAYER_H
 
 #include "Module.h"
+#include "FileDigest.h"
 
 #include <stdio.h>
+#include <stdint.h>
 #include <string>
+#include <vector>
 using std::string;
 
 class StreamOutput;
+class MemoryPool;
+class Gcode;
+
+#define CHECKPOINT_HEATERS 4
+
+/*
+ * What is needed to carry on with a job from the first line that has not been executed yet, written over and over
+ * to the same preallocated file while playing, see Player::queue_checkpoint()
+ */
+struct __attribute__ ((packed)) checkpoint_t {
+    char     magic[4];                          // "SCKP", anything else means there is nothing to resume
+    uint16_t version;
+    uint8_t  done;                              // the job finished
+    uint8_t  flags;                             // CHECKPOINT_* below
+    uint32_t file_size;                         // of the job, to notice if it was changed since
+    uint32_t offset;                            // where the first line not yet executed starts
+    uint32_t elapsed_secs;
+    float    position[3];                       // in millimeters, as the gcode gave it ( without the tool offset )
+    float    feed_rate;                         // mm/min
+    float    seek_rate;                         // mm/min
+    float    e_position;
+    uint16_t heater[CHECKPOINT_HEATERS];        // name checksums of the temperature controls, 0 if unused
+    float    target[CHECKPOINT_HEATERS];
+    char     filename[128];
+};
+
+#define CHECKPOINT_ABSOLUTE   0x01              // G90
+#define CHECKPOINT_E_ABSOLUTE 0x02              // M82
+#define CHECKPOINT_INCH       0x04              // G20
 
 class Player : public Module {
     public:
@@ -33,6 +65,15 @@ class Player : public Module {
         void play_command( string parameters, StreamOutput* stream );
         void progress_command( string parameters, StreamOutput* stream );
         void abort_command( string parameters, StreamOutput* stream );
+        void resume_command( string parameters, StreamOutput* stream );
+        FILE *open_file(const string& fn);
+        void close_file();
+
+        void track_gcode(Gcode *gcode);
+        void queue_checkpoint();
+        uint32_t checkpoint_reached(uint32_t seq);
+        bool write_checkpoint(checkpoint_t *cp);
+        void finish_resume();
 
         string filename;
 
@@ -43,8 +84,29 @@ class Player : public Module {
         StreamOutput* current_stream;
         StreamOutput* reply_stream;
         FILE* current_file_handler;
+        MemoryPool* buffer_pool;        // where the read ahead buffer goes, NULL to leave it to stdio
+        char* buffer;
+        unsigned int buffer_size;
         unsigned long file_size, played_cnt;
         unsigned long elapsed_secs;
+        FileDigest digest;              // of the file as it is read, when played from the start
+        bool digesting;
+
+        // checkpointing, see queue_checkpoint()
+        string checkpoint_file;
+        unsigned long checkpoint_interval;      // seconds, 0 to disable
+        unsigned long last_checkpoint_secs;
+        std::vector<uint16_t> heaters;
+        checkpoint_t pending;                   // state after the line the marker was queued behind
+        checkpoint_t* resuming;                 // what resume is heating up for, NULL otherwise
+        uint32_t marker_seq;
+        volatile uint32_t marker_reached;       // set from the step interrupt
+        float e_position;                       // of the lines played so far, the extruder's own only changes as they execute
+        bool e_absolute;
+        bool marker_pending;
+        bool checkpoint_started;                // the checkpoint file has been set up for this job, or can not be
+        bool checkpointing;                     // the checkpoint file is ready for this job
+        bool feeding;                           // a line from the file is being dispatched
 };
 
 #endif // PLAYER_H
@@ -13,11 +13,14 @@
 #include "libs/SerialMessage.h"
 #include "libs/StreamOutput.h"
 #include "modules/robot/Conveyor.h"
+#include "SlowTicker.h"
 #include "DirHandle.h"
 #include "mri.h"
 #include "version.h"
 #include "PublicDataRequest.h"
 #include "FileStream.h"
+#include "DirectoryIndex.h"
+#include "FileDigest.h"
 #include "checksumm.h"
 #include "PublicData.h"
 #include "Gcode.h"
@@ -26,10 +29,12 @@
 #include "modules/robot/RobotPublicAccess.h"
 #include "NetworkPublicAccess.h"
 #include "platform_memory.h"
+#include "HeapReport.h"
 #include "SwitchPublicAccess.h"
 
 #include "system_LPC17xx.h"
 #include "LPC17xx.h"
+#include "us_ticker_api.h"
 
 extern unsigned int g_maximumHeapAddress;
 
@@ -56,6 +61,10 @@ const SimpleShell::ptentry_t SimpleShell::commands_table[] = {
     {"?",        SimpleShell::help_command},
     {"version",  SimpleShell::version_command},
     {"mem",      SimpleShell::mem_command},
+    {"profile",  SimpleShell::profile_command},
+    {"sdbench",  SimpleShell::sdbench_command},
+    {"tickbench", SimpleShell::tickbench_command},
+    {"digest",   SimpleShell::digest_command},
     {"get",      SimpleShell::get_command},
     {"set_temp", SimpleShell::set_temp_command},
     {"switch",   SimpleShell::switch_command},
@@ -70,7 +79,7 @@ const SimpleShell::ptentry_t SimpleShell::commands_table[] = {
 int SimpleShell::reset_delay_secs= 0;
 
 // Adam Greens heap walk from http://mbed.org/forum/mbed/topic/2701/?page=4#comment-22556
-static uint32_t heapWalk(StreamOutput *stream, bool verbose)
+static uint32_t heapWalk(StreamOutput *stream, bool verbose, uint32_t *largestFree = NULL, FragmentationMap *map = NULL)
 {
     uint32_t chunkNumber = 1;
     // The __end__ linker symbol points to the beginning of the heap.
@@ -116,6 +125,8 @@ static uint32_t heapWalk(StreamOutput *stream, bool verbose)
 
         if (isChunkFree) freeSize += chunkSize;
         else usedSize += chunkSize;
+        if (isChunkFree && largestFree != NULL && chunkSize > *largestFree) *largestFree = chunkSize;
+        if (map != NULL) map->add(chunkCurr, chunkSize, !isChunkFree);
 
         chunkCurr = chunkNext;
         chunkNumber++;
@@ -211,19 +222,49 @@ void SimpleShell::on_console_line_received( void *argument )
 
 // Act upon an ls command
 // Convert the first parameter into an absolute path, then list the files in that path
+// -s also shows sizes, -p n shows only the nth page of LS_PAGE_SIZE entries, counting from 1
+#define LS_PAGE_SIZE 20
 void SimpleShell::ls_command( string parameters, StreamOutput *stream )
 {
-    string folder = absolute_from_relative( parameters );
-    DIR *d;
-    struct dirent *p;
-    d = opendir(folder.c_str());
-    if (d != NULL) {
-        while ((p = readdir(d)) != NULL) {
-            stream->printf("%s\r\n", lc(string(p->d_name)).c_str());
+    bool sizes = false;
+    int page = 0;
+    string folder;
+    while (!parameters.empty()) {
+        string p = shift_parameter( parameters );
+        if (p == "-s") {
+            sizes = true;
+        } else if (p == "-p") {
+            page = atoi(shift_parameter( parameters ).c_str());
+        } else {
+            folder = p;
         }
-        closedir(d);
-    } else {
+    }
+    folder = absolute_from_relative( folder );
+
+    DirectoryIndex *index = THEKERNEL->directory_index;
+    if (!index->load(folder)) {
         stream->printf("Could not open directory %s \r\n", folder.c_str());
+        return;
+    }
+
+    int first = 0, last = index->count();
+    if (page > 0) {
+        first = (page - 1) * LS_PAGE_SIZE;
+        if (first + LS_PAGE_SIZE < last) last = first + LS_PAGE_SIZE;
+    }
+
+    for (int i = first; i < last; i++) {
+        if (!sizes) {
+            stream->printf("%s\r\n", lc(string(index->name(i))).c_str());
+        } else if (index->is_folder(i)) {
+            stream->printf("%s/\r\n", lc(string(index->name(i))).c_str());
+        } else {
+            stream->printf("%s %lu\r\n", lc(string(index->name(i))).c_str(), (unsigned long)index->size(i));
+        }
+    }
+
+    if (page > 0) {
+        stream->printf("page %d of %d\r\n", page, (index->count() + LS_PAGE_SIZE - 1) / LS_PAGE_SIZE);
     }
 }
 
@@ -306,6 +347,9 @@ void SimpleShell::load_command( string parameters, StreamOutput *stream )
         filename = THEKERNEL->config_override_filename();
     }
 
+    // in case power went while it was last saved
+    FileStream::recover(filename);
+
     FILE *fp= fopen(filename.c_str(), "r");
     if(fp != NULL) {
         char buf[132];
@@ -333,39 +377,221 @@ void SimpleShell::save_command( string parameters, StreamOutput *stream )
         filename = THEKERNEL->config_override_filename();
     }
 
-    // replace stream with one that writes to config-override file
-    FileStream *gs = new FileStream(filename.c_str());
+    // replace stream with one that writes to config-override file, the old file stays until the new one is complete
+    FileStream *gs = new FileStream(filename.c_str(), true);
     if(!gs->is_open()) {
         stream->printf("Unable to open File %s for write\n", filename.c_str());
+        delete gs;
         return;
     }
 
     // issue a M500 which will store values in the file stream
     Gcode *gcode = new Gcode("M500", gs);
     THEKERNEL->call_event(ON_GCODE_RECEIVED, gcode );
-    delete gs;
     delete gcode;
+    bool ok = gs->close();
+    delete gs;
 
-    stream->printf("Settings Stored to %s\r\n", filename.c_str());
+    if(ok) {
+        stream->printf("Settings Stored to %s\r\n", filename.c_str());
+    } else {
+        stream->printf("Unable to store settings to %s\r\n", filename.c_str());
+    }
 }
 
 // show free memory
 void SimpleShell::mem_command( string parameters, StreamOutput *stream)
 {
-    bool verbose = shift_parameter( parameters ).find_first_of("Vv") != string::npos ;
+    string option = shift_parameter( parameters );
+    bool verbose = option.find_first_of("Vv") != string::npos ;
     unsigned long heap = (unsigned long)_sbrk(0);
     unsigned long m = g_maximumHeapAddress - heap;
     stream->printf("Unused Heap: %lu bytes\r\n", m);
 
-    uint32_t f= heapWalk(stream, verbose);
+    uint32_t largest = 0;
+    FragmentationMap map((uint32_t)&__end__, g_maximumHeapAddress - (uint32_t)&__end__);
+    uint32_t f= heapWalk(stream, verbose, &largest, &map);
     stream->printf("Total Free RAM: %lu bytes\r\n", m + f);
 
     stream->printf("Free AHB0: %lu, AHB1: %lu\r\n", AHB0.free(), AHB1.free());
+    stream->printf("Largest free block: heap %lu, AHB0 %lu, AHB1 %lu\r\n", largest > m ? largest : m, AHB0.largest_free(), AHB1.largest_free());
+    stream->printf("Did not fit: AHB0 %u allocations, %lu bytes, AHB1 %u allocations, %lu bytes\r\n", AHB0.refused(), AHB0.refused_bytes(), AHB1.refused(), AHB1.refused_bytes());
+    slab_pool.debug(stream);
     if (verbose)
     {
         AHB0.debug(stream);
         AHB1.debug(stream);
     }
+
+    if (option == "map") {
+        // the unused space above the heap is free too
+        map.add(heap, m, false);
+        stream->printf("Heap:\r\n");
+        map.print(stream);
+        stream->printf("AHB0:\r\n");
+        AHB0.map(stream);
+        stream->printf("AHB1:\r\n");
+        AHB1.map(stream);
+
+    } else if (option == "tags") {
+        heap_tag_report(stream);
+    }
+}
+
+// control the event profiler, and show where the time goes for each module and event
+void SimpleShell::profile_command( string parameters, StreamOutput *stream)
+{
+    string what = shift_parameter( parameters );
+    if (what == "on") {
+        THEKERNEL->set_profiling(true);
+        stream->printf("Profiling started\r\n");
+    } else if (what == "off") {
+        THEKERNEL->set_profiling(false);
+        stream->printf("Profiling stopped\r\n");
+    } else if (what == "reset") {
+        THEKERNEL->reset_profile();
+        stream->printf("Profile cleared\r\n");
+    } else {
+        THEKERNEL->print_profile(stream);
+    }
+}
+
+// a hook for tickbench that only counts its calls
+struct TickBenchHook {
+    volatile uint32_t calls;
+    uint32_t tick(uint32_t dummy) { calls++; return 0; }
+};
+
+// attach extra hooks to the SlowTicker at rates spread between 100Hz and 1kHz, time its interrupt for a second,
+// and detach them again, for each number of hooks
+void SimpleShell::tickbench_command( string parameters, StreamOutput *stream)
+{
+    static const int hook_counts[] = { 0, 5, 10, 20, 50 };
+    const int max_hooks = 50;
+
+    if (!THEKERNEL->conveyor->is_queue_empty()) {
+        stream->printf("Not while the machine is moving\r\n");
+        return;
+    }
+
+    const int *counts = hook_counts;
+    int runs = sizeof(hook_counts) / sizeof(hook_counts[0]);
+    int count;
+    string count_parameter = shift_parameter( parameters );
+    if (!count_parameter.empty()) {
+        count = strtol(count_parameter.c_str(), NULL, 10);
+        if (count < 0) count = 0;
+        if (count > max_hooks) count = max_hooks;
+        counts = &count;
+        runs = 1;
+    }
+
+    TickBenchHook *hooks = new TickBenchHook[max_hooks];
+    int ids[max_hooks];
+    uint32_t cycles_per_us = SystemCoreClock / 1000000;
+
+    stream->printf("Slow ticker interrupt, 1 second per line, cycles at %luMHz\r\n", cycles_per_us);
+    for (int r = 0; r < runs; r++) {
+        int n = counts[r];
+        for (int i = 0; i < n; i++) {
+            hooks[i].calls = 0;
+            ids[i] = THEKERNEL->slow_ticker->attach(100 + (i * 900) / max_hooks, &hooks[i], &TickBenchHook::tick);
+        }
+
+        THEKERNEL->slow_ticker->set_timing(true);
+        uint32_t start = us_ticker_read();
+        while (us_ticker_read() - start < 1000000)
+            THEKERNEL->call_event(ON_IDLE);
+        THEKERNEL->slow_ticker->set_timing(false);
+        SlowTicker::TickTiming t = THEKERNEL->slow_ticker->get_timing();
+
+        uint32_t calls = 0;
+        for (int i = 0; i < n; i++) {
+            THEKERNEL->slow_ticker->detach(ids[i]);
+            calls += hooks[i].calls;
+        }
+
+        stream->printf("%2d extra hooks: %lu interrupts, %lu extra hook calls, avg %lu cycles, worst %lu cycles\r\n", n, t.ticks, calls,
+                       t.ticks ? (uint32_t)(t.total_cycles / t.ticks) : 0, t.worst_cycles);
+    }
+
+    delete [] hooks;
+}
+
+// write and read back a scratch file, first a sector per call and then in calls big enough for FatFs to hand the
+// card multiple block transfers, and report the throughput of each
+void SimpleShell::sdbench_command( string parameters, StreamOutput *stream)
+{
+    static const size_t chunk_sizes[] = { 512, 8192 };
+    const char *fn = "/sd/sdbench.tmp";
+
+    if (!THEKERNEL->conveyor->is_queue_empty()) {
+        stream->printf("Not while the machine is moving\r\n");
+        return;
+    }
+
+    string size_parameter = shift_parameter( parameters );
+    uint32_t kb = 256;
+    if (!size_parameter.empty())
+        kb = strtol(size_parameter.c_str(), NULL, 10);
+    if (kb < 8) kb = 8;
+    uint32_t total = kb * 1024;
+
+    char *buf = (char *)malloc(chunk_sizes[1]);
+    if (buf == NULL) {
+        stream->printf("Not enough memory\r\n");
+        return;
+    }
+    for (size_t i = 0; i < chunk_sizes[1]; i++)
+        buf[i] = i;
+
+    stream->printf("SD benchmark, %lu KB per pass\r\n", kb);
+    for (size_t c = 0; c < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); c++) {
+        size_t chunk = chunk_sizes[c];
+
+        // unbuffered, so every call goes straight to FatFs in one piece
+        FILE *fp = fopen(fn, "w");
+        if (fp == NULL) {
+            stream->printf("Could not open %s\r\n", fn);
+            break;
+        }
+        setvbuf(fp, NULL, _IONBF, 0);
+        uint32_t start = us_ticker_read();
+        uint32_t n;
+        for (n = 0; n < total; n += chunk) {
+            if (fwrite(buf, 1, chunk, fp) != chunk) break;
+        }
+        fclose(fp);
+        uint32_t write_us = us_ticker_read() - start;
+        if (n < total) {
+            stream->printf("Write failed after %lu bytes\r\n", n);
+            break;
+        }
+
+        fp = fopen(fn, "r");
+        if (fp == NULL) {
+            stream->printf("Could not open %s\r\n", fn);
+            break;
+        }
+        setvbuf(fp, NULL, _IONBF, 0);
+        start = us_ticker_read();
+        for (n = 0; n < total; n += chunk) {
+            if (fread(buf, 1, chunk, fp) != chunk) break;
+        }
+        fclose(fp);
+        uint32_t read_us = us_ticker_read() - start;
+        if (n < total) {
+            stream->printf("Read failed after %lu bytes\r\n", n);
+            break;
+        }
+
+        stream->printf("%5u bytes per call: write %lu KB/s, read %lu KB/s\r\n", chunk,
+                       (uint32_t)((uint64_t)kb * 1000000 / (write_us ? write_us : 1)),
+                       (uint32_t)((uint64_t)kb * 1000000 / (read_us ? read_us : 1)));
+    }
+
+    remove(fn);
+    free(buf);
 }
 
 static uint32_t getDeviceType()
@@ -386,6 +612,31 @@ static uint32_t getDeviceType()
     return result[1];
 }
 
+// Reports the digests kept of recent uploads and plays, the file is never read again for them
+void SimpleShell::digest_command( string parameters, StreamOutput *stream)
+{
+    string filename = shift_parameter(parameters);
+
+    if (filename.empty()) {
+        int n = 0;
+        FileDigest::each([stream, &n](const string& fn, uint32_t size, uint32_t crc, const char *md5) {
+            stream->printf("%s %lu bytes, crc32 %08lx, md5 %s\r\n", fn.c_str(), size, crc, md5);
+            n++;
+        });
+        if (n == 0) stream->printf("No digests, they are kept of files uploaded or played through to the end\r\n");
+        return;
+    }
+
+    filename = absolute_from_relative(filename);
+    uint32_t size, crc;
+    string md5;
+    if (FileDigest::lookup(filename, size, crc, md5)) {
+        stream->printf("%s %lu bytes, crc32 %08lx, md5 %s\r\n", filename.c_str(), size, crc, md5.c_str());
+    } else {
+        stream->printf("No digest of %s, upload or play it through to the end first\r\n", filename.c_str());
+    }
+}
+
 // get network config
 void SimpleShell::net_command( string parameters, StreamOutput *stream)
 {
@@ -500,15 +751,20 @@ void SimpleShell::help_command( string parameters, StreamOutput *stream )
 {
     stream->printf("Commands:\r\n");
     stream->printf("version\r\n");
-    stream->printf("mem [-v]\r\n");
-    stream->printf("ls [folder]\r\n");
+    stream->printf("mem [-v|map|tags] - map shows fragmentation, tags the heap used by each module\r\n");
+    stream->printf("profile [on|off|reset] - shows time spent in each module per event\r\n");
+    stream->printf("sdbench [KB] - measures sd card read and write speed, using a scratch file\r\n");
+    stream->printf("tickbench [hooks] - times the slow ticker interrupt with 0 to 50 extra hooks, or the number given\r\n");
+    stream->printf("ls [-s] [-p page] [folder]\r\n");
     stream->printf("cd folder\r\n");
     stream->printf("pwd\r\n");
     stream->printf("cat file [limit]\r\n");
+    stream->printf("digest [file] - crc32 and md5 of files uploaded or played recently, worked out as they went by\r\n");
     stream->printf("rm file\r\n");
     stream->printf("play file [-v]\r\n");
     stream->printf("progress - shows progress of current play\r\n");
     stream->printf("abort - abort currently playing file\r\n");
+    stream->printf("resume [checkpoint] - carry on with an interrupted job from its last checkpoint, home first\r\n");
     stream->printf("reset - reset smoothie\r\n");
     stream->printf("dfu - enter dfu boot loader\r\n");
     stream->printf("break - break into debugger\r\n");
@@ -43,6 +43,10 @@ private:
     static void set_temp_command(string parameters, StreamOutput *stream );
     static void switch_command(string parameters, StreamOutput *stream );
     static void mem_command(string parameters, StreamOutput *stream );
+    static void profile_command(string parameters, StreamOutput *stream );
+    static void sdbench_command(string parameters, StreamOutput *stream );
+    static void tickbench_command(string parameters, StreamOutput *stream );
+    static void digest_command(string parameters, StreamOutput *stream );
 
     static void net_command( string parameters, StreamOutput *stream);
 
@@ -0,0 +1,35 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include <chrono>
+
+/*
+ * Timing for the host benchmarks
+ *
+ * Each measurement is the best of a few runs, which is the one least disturbed by the rest of the
+ * machine. The host is not the LPC1768, so compare the numbers a benchmark prints with each other,
+ * not with cycle counts taken on the board.
+ */
+
+#define BENCH_RUNS 5
+
+static inline uint64_t bench_now_ns(void)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// nanoseconds per iteration of f(), which is called iterations times per run
+template<typename F> double bench_ns_per(uint32_t iterations, F f)
+{
+    double best = 0;
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        uint64_t start = bench_now_ns();
+        for (uint32_t i = 0; i < iterations; i++) f();
+        double ns = (double)(bench_now_ns() - start) / iterations;
+        if (run == 0 || ns < best) best = ns;
+    }
+    return best;
+}
+
+#endif
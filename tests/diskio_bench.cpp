@@ -0,0 +1,174 @@
+/*
+ * The diskio sector cache and fast seek, on a FAT image
+ *
+ * Lists a directory of long file names, and reads a fragmented file at random offsets, with the FAT and
+ * directory sector cache in diskio.cpp on and off, and the file opened with and without the cluster link map
+ * FATFileSystem builds for files opened read only. The cache is set up the first time it is needed and never
+ * let go, so each case runs in a process of its own, and is turned off by having the AHB banks refuse it.
+ *
+ * The image is in the host's page cache, so the sectors read are what to go by, each is a command to the
+ * card on the board. A listing that is longer than the cache pushes every sector out before it comes round
+ * again, which the directory of many files shows.
+ */
+
+#include "bench.h"
+#include "fatimage.h"
+#include "platform_memory.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+static const char *image = "diskio_bench.img";
+
+#define FEW_FILES       10      // a directory that fits in the cache
+#define MANY_FILES      200     // and one that does not
+#define LISTINGS        10
+#define CHUNK           (64 * 1024)
+#define CHUNKS          60      // fragments per file, the link map needs two entries each and has room for 128
+#define SEEKS           2000
+
+static bool populate()
+{
+    FatImage disk(image, 64);
+    if (!disk.format(4096) || disk.mkdir("few", 0777) != 0 || disk.mkdir("many", 0777) != 0) return false;
+
+    char name[64];
+    for (int i = 0; i < MANY_FILES; i++) {
+        for (int few = 0; few < 2; few++) {
+            if (few && i >= FEW_FILES) continue;
+            snprintf(name, sizeof(name), "%s/a part with a long name %03d.gcode", few ? "few" : "many", i);
+            mbed::FileHandle *fh = disk.open(name, O_WRONLY | O_CREAT | O_TRUNC);
+            if (fh == NULL) return false;
+            fh->write(name, strlen(name));
+            fh->close();
+        }
+    }
+
+    // written a chunk at a time in turn, so each is in CHUNKS pieces
+    static char chunk[CHUNK];
+    mbed::FileHandle *a = disk.open("a.gcode", O_WRONLY | O_CREAT | O_TRUNC);
+    mbed::FileHandle *b = disk.open("b.gcode", O_WRONLY | O_CREAT | O_TRUNC);
+    if (a == NULL || b == NULL) return false;
+    for (int i = 0; i < CHUNKS; i++) {
+        for (int j = 0; j < CHUNK; j++) chunk[j] = (char)(i * CHUNK + j);
+        if (a->write(chunk, CHUNK) != CHUNK || b->write(chunk, CHUNK) != CHUNK) return false;
+    }
+    a->close();
+    b->close();
+    return true;
+}
+
+static void report(const char *what, const char *how, FatImage& disk, uint64_t ns, bool ok)
+{
+    printf("%-10s %-22s %8.2f ms  %7u sectors read in %6u commands%s\n", what, how, ns / 1e6,
+           disk.counts.sector_reads, disk.counts.read_commands, ok ? "" : "  FAILED");
+}
+
+static bool list(bool cache, bool few)
+{
+    FatImage disk(image, 64);
+    disk.reset_counts();
+    uint64_t start = bench_now_ns();
+    int files = 0;
+    for (int i = 0; i < LISTINGS; i++) {
+        mbed::DirHandle *dir = disk.opendir(few ? "few" : "many");
+        if (dir == NULL) break;
+        while (dir->readdir() != NULL) files++;
+        dir->closedir();
+    }
+    bool ok = files == (few ? FEW_FILES : MANY_FILES) * LISTINGS;
+
+    char how[32];
+    snprintf(how, sizeof(how), "%s, %d files", cache ? "cache" : "no cache", few ? FEW_FILES : MANY_FILES);
+    report("listing", how, disk, bench_now_ns() - start, ok);
+    return ok;
+}
+
+// byte n of the file, as populate() wrote it
+static char expected(uint32_t n)
+{
+    return (char)n;
+}
+
+static bool seek(bool cache, bool link_map)
+{
+    FatImage disk(image, 64);
+
+    // FATFileSystem::open maps the chain of a file opened read only, plain f_open does not
+    mbed::FileHandle *fh = NULL;
+    FIL_t fil;
+    if (link_map) {
+        fh = disk.open("a.gcode", O_RDONLY);
+        if (fh == NULL) return false;
+    } else if (f_open(&fil, "a.gcode", FA_READ) != FR_OK) {
+        return false;
+    }
+
+    disk.reset_counts();
+    uint64_t start = bench_now_ns();
+    bool ok = true;
+    srand(1);
+    for (int i = 0; i < SEEKS; i++) {
+        uint32_t position = ((uint32_t)rand() * 4099u) % (CHUNK * CHUNKS - 64);
+        char buffer[64];
+        UINT n;
+        if (link_map) {
+            fh->lseek(position, SEEK_SET);
+            n = fh->read(buffer, sizeof(buffer));
+        } else if (f_lseek(&fil, position) != FR_OK || f_read(&fil, buffer, sizeof(buffer), &n) != FR_OK) {
+            n = 0;
+        }
+        if (n != sizeof(buffer) || buffer[0] != expected(position) || buffer[63] != expected(position + 63)) ok = false;
+    }
+    uint64_t ns = bench_now_ns() - start;
+
+    char how[32];
+    snprintf(how, sizeof(how), "%s, %s", cache ? "cache" : "no cache", link_map ? "link map" : "FAT walk");
+    report("seek+read", how, disk, ns, ok);
+
+    if (link_map) fh->close();
+    else f_close(&fil);
+    return ok;
+}
+
+// runs fn in a process of its own, so it starts with diskio as it is at power on
+template<typename F> static bool fresh(bool cache, F fn)
+{
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        AHB0.refuse = AHB1.refuse = !cache;
+        exit(fn() ? 0 : 1);
+    }
+    int status;
+    return pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+int main()
+{
+    if (!fresh(true, populate)) {
+        printf("could not set up %s\n", image);
+        return 1;
+    }
+    printf("%d listings of directories of long names, %d random reads of a file in %d fragments, 4K clusters\n",
+           LISTINGS, SEEKS, CHUNKS);
+
+    bool ok = true;
+    for (int few = 1; few >= 0; few--) {
+        for (int cache = 1; cache >= 0; cache--) {
+            ok = fresh(cache, [cache, few]() { return list(cache, few); }) && ok;
+        }
+    }
+    for (int cache = 1; cache >= 0; cache--) {
+        for (int link_map = 1; link_map >= 0; link_map--) {
+            ok = fresh(cache, [cache, link_map]() { return seek(cache, link_map); }) && ok;
+        }
+    }
+
+    remove(image);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,168 @@
+/*
+ * DmaRxRing fed by a simulated DMA channel
+ *
+ * The channel writes bytes round a small buffer and reports its position the way the terminal count
+ * interrupt and the channel's destination address do, including the lap the interrupt has not counted yet.
+ */
+
+#include "DmaRxRing.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#define LENGTH 16
+
+static int failures = 0;
+
+#define CHECK(cond) do { if (!(cond)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } } while (0)
+
+struct Channel {
+    uint8_t buffer[LENGTH];
+    uint32_t written;
+
+    Channel() : written(0) { memset(buffer, 0, sizeof(buffer)); };
+
+    void send(const char *s, size_t n) {
+        for (size_t i = 0; i < n; i++) buffer[written++ % LENGTH] = s[i];
+    };
+    void send(const char *s) { send(s, strlen(s)); };
+
+    // what the consumer sees, late_lap is the terminal count interrupt not having run yet after a wrap
+    void report(DmaRxRing &rx, bool late_lap = false) {
+        uint32_t laps = written / LENGTH;
+        uint32_t offset = written % LENGTH;
+        if (late_lap && laps > 0 && offset < LENGTH / 2) laps--;
+        rx.update(laps, offset);
+    };
+};
+
+static void test_wrap(void)
+{
+    Channel ch;
+    DmaRxRing rx(ch.buffer, LENGTH);
+    std::string line;
+
+    // fill most of the buffer and consume it, so the next lines straddle the end
+    ch.send("0123456789\n");
+    ch.report(rx);
+    CHECK(rx.has_line() && rx.read_line(line) && line == "0123456789");
+    CHECK(!rx.has_line() && rx.available() == 0);
+
+    // a partial line is not a line yet
+    ch.send("abc");
+    ch.report(rx);
+    CHECK(!rx.has_line() && !rx.read_line(line));
+    CHECK(rx.available() == 3);
+
+    // the rest arrives across the wrap, with the lap not counted yet, CR and LF both end a line
+    ch.send("def\rxy\n");
+    ch.report(rx, true);
+    CHECK(rx.read_line(line) && line == "abcdef");
+    CHECK(rx.read_line(line) && line == "xy");
+    CHECK(!rx.read_line(line));
+    CHECK(rx.overruns == 0 && rx.dropped == 0);
+
+    // the late lap catches up, which must not look like another lap
+    ch.report(rx);
+    CHECK(rx.available() == 0 && rx.overruns == 0);
+}
+
+static void test_overrun(void)
+{
+    Channel ch;
+    DmaRxRing rx(ch.buffer, LENGTH);
+    std::string line;
+
+    // more than a buffer arrives before the consumer looks, so what is there is lost
+    ch.send("first\nsecond line\nthird\n");
+    ch.report(rx);
+    CHECK(rx.overruns == 1);
+    CHECK(rx.dropped == 24);
+    CHECK(!rx.has_line() && rx.available() == 0);
+
+    // and it picks up cleanly after that
+    ch.send("next\n");
+    ch.report(rx);
+    CHECK(rx.read_line(line) && line == "next");
+}
+
+static void test_long_line(void)
+{
+    Channel ch;
+    DmaRxRing rx(ch.buffer, LENGTH);
+    std::string line;
+
+    // a line that does not fit can never end, so it is dropped once it fills the buffer
+    ch.send("aaaaaaaaaaaaaaa");
+    ch.report(rx);
+    CHECK(!rx.has_line() && rx.dropped == LENGTH - 1 && rx.available() == 0);
+
+    ch.send("\nok\n");
+    ch.report(rx);
+    CHECK(rx.read_line(line) && line == "");
+    CHECK(rx.read_line(line) && line == "ok");
+
+    ch.send("gone\n");
+    ch.report(rx);
+    rx.flush();
+    CHECK(!rx.has_line() && rx.available() == 0);
+}
+
+// random lines in random chunks over many laps, read after each chunk so nothing is overrun
+static void test_stream(void)
+{
+    Channel ch;
+    DmaRxRing rx(ch.buffer, LENGTH);
+    std::string sent, got, line;
+    unsigned int lines_sent = 0, lines_got = 0;
+
+    srand(1);
+    std::string pending;
+    for (int i = 0; i < 100000; i++) {
+        if (pending.empty()) {
+            int n = rand() % 10;
+            for (int j = 0; j < n; j++) pending += 'a' + rand() % 26;
+            sent += pending + "|";
+            pending += (rand() & 1) ? '\n' : '\r';
+            lines_sent++;
+        }
+        size_t n = 1 + rand() % (LENGTH / 2);
+        if (n > pending.size()) n = pending.size();
+        ch.send(pending.data(), n);
+        pending.erase(0, n);
+        ch.report(rx, rand() & 1);
+        while (rx.read_line(line)) {
+            got += line + "|";
+            lines_got++;
+        }
+    }
+    if (!pending.empty()) {
+        ch.send(pending.data(), pending.size());
+        ch.report(rx);
+        while (rx.read_line(line)) {
+            got += line + "|";
+            lines_got++;
+        }
+    }
+
+    CHECK(lines_got == lines_sent);
+    CHECK(got == sent);
+    CHECK(rx.overruns == 0 && rx.dropped == 0);
+}
+
+int main(void)
+{
+    test_wrap();
+    test_overrun();
+    test_long_line();
+    test_stream();
+
+    if (failures) {
+        printf("dmarxring_test: %d failures\n", failures);
+        return 1;
+    }
+    printf("dmarxring_test: passed\n");
+    return 0;
+}
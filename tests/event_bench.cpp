@@ -0,0 +1,66 @@
+/*
+ * Cost of calling one of the fast events ( speed change, block begin and end ) with 0, 2 and 5 subscribers
+ *
+ * The Kernel calls them through a FastEventList, where each module's handler was resolved when it
+ * registered. Before that they went through the hooks vector like the other events, looking up the
+ * virtual method through kernel_callback_functions for every module on every call, which is measured
+ * here alongside.
+ */
+
+#include "libs/Kernel.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <vector>
+
+// Module.cpp registers through the Kernel, which is not built here
+Kernel* Kernel::instance;
+void Kernel::register_for_event(_EVENT_ENUM id_event, Module *module) {}
+
+class Subscriber : public Module {
+    public:
+        Subscriber() : calls(0) {}
+        void on_speed_change(void*) { calls++; }
+        volatile uint32_t calls;
+};
+
+#define EVENTS 10000000
+
+int main(void)
+{
+    static const int counts[] = { 0, 2, 5 };
+    int failures = 0;
+
+    printf("fast event dispatch, ns per event\n");
+    printf("%12s %12s %12s\n", "subscribers", "vector", "fast list");
+    for (int count : counts) {
+        std::vector<Subscriber> modules(count);
+        std::vector<Module*> hooks;
+        FastEventList fast;
+        for (auto& m : modules) {
+            hooks.push_back(&m);
+            fast.add(&m, kernel_callback_functions[ON_SPEED_CHANGE]);
+        }
+
+        void *argument = NULL;
+        double vector_ns = bench_ns_per(EVENTS, [&]() {
+            for (auto m : hooks) {
+                (m->*kernel_callback_functions[ON_SPEED_CHANGE])(argument);
+            }
+        });
+        double fast_ns = bench_ns_per(EVENTS, [&]() { fast.call(argument); });
+
+        printf("%12d %12.2f %12.2f\n", count, vector_ns, fast_ns);
+
+        // both ways reach every subscriber on every event
+        for (auto& m : modules) {
+            if (m.calls != 2 * EVENTS * BENCH_RUNS) failures++;
+        }
+    }
+
+    if (failures) {
+        printf("event_bench: %d subscribers missed calls\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,130 @@
+#include "fatimage.h"
+#include "DirectoryIndex.h"
+#include "platform_memory.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+HostMemoryPool AHB0;
+HostMemoryPool AHB1;
+
+// FATFileSystem drops the listing cache on changes, there is none here to drop
+volatile uint32_t DirectoryIndex::changes = 0;
+
+void error(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    exit(1);
+}
+
+static FatImage *mounted;
+
+FatImage::FatImage(const char *image, uint32_t megabytes) : FATFileSystem("sd")
+{
+    sectors = megabytes * 2048;
+    fd = ::open(image, O_RDWR | O_CREAT, 0644);
+    if (fd < 0 || ftruncate(fd, (off_t)sectors * 512) != 0)
+        error("could not make the image %s\n", image);
+    reset_counts();
+    mounted = this;
+}
+
+FatImage::~FatImage()
+{
+    mounted = NULL;
+    ::close(fd);
+}
+
+bool FatImage::format(uint32_t cluster_bytes)
+{
+    return f_mkfs(_fsid, 1, cluster_bytes) == FR_OK;
+}
+
+void FatImage::reset_counts()
+{
+    memset(&counts, 0, sizeof(counts));
+}
+
+int FatImage::disk_read(char *buffer, int sector)
+{
+    return disk_read_blocks(buffer, sector, 1);
+}
+
+int FatImage::disk_write(const char *buffer, int sector)
+{
+    return disk_write_blocks(buffer, sector, 1);
+}
+
+int FatImage::disk_read_blocks(char *buffer, int sector, int count)
+{
+    counts.read_commands++;
+    counts.sector_reads += count;
+    return pread(fd, buffer, count * 512, (off_t)sector * 512) == count * 512 ? 0 : 1;
+}
+
+int FatImage::disk_write_blocks(const char *buffer, int sector, int count)
+{
+    counts.write_commands++;
+    counts.sector_writes += count;
+    return pwrite(fd, buffer, count * 512, (off_t)sector * 512) == count * 512 ? 0 : 1;
+}
+
+/*
+ * stdio on /sd paths, linked with --wrap=fopen so code under test calls this for its fopen
+ * The FILE goes through a FileHandle from the image as newlib's does through mbed's retarget on the board
+ */
+
+static ssize_t handle_read(void *cookie, char *buffer, size_t size)
+{
+    return ((mbed::FileHandle *)cookie)->read(buffer, size);
+}
+
+static ssize_t handle_write(void *cookie, const char *buffer, size_t size)
+{
+    ssize_t n = ((mbed::FileHandle *)cookie)->write(buffer, size);
+    return n < 0 ? 0 : n;
+}
+
+static int handle_seek(void *cookie, off64_t *position, int whence)
+{
+    off_t p = ((mbed::FileHandle *)cookie)->lseek(*position, whence);
+    if (p < 0) return -1;
+    *position = p;
+    return 0;
+}
+
+static int handle_close(void *cookie)
+{
+    return ((mbed::FileHandle *)cookie)->close();
+}
+
+extern "C" FILE *__real_fopen(const char *filename, const char *mode);
+
+extern "C" FILE *__wrap_fopen(const char *filename, const char *mode)
+{
+    if (mounted == NULL || strncmp(filename, "/sd/", 4) != 0)
+        return __real_fopen(filename, mode);
+
+    // the same flags mbed's retarget hands the file system
+    int flags;
+    switch (mode[0]) {
+        case 'r': flags = strchr(mode, '+') ? O_RDWR : O_RDONLY; break;
+        case 'w': flags = (strchr(mode, '+') ? O_RDWR : O_WRONLY) | O_CREAT | O_TRUNC; break;
+        case 'a': flags = (strchr(mode, '+') ? O_RDWR : O_WRONLY) | O_CREAT | O_APPEND; break;
+        default: return NULL;
+    }
+
+    mbed::FileHandle *handle = mounted->open(filename + 4, flags);
+    if (handle == NULL) return NULL;
+
+    cookie_io_functions_t io = { handle_read, handle_write, handle_seek, handle_close };
+    FILE *fp = fopencookie(handle, mode, io);
+    if (fp == NULL) handle->close();
+    return fp;
+}
@@ -0,0 +1,46 @@
+#ifndef FATIMAGE_H
+#define FATIMAGE_H
+
+#include "FATFileSystem.h"
+
+#include <stdint.h>
+
+/*
+ * A FAT file system in an image file, through the same FATFileSystem, diskio and FatFs code the board uses
+ *
+ * It stands in for the sd card and counts what reaches it, so a benchmark can tell how many sectors and
+ * commands a way of doing something costs. It is mounted as /sd, and fopen on a /sd path opens the file
+ * on the image, as stdio does on the board.
+ */
+
+struct DiskCounts {
+    uint32_t sector_reads;
+    uint32_t sector_writes;
+    uint32_t read_commands;     // a multiple block transfer is one command
+    uint32_t write_commands;
+};
+
+class FatImage : public mbed::FATFileSystem {
+public:
+    // creates the image, or reuses one that is already the right size
+    FatImage(const char *image, uint32_t megabytes);
+    virtual ~FatImage();
+
+    // a fresh file system with clusters of the given size
+    bool format(uint32_t cluster_bytes);
+
+    virtual int disk_read(char *buffer, int sector);
+    virtual int disk_write(const char *buffer, int sector);
+    virtual int disk_read_blocks(char *buffer, int sector, int count);
+    virtual int disk_write_blocks(const char *buffer, int sector, int count);
+    virtual int disk_sectors() { return sectors; }
+
+    DiskCounts counts;
+    void reset_counts();
+
+private:
+    int fd;
+    uint32_t sectors;
+};
+
+#endif
@@ -0,0 +1,62 @@
+/*
+ * Cost of calling a Hook, against the FPointer based Hook it replaced
+ *
+ * The old Hook was an FPointer allocated with new, whose call() checked for a C callback and for a
+ * null object and method before calling through the member function pointer. The Hook now holds the
+ * object and method inline and calls through a function generated for the object's type.
+ * Both call the same methods on the same objects here, the way the step interrupt calls a few of them in turn.
+ */
+
+#include "Hook.h"
+#include "FPointer.h"
+#include "bench.h"
+
+#include <stdio.h>
+
+class Target {
+    public:
+        Target() : calls(0) {}
+        uint32_t tick(uint32_t argument) { calls++; return argument; }
+        volatile uint32_t calls;
+};
+
+// the old Hook, less the interval and countdown only the SlowTicker used
+class OldHook : public FPointer {};
+
+#define TARGETS 4
+#define CALLS 20000000
+
+int main(void)
+{
+    Target targets[TARGETS];
+    OldHook *old_hooks[TARGETS];
+    Hook hooks[TARGETS];
+
+    for (int i = 0; i < TARGETS; i++) {
+        old_hooks[i] = new OldHook();
+        old_hooks[i]->attach(&targets[i], &Target::tick);
+        hooks[i].attach(&targets[i], &Target::tick);
+    }
+
+    double old_ns = bench_ns_per(CALLS / TARGETS, [&]() {
+        for (int i = 0; i < TARGETS; i++) old_hooks[i]->call();
+    }) / TARGETS;
+    double new_ns = bench_ns_per(CALLS / TARGETS, [&]() {
+        for (int i = 0; i < TARGETS; i++) hooks[i].call();
+    }) / TARGETS;
+
+    printf("hook call, ns per call\n");
+    printf("%12s %12s\n", "FPointer", "Hook");
+    printf("%12.2f %12.2f\n", old_ns, new_ns);
+
+    int failures = 0;
+    for (int i = 0; i < TARGETS; i++) {
+        if (targets[i].calls != 2 * (CALLS / TARGETS) * BENCH_RUNS) failures++;
+        delete old_hooks[i];
+    }
+    if (failures) {
+        printf("hook_bench: %d targets missed calls\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,179 @@
+/*
+ * Replays an allocation trace through the SlabPool backed operator new and delete, and through malloc and free
+ *
+ * The built in trace follows what streaming gcode does on the board: each line arrives as a string,
+ * becomes a Gcode with a copy of its command, and the Gcode is freed once the planner has moved some
+ * thirty blocks past it, with now and then a reply string too big for the slab. Sizes are as on the
+ * LPC1768, where pointers are 4 bytes.
+ *
+ * A trace taken elsewhere can be replayed instead, one operation per line:
+ *   a <id> <bytes>     allocate, the id names the allocation
+ *   f <id>             free it
+ */
+
+#include "SlabPool.h"
+#include "MemoryPool.h"
+#include "StreamOutput.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// SlabPool's operator delete asks the MemoryPools about anything outside the slab, there are none here
+MemoryPool* MemoryPool::first = NULL;
+uint8_t* MemoryPool::lowest = NULL;
+uint8_t* MemoryPool::highest = NULL;
+bool MemoryPool::has(void* p) { return false; }
+void MemoryPool::dealloc(void* p) {}
+
+class StdoutStream : public StreamOutput {
+    public:
+        int puts(const char *s) { return fputs(s, stdout); }
+};
+
+struct Op {
+    uint32_t id;
+    uint32_t size;      // 0 for a free
+};
+
+// the trace and the live pointers are kept with malloc, so they do not take slab pages themselves
+static Op *ops;
+static uint32_t op_count, op_room;
+static uint32_t ids;
+
+static void add_op(uint32_t id, uint32_t size)
+{
+    if (op_count == op_room) {
+        op_room = op_room ? op_room * 2 : 1024;
+        ops = (Op *)realloc(ops, op_room * sizeof(Op));
+    }
+    ops[op_count].id = id;
+    ops[op_count].size = size;
+    op_count++;
+    if (id >= ids) ids = id + 1;
+}
+
+static uint32_t lcg = 1;
+static uint32_t random_below(uint32_t n)
+{
+    lcg = lcg * 1103515245 + 12345;
+    return (lcg >> 16) % n;
+}
+
+#define LINES 20000
+#define PLANNER_DEPTH 32
+
+static void build_trace(void)
+{
+    uint32_t queued[PLANNER_DEPTH][2];  // the Gcode and its command, for each block in the planner
+    uint32_t head = 0, id = 0;
+
+    for (uint32_t line = 0; line < LINES; line++) {
+        // the line as received, a string with its 12 byte header
+        uint32_t length = 12 + random_below(32);
+        uint32_t received = id++;
+        add_op(received, 12 + length + 1);
+
+        // the Gcode and the copy of its command
+        uint32_t gcode = id++, command = id++;
+        add_op(gcode, 28);
+        add_op(command, length + 1);
+        add_op(received, 0);
+
+        // the block it went into is done, and frees the oldest Gcode
+        if (line >= PLANNER_DEPTH) {
+            add_op(queued[head][1], 0);
+            add_op(queued[head][0], 0);
+        }
+        queued[head][0] = gcode;
+        queued[head][1] = command;
+        head = (head + 1) % PLANNER_DEPTH;
+
+        // now and then an ok with a temperature report, too big for the slab
+        if (random_below(16) == 0) {
+            uint32_t reply = id++;
+            add_op(reply, 80 + random_below(64));
+            add_op(reply, 0);
+        }
+    }
+    for (uint32_t i = 0; i < PLANNER_DEPTH; i++) {
+        add_op(queued[(head + i) % PLANNER_DEPTH][1], 0);
+        add_op(queued[(head + i) % PLANNER_DEPTH][0], 0);
+    }
+}
+
+static bool load_trace(const char *filename)
+{
+    FILE *fp = fopen(filename, "r");
+    if (fp == NULL) return false;
+    char what;
+    unsigned long id, size;
+    char line[64];
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (sscanf(line, " a %lu %lu", &id, &size) == 2 && size > 0) {
+            add_op(id, size);
+        } else if (sscanf(line, " %c %lu", &what, &id) == 2 && what == 'f') {
+            add_op(id, 0);
+        }
+    }
+    fclose(fp);
+    return true;
+}
+
+static void **live;
+
+static void replay_new(void)
+{
+    for (uint32_t i = 0; i < op_count; i++) {
+        if (ops[i].size) {
+            live[ops[i].id] = operator new(ops[i].size);
+        } else {
+            operator delete(live[ops[i].id]);
+        }
+    }
+}
+
+static void replay_malloc(void)
+{
+    for (uint32_t i = 0; i < op_count; i++) {
+        if (ops[i].size) {
+            live[ops[i].id] = malloc(ops[i].size);
+        } else {
+            free(live[ops[i].id]);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1) {
+        if (!load_trace(argv[1])) {
+            printf("could not read %s\n", argv[1]);
+            return 1;
+        }
+    } else {
+        build_trace();
+    }
+    live = (void **)calloc(ids, sizeof(void *));
+
+    uint32_t allocations = 0, too_big = 0;
+    for (uint32_t i = 0; i < op_count; i++) {
+        if (ops[i].size) allocations++;
+        if (ops[i].size > SLAB_MAX_OBJECT) too_big++;
+    }
+
+    double slab_ns = bench_ns_per(1, replay_new) / allocations;
+    double malloc_ns = bench_ns_per(1, replay_malloc) / allocations;
+
+    printf("%lu allocations replayed, %lu too big for the slab, ns per allocation and its free\n", (unsigned long)allocations, (unsigned long)too_big);
+    printf("%12s %12s\n", "slab", "malloc");
+    printf("%12.2f %12.2f\n", slab_ns, malloc_ns);
+
+    StdoutStream out;
+    slab_pool.debug(&out);
+
+    free(live);
+    free(ops);
+    return 0;
+}
@@ -0,0 +1,133 @@
+/*
+ * SpscRing with a producer and a consumer thread
+ *
+ * The indices start just short of where they wrap, and a small ring laps many times, so both the free
+ * running indices and the slot masking wrap while the two sides race. Each side switches between its
+ * ways of moving items, and the consumer checks that the sequence arrives whole and in order.
+ */
+
+#include "SpscRing.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <thread>
+
+#define ITEMS 1000000
+
+static int failures = 0;
+
+#define CHECK(cond) do { if (!(cond)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } } while (0)
+
+// sets the indices, which only the ring itself may otherwise touch
+template<unsigned int length> class TestRing : public SpscBuffer<uint32_t, length> {
+public:
+    void start_at(unsigned int i) { this->head_i = this->tail_i = i; };
+};
+
+static void producer(TestRing<16> *ring)
+{
+    uint32_t next = 0;
+    while (next < ITEMS) {
+        if (next % 3 == 0) {
+            // fill in place, produce_head waits for room, which spins through a whole time slice on one core
+            *ring->head_ref() = next++;
+            while (ring->is_full()) std::this_thread::yield();
+            ring->produce_head();
+        } else if (ring->push(next)) {
+            next++;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+static void consumer(TestRing<16> *ring)
+{
+    uint32_t expect = 0;
+    uint32_t mode = 0;
+    while (expect < ITEMS && failures == 0) {
+        if (ring->is_empty()) std::this_thread::yield();
+        switch (mode++ % 3) {
+            case 0: {
+                uint32_t v;
+                if (ring->pop(v)) {
+                    CHECK(v == expect);
+                    expect = v + 1;
+                }
+                break;
+            }
+            case 1: {
+                uint32_t *first;
+                unsigned int n = ring->span(&first);
+                for (unsigned int i = 0; i < n; i++) {
+                    CHECK(first[i] == expect);
+                    expect = first[i] + 1;
+                }
+                ring->consume(n);
+                break;
+            }
+            case 2:
+                if (!ring->is_empty()) {
+                    uint32_t v = *ring->tail_ref();
+                    CHECK(v == expect);
+                    expect = v + 1;
+                    ring->consume_tail();
+                }
+                break;
+        }
+    }
+    CHECK(expect == ITEMS);
+}
+
+static void test_threads(unsigned int start)
+{
+    static TestRing<16> ring;
+    ring.start_at(start);
+
+    std::thread c(consumer, &ring);
+    std::thread p(producer, &ring);
+    p.join();
+    c.join();
+
+    CHECK(ring.is_empty());
+    CHECK(ring.size() == 0);
+}
+
+static void test_single(void)
+{
+    TestRing<4> ring;
+    ring.start_at(0xFFFFFFFEu);
+
+    // one slot is always left empty
+    CHECK(ring.capacity() == 3);
+    CHECK(ring.push(1) && ring.push(2) && ring.push(3));
+    CHECK(!ring.push(4));
+    CHECK(ring.is_full() && ring.size() == 3 && ring.free() == 0);
+    CHECK(*ring.peek(2) == 3 && ring.peek(3) == NULL);
+
+    // the items sit across the end of the storage, so span stops there
+    uint32_t *first;
+    CHECK(ring.span(&first) == 2 && first[0] == 1 && first[1] == 2);
+    ring.consume(2);
+    CHECK(ring.span(&first) == 1 && first[0] == 3);
+
+    ring.flush();
+    CHECK(ring.is_empty());
+    uint32_t v;
+    CHECK(!ring.pop(v));
+}
+
+int main(void)
+{
+    test_single();
+    // well away from the wrap, then with the indices wrapping a few items in
+    test_threads(0);
+    test_threads(0xFFFFFFF0u);
+
+    if (failures) {
+        printf("spscring_test: %d failures\n", failures);
+        return 1;
+    }
+    printf("spscring_test: passed\n");
+    return 0;
+}
@@ -0,0 +1,28 @@
+#ifndef MBED_DIRHANDLE_H
+#define MBED_DIRHANDLE_H
+
+// mbed's DirHandle interface, for building the FatFs glue on the host
+
+#include "FileHandle.h"
+
+#define NAME_MAX 255
+
+struct dirent {
+    char d_name[NAME_MAX+1];
+};
+
+namespace mbed {
+
+class DirHandle {
+public:
+    virtual int closedir()=0;
+    virtual struct dirent *readdir()=0;
+    virtual void rewinddir()=0;
+    virtual off_t telldir() { return -1; }
+    virtual void seekdir(off_t location) { }
+    virtual ~DirHandle() {}
+};
+
+}
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef MBED_FILEHANDLE_H
+#define MBED_FILEHANDLE_H
+
+// mbed's FileHandle interface, for building the FatFs glue on the host
+
+#include <stdio.h>
+#include <sys/types.h>
+
+namespace mbed {
+
+class FileHandle {
+public:
+    virtual ssize_t write(const void* buffer, size_t length) = 0;
+    virtual int close() = 0;
+    virtual ssize_t read(void* buffer, size_t length) = 0;
+    virtual int isatty() = 0;
+    virtual off_t lseek(off_t offset, int whence) = 0;
+    virtual int fsync() = 0;
+    virtual off_t flen() { return -1; }
+    virtual ~FileHandle() {}
+};
+
+}
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef MBED_FILESYSTEMLIKE_H
+#define MBED_FILESYSTEMLIKE_H
+
+// mbed's FileSystemLike interface, for building the FatFs glue on the host
+// On the board stdio finds the file system by its name, see fatimage.cpp for how that is done here
+
+#include "FileHandle.h"
+#include "DirHandle.h"
+
+namespace mbed {
+
+class FileSystemLike {
+public:
+    FileSystemLike(const char *name) : _name(name) {}
+    virtual ~FileSystemLike() {}
+
+    virtual FileHandle *open(const char *filename, int flags) = 0;
+    virtual int remove(const char *filename) { return -1; };
+    virtual int rename(const char *oldname, const char *newname) { return -1; };
+    virtual DirHandle *opendir(const char *name) { return NULL; };
+    virtual int mkdir(const char *name, mode_t mode) { return -1; }
+
+protected:
+    const char *_name;
+};
+
+}
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef MBED_H
+#define MBED_H
+
+// The little of mbed that the FatFs glue uses, for building it on the host
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+
+void error(const char *format, ...);
+
+namespace mbed {}
+using namespace mbed;
+
+#endif
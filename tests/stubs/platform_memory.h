@@ -0,0 +1,19 @@
+#ifndef PLATFORM_MEMORY_H
+#define PLATFORM_MEMORY_H
+
+// The AHB banks are plain heap on the host, and can be made to refuse everything to see what happens without them
+
+#include <stdlib.h>
+
+class HostMemoryPool {
+public:
+    HostMemoryPool() : refuse(false) {}
+    void *alloc(size_t nbytes) { return refuse ? NULL : malloc(nbytes); }
+    void  dealloc(void *p) { free(p); }
+    bool  refuse;
+};
+
+extern HostMemoryPool AHB0;
+extern HostMemoryPool AHB1;
+
+#endif
@@ -0,0 +1,137 @@
+/*
+ * M28 uploads on a FAT image: UploadWriter against the write path it replaced
+ *
+ * The old path wrote each line with fwrite through newlib's 1K stdio buffer, and closed and reopened the
+ * file for append every 400 bytes or so. Both write the same synthetic gcode a line at a time, and what
+ * reaches the disk is counted as well as timed, as the card is where the time goes on the board.
+ */
+
+#include "bench.h"
+#include "fatimage.h"
+#include "UploadWriter.h"
+#include "crc32.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+static const char *image = "upload_bench.img";
+static const char *filename = "/sd/upload.g";
+
+static std::vector<std::string> make_lines(uint32_t total)
+{
+    std::vector<std::string> lines;
+    uint32_t size = 0;
+    char line[64];
+    for (uint32_t i = 0; size < total; i++) {
+        int n = snprintf(line, sizeof(line), "G1 X%u.%03u Y%u.%03u E%u.%05u F%u\n",
+                         (i * 7) % 200, (i * 131) % 1000, (i * 13) % 200, (i * 17) % 1000, i / 50, (i * 37) % 100000, 1200 + (i % 7) * 600);
+        lines.push_back(std::string(line, n));
+        size += n;
+    }
+    return lines;
+}
+
+static bool write_old(const std::vector<std::string>& lines)
+{
+    FILE *fd = fopen(filename, "w");
+    if (fd == NULL) return false;
+    setvbuf(fd, NULL, _IOFBF, 1024);
+
+    int cnt = 0;
+    for (size_t i = 0; i < lines.size(); i++) {
+        if (fwrite(lines[i].c_str(), 1, lines[i].size(), fd) != lines[i].size()) {
+            fclose(fd);
+            return false;
+        }
+        cnt += lines[i].size();
+        if (cnt > 400) {
+            fclose(fd);
+            fd = fopen(filename, "a");
+            if (fd == NULL) return false;
+            setvbuf(fd, NULL, _IOFBF, 1024);
+            cnt = 0;
+        }
+    }
+    fclose(fd);
+    return true;
+}
+
+static bool write_new(const std::vector<std::string>& lines)
+{
+    UploadWriter writer;
+    if (!writer.open(filename)) return false;
+    for (size_t i = 0; i < lines.size(); i++) {
+        if (!writer.write(lines[i].c_str(), lines[i].size())) return false;
+    }
+    return writer.close();
+}
+
+static uint32_t crc_of_file(uint32_t& size)
+{
+    FILE *fp = fopen(filename, "r");
+    if (fp == NULL) return 0;
+    uint32_t crc = 0;
+    char buf[4096];
+    size_t n;
+    size = 0;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        crc = crc32_update(crc, buf, n);
+        size += n;
+    }
+    fclose(fp);
+    return crc;
+}
+
+static bool run(FatImage& disk, const char *name, bool (*write)(const std::vector<std::string>&), const std::vector<std::string>& lines, uint32_t crc, uint32_t size)
+{
+    disk.remove(filename + 4);
+    disk.reset_counts();
+    uint64_t start = bench_now_ns();
+    bool ok = write(lines);
+    double ms = (bench_now_ns() - start) / 1e6;
+    DiskCounts counts = disk.counts;
+
+    uint32_t got_size;
+    uint32_t got = crc_of_file(got_size);
+    ok = ok && got == crc && got_size == size;
+
+    printf("%-13s %8.1f ms  %7u sectors read  %7u written in %6u commands  %s\n", name, ms,
+           counts.sector_reads, counts.sector_writes, counts.write_commands, ok ? "ok" : "FAILED, file differs");
+    return ok;
+}
+
+int main()
+{
+    FatImage disk(image, 64);
+    if (!disk.format(4096)) {
+        printf("could not format %s\n", image);
+        return 1;
+    }
+
+    std::vector<std::string> lines = make_lines(1024 * 1024);
+    uint32_t size = 0, crc = 0;
+    for (size_t i = 0; i < lines.size(); i++) {
+        crc = crc32_update(crc, lines[i].c_str(), lines[i].size());
+        size += lines[i].size();
+    }
+    printf("uploading %u bytes in %u lines to a 64MB image with 4K clusters\n", size, (uint32_t)lines.size());
+
+    bool ok = run(disk, "fwrite/reopen", write_old, lines, crc, size);
+
+    // UploadWriter works out its own CRC as it goes, which should be that of the file
+    UploadWriter check;
+    check.open(filename);
+    for (size_t i = 0; i < lines.size(); i++) check.write(lines[i].c_str(), lines[i].size());
+    check.close();
+    if (check.get_crc() != crc) {
+        printf("UploadWriter crc %08X, expected %08X\n", check.get_crc(), crc);
+        ok = false;
+    }
+
+    ok = run(disk, "UploadWriter", write_new, lines, crc, size) && ok;
+
+    remove(image);
+    return ok ? 0 : 1;
+}